@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <vector>
+
+#include "AsyncSampleRateConverter.h"
+
+USE_BBC_AUDIOTOOLBOX
+
+/*--------------------------------------------------------------------------------*/
+/** Simulated drifting sample clock
+ *
+ * Generates the number of frames elapsed for a clock running at a nominal rate plus a fixed
+ * offset and an optional sinusoidal wander (all in ppm), used to simulate two clock domains
+ * (to exercise AsyncSampleRateConverter without real hardware)
+ */
+/*--------------------------------------------------------------------------------*/
+class DriftingClock
+{
+public:
+  DriftingClock(double _rate, double _offset = 0.0, double _wander = 0.0, double _period = 60.0) : rate(_rate),
+                                                                                                   offset(_offset),
+                                                                                                   wander(_wander),
+                                                                                                   period(_period),
+                                                                                                   t(0.0),
+                                                                                                   frames(0.0),
+                                                                                                   count(0) {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return current rate of clock
+   */
+  /*--------------------------------------------------------------------------------*/
+  double GetRate() const {return rate * (1.0 + 1.0e-6 * (offset + wander * sin(2.0 * M_PI * t / period)));}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return elapsed time in (true) seconds
+   */
+  /*--------------------------------------------------------------------------------*/
+  double GetTime() const {return t;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Advance clock by the specified (true) time
+   *
+   * @return number of whole frames that have elapsed
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t Advance(double seconds)
+  {
+    uint64_t n;
+
+    frames += GetRate() * seconds;
+    t      += seconds;
+    n       = (uint64_t)frames - count;
+    count  += n;
+
+    return (uint_t)n;
+  }
+
+protected:
+  double   rate;
+  double   offset;
+  double   wander;
+  double   period;
+  double   t;
+  double   frames;
+  uint64_t count;
+};
+
+/*--------------------------------------------------------------------------------*/
+/** Simulated check of AsyncSampleRateConverter: 48 kHz producer (drifting by a fixed offset plus
+ * wander) into 44.1 kHz consumer for 5 minutes of simulated time
+ *
+ * The test fails if the FIFO ever underflows or overflows once the converter is running
+ */
+/*--------------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+  const double   ppm      = (argc > 1) ? atof(argv[1]) : 200.0;
+  const double   duration = 300.0;
+  const double   tick     = .001;
+  const uint_t   inblock  = 48, outblock = 256;
+  AsyncSampleRateConverter asrc;
+  DriftingClock  producer(48000.0, ppm, 20.0, 30.0), consumer(44100.0);
+  std::vector<float> input(2 * inblock), output(2 * outblock);
+  double         phase = 0.0, minfill = 1.0e9, maxfill = 0.0;
+  uint_t         inframes = 0, outframes = 0, i;
+
+  if (!asrc.Setup(2, 48000.0, 44100.0, .02))
+  {
+    fprintf(stderr, "Failed to set up converter\n");
+    return 1;
+  }
+
+  while (producer.GetTime() < duration)
+  {
+    inframes  += producer.Advance(tick);
+    outframes += consumer.Advance(tick);
+
+    for (; inframes >= inblock; inframes -= inblock)
+    {
+      for (i = 0; i < inblock; i++)
+      {
+        input[2 * i] = input[2 * i + 1] = (float)(.5 * sin(phase));
+        phase = fmod(phase + 2.0 * M_PI * 997.0 / 48000.0, 2.0 * M_PI);
+      }
+      asrc.Write(&input[0], inblock);
+    }
+
+    for (; outframes >= outblock; outframes -= outblock)
+    {
+      asrc.Read(&output[0], outblock);
+
+      // allow the control loop to settle before measuring the fill level range
+      if (producer.GetTime() >= 60.0)
+      {
+        minfill = std::min(minfill, asrc.GetFillLevel());
+        maxfill = std::max(maxfill, asrc.GetFillLevel());
+      }
+    }
+  }
+
+  printf("%.0fppm drift: fill level %.1f..%.1f (target %.1f), correction %.1fppm, %u underruns, %u overruns\n",
+         ppm, minfill, maxfill, asrc.GetTargetFillLevel(), asrc.GetCorrection() * 1.0e6, asrc.GetUnderruns(), asrc.GetOverruns());
+
+  return (asrc.GetUnderruns() || asrc.GetOverruns()) ? 1 : 0;
+}
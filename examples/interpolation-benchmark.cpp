@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <vector>
+#include <chrono>
+
+#include "FractionalSample.h"
+
+USE_BBC_AUDIOTOOLBOX
+
+/*--------------------------------------------------------------------------------*/
+/** Throughput of each InterpolationKernel quality tier
+ *
+ * Each tier generates blocks of frames from a circular float buffer at a non-integer rate for 1, 2
+ * and 8 channels and the throughput is reported in millions of frames per second.  The SIMD tier
+ * (scalar, SSE3 or AVX) is set by the compiler flags the library was built with
+ */
+/*--------------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+  static const uint_t channellist[] = {1, 2, 8};
+  const double  seconds = (argc > 1) ? atof(argv[1]) : .25;    // time spent on each measurement
+  const uint_t  length  = 4096;
+  const uint_t  nframes = 256;
+  const double  inc     = 1.0 - 1.0 / 3.0e3;                   // non-integer rate so that every phase is used
+  std::vector<float> buffer(length * 8);
+  std::vector<float> dst(nframes * 8);
+  uint_t i, j;
+
+  for (i = 0; i < buffer.size(); i++) buffer[i] = (float)rand() / (float)RAND_MAX - .5f;
+
+#ifdef __AVX__
+  printf("SIMD: AVX\n");
+#elif defined(__SSE3__)
+  printf("SIMD: SSE3\n");
+#else
+  printf("SIMD: none (scalar)\n");
+#endif
+
+  printf("%-16s %5s", "kernel", "taps");
+  for (j = 0; j < NUMBEROF(channellist); j++) printf(" %7uch", channellist[j]);
+  printf("   (Mframes/s)\n");
+
+  for (i = 0; i < (uint_t)InterpolationKernel::Quality_Count; i++)
+  {
+    const InterpolationKernel& kernel = InterpolationKernel::Get((InterpolationKernel::Quality_t)i);
+
+    printf("%-16s %5u", kernel.GetName(), kernel.GetTaps());
+    for (j = 0; j < NUMBEROF(channellist); j++)
+    {
+      const uint_t nchannels = channellist[j];
+      const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      double   elapsed = 0.0, pos = 0.0;
+      uint64_t frames  = 0;
+
+      while (elapsed < seconds)
+      {
+        uint_t k;
+
+        // check the time every few blocks
+        for (k = 0; k < 64; k++, frames += nframes)
+        {
+          pos = kernel.Interpolate(&buffer[0], 0, nchannels, length, &dst[0], 0, nchannels, nchannels, nframes, pos, inc);
+        }
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      }
+
+      printf(" %9.1f", 1.0e-6 * (double)frames / elapsed);
+    }
+    printf("\n");
+  }
+
+  return 0;
+}
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+#include <chrono>
+#include <thread>
+
+#include "NonUniformConvolver.h"
+
+USE_BBC_AUDIOTOOLBOX
+
+/*--------------------------------------------------------------------------------*/
+/** Real-time paced check of NonUniformConvolver: 32 sample blocks, 3 s impulse response at 48 kHz
+ *
+ * Blocks are passed to the convolver at the rate an audio device would request them and the test
+ * fails if any tail block was not computed by its deadline
+ */
+/*--------------------------------------------------------------------------------*/
+int main(int argc, char *argv[])
+{
+  const uint_t samplerate = 48000;
+  const uint_t blocksize  = 32;
+  const uint_t irlength   = 3 * samplerate;
+  const uint_t nthreads   = (argc > 1) ? (uint_t)atoi(argv[1]) : 2;
+  const uint_t nblocks    = (6 * samplerate) / blocksize;     // twice the IR length
+  std::vector<float>    ir(irlength);
+  std::vector<Sample_t> buffer(blocksize);
+  NonUniformConvolver   convolver;
+  double                worst = 0.0;
+  uint_t                i, j;
+
+  for (i = 0; i < irlength; i++) ir[i] = (float)rand() / (float)RAND_MAX - .5f;
+
+  if (!convolver.Setup(blocksize, &ir[0], irlength, nthreads))
+  {
+    fprintf(stderr, "Failed to set up convolver\n");
+    return 1;
+  }
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (i = 0; i < nblocks; i++)
+  {
+    for (j = 0; j < blocksize; j++) buffer[j] = (Sample_t)rand() / (Sample_t)RAND_MAX - .5f;
+
+    const std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+    convolver.Process(&buffer[0], &buffer[0], 0, 1, 0, 1, blocksize);
+    worst = std::max(worst, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count());
+
+    // wait until the next block would be requested
+    std::this_thread::sleep_until(start + std::chrono::microseconds(((uint64_t)(i + 1) * blocksize * 1000000) / samplerate));
+  }
+
+  printf("%u segments, %u worker threads, %u deadline misses, worst block %.1fus (period %.1fus)\n",
+         convolver.GetSegments(), nthreads, convolver.GetDeadlineMisses(), worst, 1.0e6 * (double)blocksize / (double)samplerate);
+
+  return convolver.GetDeadlineMisses() ? 1 : 0;
+}
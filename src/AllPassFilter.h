@@ -1,6 +1,12 @@
 #ifndef __ALL_PASS_FILTER__
 #define __ALL_PASS_FILTER__
 
+#ifdef __AVX__
+#  include <immintrin.h>
+#elif defined(__SSE3__)
+#  include <pmmintrin.h>
+#endif
+
 #include "RingBuffer.h"
 
 BBC_AUDIOTOOLBOX_START
@@ -11,6 +17,9 @@ BBC_AUDIOTOOLBOX_START
  * Implements y[n] = c.x[n] + x[n - d] - c.y[n - d]
  *
  * For multiple channels
+ *
+ * Audio is processed in blocks of contiguous ring buffer frames (up to the delay in length),
+ * float samples are processed with SIMD across channels (and frames where contiguous)
  */
 /*--------------------------------------------------------------------------------*/
 template<typename TYPE>
@@ -89,44 +98,118 @@ public:
   /*--------------------------------------------------------------------------------*/
   void Process(const TYPE *src, TYPE *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes = 1)
   {
-    uint_t i;
+    const uint_t length = buffer.GetLength();
+    uint_t n = nchannels;
+
+    if (!length) return;
 
     // offset buffer pointers by starting channels
     src += srcchannel;
     dst += dstchannel;
 
-    if (nchannels == 1)
+    // calculate number of channels that can be processed
+    n = std::min(n, limited::subz(nsrcchannels, srcchannel));
+    n = std::min(n, limited::subz(ndstchannels, dstchannel));
+
+    // the slot in the ring buffer holding w[n - d] is the slot that w[n] is written to and, since a
+    // contiguous segment of the ring buffer is never longer than the delay, no frame within a segment
+    // depends on another so each segment can be processed in one go
+    while (nframes)
     {
-      // optimized version for single channel
-      for (i = 0; i < nframes; i++, src += nsrcchannels, dst += ndstchannels)
+      const uint_t pos  = buffer.GetPosition();
+      const uint_t nseg = std::min(nframes, (length - pos) / nchannels);
+      const TYPE   *s   = src;
+      TYPE         *d   = dst;
+      TYPE         *w   = buffer.GetBuffer(pos);
+      uint_t i;
+
+      if ((n == nchannels) && (nsrcchannels == n) && (ndstchannels == n))
       {
-        TYPE x = src[0];                            // take copy of src in case dst == src
-        dst[0] = coeff * x + buffer.Read();         // y[n] = c.x[n] + w[n - d]
-        buffer.Write(x - coeff * dst[0]);           // save w[n] = x[n] - c.y[n]
+        // source, destination and ring buffer all contiguous
+        ProcessSamples(s, d, w, nseg * n, coeff);
       }
-    }
-    else
-    {
-      uint_t j, n = nchannels;
-      
-      // calculate number of channels that can be processed
-      n = std::min(n, limited::subz(nsrcchannels, srcchannel));
-      n = std::min(n, limited::subz(ndstchannels, dstchannel));
-
-      for (i = 0; i < nframes; i++, src += nsrcchannels, dst += ndstchannels)
+      else if ((nchannels == 1) && n)
       {
-        for (j = 0; j < n; j++)
+        // optimized version for single channel
+        for (i = 0; i < nseg; i++, s += nsrcchannels, d += ndstchannels, w++)
         {
-          TYPE x = src[j];                          // take copy of src in case dst == src
-          dst[j] = coeff * x + buffer.Read();       // y[n] = c.x[n] + w[n - d]
-          buffer.Write(x - coeff * dst[j]);         // save w[n] = x[n] - c.y[n]
+          TYPE x = s[0];                            // take copy of src in case dst == src
+          d[0] = coeff * x + w[0];                  // y[n] = c.x[n] + w[n - d]
+          w[0] = x - coeff * d[0];                  // save w[n] = x[n] - c.y[n]
         }
-        // skip over unused channels in ring buffers
-        buffer.Advance(nchannels - n);
       }
+      else
+      {
+        // process channels of each frame together (unused channels in ring buffer are skipped)
+        for (i = 0; i < nseg; i++, s += nsrcchannels, d += ndstchannels, w += nchannels)
+        {
+          ProcessSamples(s, d, w, n, coeff);
+        }
+      }
+
+      src     += nseg * nsrcchannels;
+      dst     += nseg * ndstchannels;
+      nframes -= nseg;
+      buffer.Advance(nseg * nchannels);
     }
   }
   
+protected:
+  /*--------------------------------------------------------------------------------*/
+  /** Process n contiguous samples against n contiguous ring buffer samples
+   *
+   * @param src source samples
+   * @param dst destination samples (can == src)
+   * @param w ring buffer samples (w[n - d] on entry, w[n] on exit)
+   * @param n number of samples
+   * @param c coeff
+   */
+  /*--------------------------------------------------------------------------------*/
+  template<typename TYPE1>
+  static void ProcessSamples(const TYPE1 *src, TYPE1 *dst, TYPE1 *w, uint_t n, TYPE1 c)
+  {
+    uint_t i;
+
+    for (i = 0; i < n; i++)
+    {
+      TYPE1 x = src[i];                             // take copy of src in case dst == src
+      dst[i] = c * x + w[i];                        // y[n] = c.x[n] + w[n - d]
+      w[i]   = x - c * dst[i];                      // save w[n] = x[n] - c.y[n]
+    }
+  }
+
+  static void ProcessSamples(const float *src, float *dst, float *w, uint_t n, float c)
+  {
+    uint_t i = 0;
+
+#if defined(__AVX__)
+    const __m256 c8 = _mm256_set1_ps(c);
+    for (; (i + 8) <= n; i += 8)
+    {
+      __m256 x = _mm256_loadu_ps(src + i);
+      __m256 y = _mm256_add_ps(_mm256_mul_ps(c8, x), _mm256_loadu_ps(w + i));
+      _mm256_storeu_ps(dst + i, y);
+      _mm256_storeu_ps(w + i, _mm256_sub_ps(x, _mm256_mul_ps(c8, y)));
+    }
+#endif
+#if defined(__SSE3__)
+    const __m128 c4 = _mm_set1_ps(c);
+    for (; (i + 4) <= n; i += 4)
+    {
+      __m128 x = _mm_loadu_ps(src + i);
+      __m128 y = _mm_add_ps(_mm_mul_ps(c4, x), _mm_loadu_ps(w + i));
+      _mm_storeu_ps(dst + i, y);
+      _mm_storeu_ps(w + i, _mm_sub_ps(x, _mm_mul_ps(c4, y)));
+    }
+#endif
+    for (; i < n; i++)
+    {
+      float x = src[i];
+      dst[i] = c * x + w[i];
+      w[i]   = x - c * dst[i];
+    }
+  }
+
 protected:
   uint_t           nchannels;
   uint_t           delay;
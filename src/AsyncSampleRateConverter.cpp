@@ -0,0 +1,262 @@
+
+#include <math.h>
+
+#define BBCDEBUG_LEVEL 1
+#include "AsyncSampleRateConverter.h"
+
+BBC_AUDIOTOOLBOX_START
+
+AsyncSampleRateConverter::AsyncSampleRateConverter() : fifolength(0),
+                                                       inputrate(48000.0),
+                                                       outputrate(48000.0),
+                                                       target(0.0),
+                                                       filtered(0.0),
+                                                       integral(0.0),
+                                                       correction(0.0),
+                                                       kp(0.0),
+                                                       ki(0.0),
+                                                       maxcorrection(0.0),
+                                                       smoothing(0.0),
+                                                       running(false)
+{
+  written   = 0;
+  consumed  = 0;
+  overruns  = 0;
+  underruns = 0;
+  SetControl(.01);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set up converter
+ *
+ * @param _channels number of channels
+ * @param _inputrate nominal input (producer) sample rate
+ * @param _outputrate nominal output (consumer) sample rate
+ * @param _targetlatency target FIFO latency in seconds
+ * @param taps basic number of filter taps (see SampleRateConverter)
+ *
+ * @return true if set up successfully
+ *
+ * @note the FIFO is sized to hold four times the target latency
+ */
+/*--------------------------------------------------------------------------------*/
+bool AsyncSampleRateConverter::Setup(uint_t _channels, double _inputrate, double _outputrate, double _targetlatency, uint_t taps)
+{
+  std::lock_guard<std::mutex> lock(tlock);
+  bool success = false;
+
+  // FIFO is unusable until set up successfully
+  fifolength = 0;
+  fifo.clear();
+
+  if (src.Setup(_channels, _inputrate, _outputrate, taps))
+  {
+    inputrate  = _inputrate;
+    outputrate = _outputrate;
+    target     = std::max(_targetlatency * inputrate, 1.0);
+
+    // the ratio will be varied so the converter cannot use exact stepping
+    src.SetRatio(outputrate / inputrate);
+
+    fifolength = (uint_t)ceil(4.0 * target);
+    fifo.assign(fifolength * _channels, 0.f);
+
+    BBCDEBUG1(("Async sample rate converter %0.1lfHz -> %0.1lfHz: target %0.1lf frames", inputrate, outputrate, target));
+
+    success = true;
+  }
+
+  ResetUnlocked();
+
+  return success;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set controller parameters
+ *
+ * @param bandwidth natural frequency of the control loop in Hz
+ * @param damping damping factor of the control loop
+ * @param _maxcorrection maximum ratio correction (e.g. .005 = 0.5%)
+ */
+/*--------------------------------------------------------------------------------*/
+void AsyncSampleRateConverter::SetControl(double bandwidth, double damping, double _maxcorrection)
+{
+  /*
+   * With the error e measured in seconds of buffered audio and the correction c applied to the ratio:
+   *
+   *   de/dt = drift - c, c = kp * e + ki * integral(e)
+   *
+   * the closed loop is second order with natural frequency sqrt(ki) and damping kp / (2 * sqrt(ki))
+   */
+  const double wn = 2.0 * M_PI * std::max(bandwidth, 1.0e-6);
+
+  std::lock_guard<std::mutex> lock(tlock);
+  ki            = wn * wn;
+  kp            = 2.0 * damping * wn;
+  maxcorrection = fabs(_maxcorrection);
+  // smooth fill level well above the loop bandwidth to remove jitter caused by block sizes
+  smoothing     = .1 / wn;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Clear FIFO and controller state
+ */
+/*--------------------------------------------------------------------------------*/
+void AsyncSampleRateConverter::Reset()
+{
+  std::lock_guard<std::mutex> lock(tlock);
+  ResetUnlocked();
+}
+
+void AsyncSampleRateConverter::ResetUnlocked()
+{
+  consumed.store(written.load());
+  src.Reset();
+  filtered   = target;
+  integral   = 0.0;
+  correction = 0.0;
+  running    = false;
+  overruns   = 0;
+  underruns  = 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return current fill level in input frames (FIFO plus frames buffered in the converter)
+ */
+/*--------------------------------------------------------------------------------*/
+double AsyncSampleRateConverter::GetFillLevel() const
+{
+  if (!fifolength) return 0.0;
+
+  return (double)GetFIFOFrames() + std::max(src.GetBufferedFrames(), 0.0);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Write frames into FIFO (producer side)
+ *
+ * @param data source samples (interleaved, GetChannels() channels)
+ * @param format format of source samples (ASSUMES same endianness as machine)
+ * @param nframes number of frames
+ *
+ * @return number of frames written (frames that do not fit are dropped)
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t AsyncSampleRateConverter::Write(const uint8_t *data, SampleFormat_t format, uint_t nframes)
+{
+  if (!fifolength) return 0;
+
+  const uint_t   channels = GetChannels();
+  const uint_t   bpf      = GetBytesPerSample(format) * channels;
+  const uint64_t wpos     = written.load(std::memory_order_relaxed);      // only written by this (producer) thread
+  const uint_t   n        = std::min(nframes, fifolength - (uint_t)(wpos - consumed.load(std::memory_order_acquire)));
+  uint_t         nframe   = 0;
+
+  while (nframe < n)
+  {
+    // write contiguous section of FIFO
+    const uint_t offset = (uint_t)((wpos + nframe) % fifolength);
+    const uint_t count  = std::min(n - nframe, fifolength - offset);
+
+    TransferSamples(data + nframe * bpf, format,              MACHINE_IS_BIG_ENDIAN, 0, channels,
+                    &fifo[offset * channels], SampleFormat_Float, MACHINE_IS_BIG_ENDIAN, 0, channels,
+                    channels, count);
+    nframe += count;
+  }
+
+  // publish frames to consumer
+  written.store(wpos + n, std::memory_order_release);
+
+  if (n < nframes)
+  {
+    BBCDEBUG2(("Async sample rate converter overrun, %u frames dropped", nframes - n));
+    overruns++;
+  }
+
+  return n;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Update controller for a read of nframes and set converter ratio (with lock held)
+ */
+/*--------------------------------------------------------------------------------*/
+void AsyncSampleRateConverter::UpdateControl(uint_t nframes)
+{
+  const double dt = (double)nframes / outputrate;
+  double e;
+
+  filtered  += (1.0 - exp(-dt / smoothing)) * (GetFillLevel() - filtered);
+  e          = (filtered - target) / inputrate;
+
+  // limit integral to prevent wind-up
+  integral   = limited::limit(integral + e * dt, -maxcorrection / ki, maxcorrection / ki);
+  correction = limited::limit(kp * e + ki * integral, -maxcorrection, maxcorrection);
+
+  // positive correction -> too much input buffered -> consume input faster
+  src.SetRatio(outputrate / (inputrate * (1.0 + correction)));
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Read frames from converter (consumer side)
+ *
+ * @param data destination for samples (interleaved, GetChannels() channels)
+ * @param format format of destination samples (ASSUMES same endianness as machine)
+ * @param nframes number of frames
+ *
+ * @return number of frames generated from input (any remaining frames are silence)
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t AsyncSampleRateConverter::Read(uint8_t *data, SampleFormat_t format, uint_t nframes)
+{
+  const uint_t bpf    = GetBytesPerSample(format) * GetChannels();
+  uint_t       nframe = 0;
+
+  // wait for FIFO to fill to target before starting (or restarting after an underrun)
+  if (fifolength && !running && (GetFillLevel() >= target)) running = true;
+
+  if (running)
+  {
+    const uint_t channels = GetChannels();
+    uint64_t     rpos     = consumed.load(std::memory_order_relaxed);     // only written by this (consumer) thread
+    uint_t       n;
+
+    {
+      std::lock_guard<std::mutex> lock(tlock);
+      UpdateControl(nframes);
+    }
+
+    do
+    {
+      // pass contiguous section of FIFO directly to converter
+      const uint_t offset = (uint_t)(rpos % fifolength);
+      const uint_t avail  = std::min((uint_t)(written.load(std::memory_order_acquire) - rpos), fifolength - offset);
+      uint_t       nconsumed;
+
+      n = src.Process((const uint8_t *)&fifo[offset * channels], SampleFormat_Float, avail,
+                      data + nframe * bpf, format, nframes - nframe,
+                      &nconsumed);
+
+      // release space to producer
+      rpos += nconsumed;
+      consumed.store(rpos, std::memory_order_release);
+      nframe += n;
+
+      // continue whilst output is being generated or input is being consumed
+      n += nconsumed;
+    }
+    while ((nframe < nframes) && n);
+
+    if (nframe < nframes)
+    {
+      BBCDEBUG2(("Async sample rate converter underrun, %u frames of silence inserted", nframes - nframe));
+      underruns++;
+      running = false;
+    }
+  }
+
+  // fill remainder with silence
+  if (nframe < nframes) memset(data + nframe * bpf, 0, (nframes - nframe) * bpf);
+
+  return nframe;
+}
+
+BBC_AUDIOTOOLBOX_END
@@ -0,0 +1,187 @@
+#ifndef __ASYNC_SAMPLE_RATE_CONVERTER__
+#define __ASYNC_SAMPLE_RATE_CONVERTER__
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "SampleRateConverter.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Asynchronous sample rate converter for bridging two clock domains
+ *
+ * Input is written by the producer (e.g. a network stream) into a FIFO and read by the consumer
+ * (e.g. a soundcard callback) through a SampleRateConverter
+ *
+ * Each time the consumer reads, the fill level of the FIFO (frames in the FIFO plus
+ * the frames buffered inside the converter) *before* the read is smoothed and compared with the
+ * target and a PI controller adjusts the conversion ratio so that the fill level (and therefore
+ * latency) remains bounded irrespective of the drift between the two clocks
+ *
+ * The ratio changes by tiny amounts on each read and the converter interpolates continuously
+ * so there are no dropped or duplicated frames (and therefore no clicks) in normal operation
+ *
+ * If the FIFO overflows, input frames are dropped; if it underflows, the output is filled with
+ * silence and the converter waits for the FIFO to reach the target level again
+ *
+ * Write() and Read() can be called from different threads (one producer and one consumer) without
+ * blocking each other: the FIFO is lock-free, the producer and consumer each publishing their
+ * position atomically; only the controller parameters and state are protected by a lock (so that
+ * SetControl() can be called from any thread)
+ *
+ * @note Setup() and Reset() must not be called whilst Write() or Read() are being called
+ */
+/*--------------------------------------------------------------------------------*/
+class AsyncSampleRateConverter
+{
+public:
+  AsyncSampleRateConverter();
+  virtual ~AsyncSampleRateConverter() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set up converter
+   *
+   * @param _channels number of channels
+   * @param _inputrate nominal input (producer) sample rate
+   * @param _outputrate nominal output (consumer) sample rate
+   * @param _targetlatency target FIFO latency in seconds
+   * @param taps basic number of filter taps (see SampleRateConverter)
+   *
+   * @return true if set up successfully
+   *
+   * @note the FIFO is sized to hold four times the target latency
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual bool Setup(uint_t _channels, double _inputrate, double _outputrate, double _targetlatency = .02, uint_t taps = 32);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set controller parameters
+   *
+   * @param bandwidth natural frequency of the control loop in Hz
+   * @param damping damping factor of the control loop
+   * @param _maxcorrection maximum ratio correction (e.g. .005 = 0.5%)
+   *
+   * @note the default (0.01Hz, 0.707, 0.5%) tracks drift of a few hundred ppm with errors of a few
+   * @note milliseconds while keeping pitch modulation caused by jitter in the fill level inaudible
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetControl(double bandwidth, double damping = .707, double _maxcorrection = .005);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Clear FIFO and controller state
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual void Reset();
+
+  uint_t GetChannels() const {return src.GetChannels();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Write frames into FIFO (producer side)
+   *
+   * @param data source samples (interleaved, GetChannels() channels)
+   * @param format format of source samples (ASSUMES same endianness as machine)
+   * @param nframes number of frames
+   *
+   * @return number of frames written (frames that do not fit are dropped)
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual uint_t Write(const uint8_t *data, SampleFormat_t format, uint_t nframes);
+  template<typename T>
+  uint_t Write(const T *data, uint_t nframes) {return Write((const uint8_t *)data, SampleFormatOf(data), nframes);}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Read frames from converter (consumer side)
+   *
+   * @param data destination for samples (interleaved, GetChannels() channels)
+   * @param format format of destination samples (ASSUMES same endianness as machine)
+   * @param nframes number of frames
+   *
+   * @return number of frames generated from input (any remaining frames are silence)
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual uint_t Read(uint8_t *data, SampleFormat_t format, uint_t nframes);
+  template<typename T>
+  uint_t Read(T *data, uint_t nframes) {return Read((uint8_t *)data, SampleFormatOf(data), nframes);}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return current fill level in input frames (FIFO plus frames buffered in the converter)
+   *
+   * @note this should be called from the consumer side
+   */
+  /*--------------------------------------------------------------------------------*/
+  double GetFillLevel() const;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return target fill level in input frames
+   */
+  /*--------------------------------------------------------------------------------*/
+  double GetTargetFillLevel() const {return target;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return total latency in seconds (current fill level plus converter latency)
+   */
+  /*--------------------------------------------------------------------------------*/
+  double GetLatency() const {return (GetFillLevel() + src.GetLatency()) / inputrate;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return current ratio correction (e.g. 1.0e-4 = consumer running 100ppm slower than producer)
+   */
+  /*--------------------------------------------------------------------------------*/
+  double GetCorrection() const
+  {
+    std::lock_guard<std::mutex> lock(tlock);
+    return correction;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of overruns (writes that dropped frames) and underruns (reads that inserted silence)
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetOverruns()  const {return overruns;}
+  uint_t GetUnderruns() const {return underruns;}
+
+protected:
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of frames in FIFO
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetFIFOFrames() const {return (uint_t)(written.load(std::memory_order_acquire) - consumed.load(std::memory_order_acquire));}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Update controller for a read of nframes and set converter ratio (with lock held)
+   */
+  /*--------------------------------------------------------------------------------*/
+  void UpdateControl(uint_t nframes);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Reset with lock already held
+   */
+  /*--------------------------------------------------------------------------------*/
+  void ResetUnlocked();
+
+protected:
+  mutable std::mutex    tlock;          // protects controller parameters and state
+  SampleRateConverter   src;
+  std::vector<float>    fifo;           // interleaved float frames
+  uint_t                fifolength;     // length of FIFO in frames (0 if not set up)
+  std::atomic<uint64_t> written;        // total frames written into FIFO (published by producer)
+  std::atomic<uint64_t> consumed;       // total frames read from FIFO (published by consumer)
+  double                inputrate;
+  double                outputrate;
+  double                target;         // target fill level in input frames
+  double                filtered;       // smoothed fill level in input frames
+  double                integral;       // integral of error in seconds^2
+  double                correction;     // current ratio correction
+  double                kp, ki;         // controller gains
+  double                maxcorrection;
+  double                smoothing;      // time constant of fill level smoothing in seconds
+  bool                  running;        // false whilst waiting for FIFO to reach target (consumer only)
+  std::atomic<uint_t>   overruns;
+  std::atomic<uint_t>   underruns;
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
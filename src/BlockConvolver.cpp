@@ -0,0 +1,264 @@
+#include <string.h>
+
+#include <algorithm>
+
+#define BBCDEBUG_LEVEL 1
+#include "BlockConvolver.h"
+#include "simd_utils.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Return number of floats per spectrum for block size (padded for alignment)
+ */
+/*--------------------------------------------------------------------------------*/
+static uint_t CalcSpectrumStride(uint_t blocksize)
+{
+  return (FFT::GetRealBufferSize(2 * blocksize) + 7) & ~7U;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Calculate partition spectra of impulse response
+ *
+ * @param _blocksize block (and partition) size (a power of 2)
+ * @param ir impulse response
+ * @param irlength length of impulse response in samples
+ * @param gain gain to apply to impulse response
+ */
+/*--------------------------------------------------------------------------------*/
+BlockConvolver::Filter::Filter(uint_t _blocksize, const float *ir, uint_t irlength, float gain) : blocksize(_blocksize),
+                                                                                                  npartitions(0),
+                                                                                                  stride(CalcSpectrumStride(_blocksize)),
+                                                                                                  spectra(NULL)
+{
+  const FFT *fft;
+
+  if ((fft = FFT::Get(2 * blocksize)) != NULL)
+  {
+    // fold normalisation of inverse transform into filter
+    const float scale = gain / (float)(2 * blocksize);
+    uint_t i, j;
+
+    npartitions = (irlength + blocksize - 1) / blocksize;
+    if ((spectra = FFT::AllocateBuffer(std::max(npartitions, (uint_t)1) * stride)) != NULL)
+    {
+      for (i = 0; i < npartitions; i++)
+      {
+        float *p = spectra + i * stride;
+        uint_t n = std::min(blocksize, irlength - i * blocksize);
+
+        // partition in first half of transform, zeros in second half
+        for (j = 0; j < n; j++) p[j] = ir[i * blocksize + j] * scale;
+
+        fft->RealForward(p);
+      }
+    }
+    else npartitions = 0;
+  }
+}
+
+BlockConvolver::Filter::~Filter()
+{
+  FFT::FreeBuffer(spectra);
+}
+
+BlockConvolver::BlockConvolver() : fft(NULL),
+                                   filter(NULL),
+                                   blocksize(0),
+                                   maxpartitions(0),
+                                   stride(0),
+                                   pos(0),
+                                   head(0),
+                                   fdl(NULL),
+                                   fftbuf(NULL),
+                                   input(NULL),
+                                   output(NULL)
+{
+}
+
+BlockConvolver::~BlockConvolver()
+{
+  FreeBuffers();
+}
+
+void BlockConvolver::FreeBuffers()
+{
+  FFT::FreeBuffer(fdl);
+  FFT::FreeBuffer(fftbuf);
+  FFT::FreeBuffer(input);
+  FFT::FreeBuffer(output);
+  fdl = fftbuf = input = output = NULL;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set up convolver
+ *
+ * @param _blocksize block size (a power of 2)
+ * @param _maxpartitions maximum number of filter partitions
+ *
+ * @return true if set up successfully
+ */
+/*--------------------------------------------------------------------------------*/
+bool BlockConvolver::Setup(uint_t _blocksize, uint_t _maxpartitions)
+{
+  FreeBuffers();
+  filter        = NULL;
+  blocksize     = 0;
+  maxpartitions = 0;
+
+  if (!_maxpartitions || ((fft = FFT::Get(2 * _blocksize)) == NULL))
+  {
+    BBCERROR("Invalid block convolver parameters (block size %u, %u partitions)", _blocksize, _maxpartitions);
+    return false;
+  }
+
+  blocksize     = _blocksize;
+  maxpartitions = _maxpartitions;
+  stride        = CalcSpectrumStride(blocksize);
+
+  fdl    = FFT::AllocateBuffer(maxpartitions * stride);
+  fftbuf = FFT::AllocateBuffer(stride);
+  input  = FFT::AllocateBuffer(2 * blocksize);
+  output = FFT::AllocateBuffer(blocksize);
+
+  if (!fdl || !fftbuf || !input || !output)
+  {
+    FreeBuffers();
+    blocksize = maxpartitions = 0;
+    return false;
+  }
+
+  Reset();
+
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set filter
+ *
+ * @param _filter filter (or NULL for silence)
+ *
+ * @return true if filter is compatible (its block size must be the same as the convolver's)
+ *
+ * @note the filter is NOT copied and must not be deleted whilst in use
+ * @note filter partitions beyond the maximum number of partitions are ignored
+ */
+/*--------------------------------------------------------------------------------*/
+bool BlockConvolver::SetFilter(const Filter *_filter)
+{
+  if (_filter && (_filter->GetBlockSize() != blocksize))
+  {
+    BBCERROR("Filter block size %u does not match convolver block size %u", _filter->GetBlockSize(), blocksize);
+    return false;
+  }
+
+  filter = _filter;
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Clear all input and output
+ */
+/*--------------------------------------------------------------------------------*/
+void BlockConvolver::Reset()
+{
+  if (blocksize)
+  {
+    memset(fdl,    0, maxpartitions * stride * sizeof(*fdl));
+    memset(input,  0, 2 * blocksize * sizeof(*input));
+    memset(output, 0, blocksize * sizeof(*output));
+  }
+  pos  = 0;
+  head = 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process audio
+ *
+ * @param src source buffer
+ * @param dst destination buffer
+ * @param srcchannel source channel to convolve
+ * @param nsrcchannels total number of source channels
+ * @param dstchannel destination channel to write to
+ * @param ndstchannels total number of destination channels
+ * @param nframes number of sample frames to process
+ */
+/*--------------------------------------------------------------------------------*/
+void BlockConvolver::Process(const Sample_t *src, Sample_t *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes)
+{
+  const bool validsrc = (srcchannel < nsrcchannels);
+  const bool validdst = (dstchannel < ndstchannels);
+  uint_t i, n;
+
+  if (!blocksize) return;
+
+  src += srcchannel;
+  dst += dstchannel;
+  while (nframes)
+  {
+    n = std::min(nframes, blocksize - pos);
+
+    // input goes into second half of input buffer, output comes from the previous block
+    for (i = 0; i < n; i++) input[blocksize + pos + i] = validsrc ? (float)src[i * nsrcchannels] : 0.f;
+    if (validdst)
+    {
+      for (i = 0; i < n; i++) dst[i * ndstchannels] = (Sample_t)output[pos + i];
+    }
+
+    src     += n * nsrcchannels;
+    dst     += n * ndstchannels;
+    pos     += n;
+    nframes -= n;
+
+    if (pos == blocksize)
+    {
+      ProcessBlock(input + blocksize, output);
+      pos = 0;
+    }
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Convolve a complete block of input
+ *
+ * @param src one block of input
+ * @param dst destination for one block of output
+ *
+ * @note the output is that for the block period following the input block (the same output as
+ * @note Process() would produce for the next block), so the latency is one block
+ * @note must not be mixed with Process() (except after Reset())
+ */
+/*--------------------------------------------------------------------------------*/
+void BlockConvolver::ProcessBlock(const float *src, float *dst)
+{
+  const uint_t nbins = blocksize + 1;
+  const uint_t np    = filter ? std::min(filter->GetPartitions(), maxpartitions) : 0;
+  uint_t i;
+
+  if (!blocksize) return;
+
+  // input buffer holds previous block then this block
+  if (src != (input + blocksize)) memcpy(input + blocksize, src, blocksize * sizeof(*input));
+
+  // transform last two blocks of input into frequency-domain delay line
+  head = (head + maxpartitions - 1) % maxpartitions;
+  float *spectrum = fdl + head * stride;
+  memcpy(spectrum, input, 2 * blocksize * sizeof(*input));
+  fft->RealForward(spectrum);
+
+  // shift input along by one block
+  memcpy(input, input + blocksize, blocksize * sizeof(*input));
+
+  // sum products of delayed input spectra and filter partitions
+  memset(fftbuf, 0, stride * sizeof(*fftbuf));
+  for (i = 0; i < np; i++)
+  {
+    ComplexMultiplyAccumulate(fftbuf, fdl + ((head + i) % maxpartitions) * stride, filter->GetPartition(i), nbins);
+  }
+
+  // second half of inverse transform is the (non-aliased) output
+  fft->RealInverse(fftbuf);
+  memcpy(dst, fftbuf + blocksize, blocksize * sizeof(*dst));
+}
+
+BBC_AUDIOTOOLBOX_END
@@ -0,0 +1,165 @@
+#ifndef __BLOCK_CONVOLVER__
+#define __BLOCK_CONVOLVER__
+
+#include <vector>
+
+#include <bbcat-base/misc.h>
+
+#include "FFT.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Single-channel uniformly partitioned convolver (overlap-save)
+ *
+ * The impulse response is split into partitions of one block each, the spectrum of each partition
+ * (FFT size two blocks) being calculated once by a Filter object, which can be shared by any number of
+ * convolvers (and threads) since it is never modified after construction
+ *
+ * For each block of input, the spectrum of the last two blocks of input is calculated and stored in a
+ * frequency-domain delay line; the output spectrum is the sum of the products of each delayed input
+ * spectrum and the corresponding filter partition spectrum (a SIMD complex multiply-accumulate) and
+ * the output block is the second half of its inverse transform
+ *
+ * Audio can be processed in any number of frames, the latency is always exactly one block
+ */
+/*--------------------------------------------------------------------------------*/
+class BlockConvolver
+{
+public:
+  /*--------------------------------------------------------------------------------*/
+  /** Precalculated, shareable impulse response partition spectra
+   */
+  /*--------------------------------------------------------------------------------*/
+  class Filter
+  {
+  public:
+    /*--------------------------------------------------------------------------------*/
+    /** Calculate partition spectra of impulse response
+     *
+     * @param _blocksize block (and partition) size (a power of 2)
+     * @param ir impulse response
+     * @param irlength length of impulse response in samples
+     * @param gain gain to apply to impulse response
+     */
+    /*--------------------------------------------------------------------------------*/
+    Filter(uint_t _blocksize, const float *ir, uint_t irlength, float gain = 1.f);
+    ~Filter();
+
+    uint_t GetBlockSize()  const {return blocksize;}
+    uint_t GetPartitions() const {return npartitions;}
+
+    /*--------------------------------------------------------------------------------*/
+    /** Return true if the spectra were calculated (false if the block size is invalid or allocation failed)
+     */
+    /*--------------------------------------------------------------------------------*/
+    bool IsValid() const {return (spectra != NULL);}
+
+    /*--------------------------------------------------------------------------------*/
+    /** Return spectrum of partition (blocksize + 1 complex values)
+     */
+    /*--------------------------------------------------------------------------------*/
+    const float *GetPartition(uint_t n) const {return spectra + n * stride;}
+
+  protected:
+    uint_t blocksize;
+    uint_t npartitions;
+    uint_t stride;            // floats per partition
+    float  *spectra;
+
+  private:
+    // copying is not supported
+    Filter(const Filter&);
+    Filter& operator = (const Filter&);
+  };
+
+  BlockConvolver();
+  ~BlockConvolver();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set up convolver
+   *
+   * @param _blocksize block size (a power of 2)
+   * @param _maxpartitions maximum number of filter partitions
+   *
+   * @return true if set up successfully
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool Setup(uint_t _blocksize, uint_t _maxpartitions);
+
+  uint_t GetBlockSize()     const {return blocksize;}
+  uint_t GetMaxPartitions() const {return maxpartitions;}
+  uint_t GetLatency()       const {return blocksize;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set filter
+   *
+   * @param _filter filter (or NULL for silence)
+   *
+   * @return true if filter is compatible (its block size must be the same as the convolver's)
+   *
+   * @note the filter is NOT copied and must not be deleted whilst in use
+   * @note filter partitions beyond the maximum number of partitions are ignored
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool SetFilter(const Filter *_filter);
+  const Filter *GetFilter() const {return filter;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Clear all input and output
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Process audio
+   *
+   * @param src source buffer
+   * @param dst destination buffer
+   * @param srcchannel source channel to convolve
+   * @param nsrcchannels total number of source channels
+   * @param dstchannel destination channel to write to
+   * @param ndstchannels total number of destination channels
+   * @param nframes number of sample frames to process
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Process(const Sample_t *src, Sample_t *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Convolve a complete block of input
+   *
+   * @param src one block of input
+   * @param dst destination for one block of output
+   *
+   * @note the output is that for the block period following the input block (the same output as
+   * @note Process() would produce for the next block), so the latency is one block
+   * @note must not be mixed with Process() (except after Reset())
+   */
+  /*--------------------------------------------------------------------------------*/
+  void ProcessBlock(const float *src, float *dst);
+
+protected:
+  void FreeBuffers();
+
+protected:
+  const FFT    *fft;
+  const Filter *filter;
+  uint_t       blocksize;
+  uint_t       maxpartitions;
+  uint_t       stride;            // floats per spectrum
+  uint_t       pos;               // position within input/output blocks
+  uint_t       head;              // index of most recent spectrum in frequency-domain delay line
+  float        *fdl;              // frequency-domain delay line (maxpartitions spectra)
+  float        *fftbuf;           // input/output transform buffer
+  float        *input;            // last two blocks of input
+  float        *output;           // current block of output
+
+private:
+  // copying is not supported
+  BlockConvolver(const BlockConvolver&);
+  BlockConvolver& operator = (const BlockConvolver&);
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
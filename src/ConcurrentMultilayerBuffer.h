@@ -0,0 +1,471 @@
+#ifndef __CONCURRENT_MULTI_LAYER_BUFFER__
+#define __CONCURRENT_MULTI_LAYER_BUFFER__
+
+#include <string.h>
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "SoundFormatConversions.h"
+#include "SoundMixing.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Thread-safe version of MultilayerBuffer for layers written from different threads
+ *
+ * Each layer has its own circular slab of frames, written (mixed into) only by that layer's producer,
+ * and the layer's progress is published atomically, so producers never contend with each other
+ *
+ * The consumer sums the slabs of all layers as it reads, clears the frames it has read and publishes
+ * its read position atomically, freeing space in every slab
+ *
+ * Slabs have a fixed size so producers can be at most GetSlabFrames() frames ahead of the consumer, writes
+ * beyond this are limited (back-pressure) and WriteLayer() returns the number of frames accepted
+ *
+ * The consumer can poll GetAvailableFrames() or block in WaitForFrames() until enough frames are available
+ *
+ * Threading rules:
+ *   Setup() and Reset() must not be called whilst any other thread is using the buffer
+ *   WriteLayer(), LayerWritten() and GetLayerSpace() for a layer must only be called by that layer's producer
+ *   ReadBuffer() must only be called by the consumer (but may be called concurrently with producers)
+ *   AddLayer() and DeleteLayer() may be called from any thread but a layer must not be deleted whilst its producer is writing
+ */
+/*--------------------------------------------------------------------------------*/
+template<typename T>
+class ConcurrentMultilayerBuffer
+{
+public:
+  /*--------------------------------------------------------------------------------*/
+  /** Constructor
+   *
+   * @param _channels number of channels in buffer
+   * @param _layers initial number of layers
+   * @param _slabframes size of each layer's slab in frames
+   * @param _maxlayers maximum number of layers
+   */
+  /*--------------------------------------------------------------------------------*/
+  ConcurrentMultilayerBuffer(uint_t _channels = 0, uint_t _layers = 0, uint_t _slabframes = 8192, uint_t _maxlayers = 64) : channels(0),
+                                                                                                                           slabframes(0),
+                                                                                                                           readpos(0),
+                                                                                                                           nlayers(0),
+                                                                                                                           waiters(0)
+  {
+    Setup(_channels, _layers, _slabframes, _maxlayers);
+  }
+  ~ConcurrentMultilayerBuffer() {Clear();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Setup / reset
+   *
+   * @param _channels number of channels in buffer
+   * @param _layers initial number of layers (handles 0 to _layers - 1)
+   * @param _slabframes size of each layer's slab in frames
+   * @param _maxlayers maximum number of layers
+   *
+   * @note NOT thread-safe
+   * @note all memory is allocated here so that no further allocation is required
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Setup(uint_t _channels, uint_t _layers, uint_t _slabframes = 8192, uint_t _maxlayers = 64)
+  {
+    uint_t i;
+
+    Clear();
+
+    channels   = _channels;
+    slabframes = _slabframes;
+
+    layers.resize(std::max(_maxlayers, _layers));
+    for (i = 0; i < (uint_t)layers.size(); i++)
+    {
+      layers[i] = new LAYER;
+      layers[i]->slab.resize(slabframes * channels);
+      layers[i]->active   = (i < _layers);
+      layers[i]->reserved = false;
+      layers[i]->written  = 0;
+    }
+
+    nlayers = _layers;
+    readpos = 0;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Reset buffer and positions
+   *
+   * @note NOT thread-safe
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset()
+  {
+    uint_t i;
+
+    for (i = 0; i < (uint_t)layers.size(); i++)
+    {
+      LAYER& layer = *layers[i];
+
+      if (layer.slab.size()) memset(&layer.slab[0], 0, layer.slab.size() * sizeof(layer.slab[0]));
+      layer.written = 0;
+    }
+
+    readpos = 0;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Add layer
+   *
+   * @return handle of new layer or ~0 if the maximum number of layers already exist
+   *
+   * @note the new layer starts at the current read position, resetting the available data back to zero
+   * @note the layer's slab is cleared without holding the lock used by the consumer
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t AddLayer()
+  {
+    uint_t i;
+
+    // reserve an unused layer
+    {
+      std::lock_guard<std::mutex> lock(layerlock);
+
+      for (i = 0; (i < (uint_t)layers.size()) && (layers[i]->active || layers[i]->reserved); i++) ;
+      if (i == (uint_t)layers.size()) return ~0;
+
+      layers[i]->reserved = true;
+    }
+
+    LAYER& layer = *layers[i];
+
+    // slab was cleared as frames were read but may contain data written ahead before the layer was
+    // deleted; the consumer ignores inactive layers so the slab can be cleared outside of the lock
+    if (layer.slab.size()) memset(&layer.slab[0], 0, layer.slab.size() * sizeof(layer.slab[0]));
+
+    // publish layer
+    {
+      std::lock_guard<std::mutex> lock(layerlock);
+
+      layer.written  = readpos.load();
+      layer.active   = true;
+      layer.reserved = false;
+      nlayers++;
+    }
+
+    return i;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Delete layer
+   *
+   * @note the handles of other layers are unaffected
+   */
+  /*--------------------------------------------------------------------------------*/
+  void DeleteLayer(uint_t layer)
+  {
+    std::lock_guard<std::mutex> lock(layerlock);
+
+    if (IsLayer(layer))
+    {
+      layers[layer]->active = false;
+      nlayers--;
+    }
+
+    // deleting a layer may make more frames available
+    Notify();
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return whether layer handle refers to an existing layer
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool IsLayer(uint_t layer) const {return ((layer < (uint_t)layers.size()) && layers[layer]->active);}
+
+  uint_t GetChannels()   const {return channels;}
+  uint_t GetLayers()     const {return nlayers;}
+  uint_t GetSlabFrames() const {return slabframes;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of frames that can currently be written to a layer
+   *
+   * @note must only be called by the layer's producer
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetLayerSpace(uint_t layer) const
+  {
+    return IsLayer(layer) ? slabframes - (uint_t)(layers[layer]->written.load(std::memory_order_relaxed) - readpos.load(std::memory_order_acquire)) : 0;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Write data into slab for the specified layer
+   *
+   * @param layer layer number
+   * @param src source buffer
+   * @param srcchannel channel into source buffer to read from
+   * @param nsrcchannels number of channels in source buffer (in total)
+   * @param ndstchannel channel into destination buffer to write to
+   * @param nchannels number of channels to write
+   * @param nframes number of frames to write
+   * @param inc true to increment (and publish) layer position after writing
+   *
+   * @return number of frames written (limited by the space in the layer's slab)
+   *
+   * @note must only be called by the layer's producer
+   * @note if inc = false, the caller is responsible to ensuring the layer's position is correctly updated (use LayerWritten() below)
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t WriteLayer(uint_t layer, const T *src, uint_t srcchannel, uint_t nsrcchannels, uint_t ndstchannel, uint_t nchannels, uint_t nframes, bool inc = true)
+  {
+    if ((nframes = std::min(nframes, GetLayerSpace(layer))) > 0)
+    {
+      LAYER&   slab = *layers[layer];
+      uint64_t pos  = slab.written.load(std::memory_order_relaxed);
+      uint_t   n, left = nframes;
+
+      // mix data into slab (in up to two segments)
+      while (left)
+      {
+        const uint_t index = (uint_t)(pos % slabframes);
+
+        n = std::min(left, slabframes - index);
+        MixSamples(src, srcchannel, nsrcchannels,
+                   &slab.slab[index * channels],
+                   ndstchannel, channels,
+                   nchannels,
+                   n);
+        src  += n * nsrcchannels;
+        pos  += n;
+        left -= n;
+      }
+
+      if (inc) LayerWritten(layer, nframes);
+    }
+
+    return nframes;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Advance (and publish) layer position by specified amount
+   *
+   * @param layer layer number
+   * @param nframes number of frames to advance the position by (limited by the space in the layer's slab)
+   *
+   * @return number of frames advanced
+   *
+   * @note must only be called by the layer's producer
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t LayerWritten(uint_t layer, uint_t nframes)
+  {
+    if ((nframes = std::min(nframes, GetLayerSpace(layer))) > 0)
+    {
+      LAYER& slab = *layers[layer];
+
+      // publish data written
+      slab.written.store(slab.written.load(std::memory_order_relaxed) + nframes, std::memory_order_release);
+
+      Notify();
+    }
+
+    return nframes;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of frames available for reading (that have been written by all layers)
+   *
+   * @note with no layers, no frames are available
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetAvailableFrames() const
+  {
+    const uint64_t pos = readpos.load(std::memory_order_relaxed);
+    uint64_t       minpos = ~(uint64_t)0;
+    uint_t         i;
+
+    for (i = 0; i < (uint_t)layers.size(); i++)
+    {
+      const LAYER& layer = *layers[i];
+      if (layer.active) minpos = std::min(minpos, layer.written.load(std::memory_order_acquire));
+    }
+
+    return (minpos != ~(uint64_t)0) ? (uint_t)(minpos - pos) : 0;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Wait until at least nframes are available for reading
+   *
+   * @param nframes number of frames required (limited to GetSlabFrames())
+   * @param timeout maximum time to wait in milliseconds (0 = wait indefinitely)
+   *
+   * @return true if the frames are available, false if timed out
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool WaitForFrames(uint_t nframes, uint_t timeout = 0)
+  {
+    nframes = std::min(nframes, slabframes);
+
+    if (GetAvailableFrames() >= nframes) return true;
+
+    std::unique_lock<std::mutex> lock(waitlock);
+    bool success;
+
+    // producers only take the lock to notify when someone is waiting: the fence (paired with the one
+    // in Notify()) ensures that either the producer sees this waiter or the predicate sees its data
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (timeout) success = waitcondition.wait_for(lock, std::chrono::milliseconds(timeout), [&]{return (GetAvailableFrames() >= nframes);});
+    else
+    {
+      waitcondition.wait(lock, [&]{return (GetAvailableFrames() >= nframes);});
+      success = true;
+    }
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+
+    return success;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Read data from buffer, summing all layers
+   *
+   * @param srcchannel source channel within buffer
+   * @param dst destination buffer to write to
+   * @param dstchannel channel within destination buffer to write to
+   * @param ndstchannels total number of channels in destination
+   * @param nchannels number of channels to read
+   * @param nframes number of frames to read (will be limited)
+   * @param overwrite true to overwrite data in destination, false to add data to destination
+   *
+   * @return number of frames actually read
+   *
+   * @note must only be called by the consumer
+   * @note read data is always removed from the buffer (ALL channels), freeing space for producers
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t ReadBuffer(uint_t srcchannel, T *dst, uint_t dstchannel, uint_t ndstchannels, uint_t nchannels, uint_t nframes, bool overwrite = true)
+  {
+    std::lock_guard<std::mutex> lock(layerlock);
+
+    if ((nframes = std::min(nframes, GetAvailableFrames())) > 0)
+    {
+      const uint64_t pos = readpos.load(std::memory_order_relaxed);
+      uint_t i, first = 1;
+
+      for (i = 0; i < (uint_t)layers.size(); i++)
+      {
+        LAYER& layer = *layers[i];
+
+        if (layer.active)
+        {
+          uint64_t p = pos;
+          T        *d = dst;
+          uint_t   n, left = nframes;
+
+          while (left)
+          {
+            const uint_t index = (uint_t)(p % slabframes);
+            T            *s    = &layer.slab[index * channels];
+
+            n = std::min(left, slabframes - index);
+
+            // first layer overwrites destination (if required), others are mixed
+            if (first && overwrite) TransferSamples(s, srcchannel, channels, d, dstchannel, ndstchannels, nchannels, n);
+            else                    MixSamples(s, srcchannel, channels, d, dstchannel, ndstchannels, nchannels, n);
+
+            // clear read data so that the slab is clear when re-used
+            memset(s, 0, n * channels * sizeof(*s));
+
+            d    += n * ndstchannels;
+            p    += n;
+            left -= n;
+          }
+
+          first = 0;
+        }
+      }
+
+      // release space to producers
+      readpos.store(pos + nframes, std::memory_order_release);
+    }
+
+    return nframes;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Read data from buffer, summing all layers
+   *
+   * @param dst destination buffer to write to
+   * @param nframes number of frames to read (will be limited)
+   * @param overwrite true to overwrite data in destination, false to add data to destination
+   *
+   * @return number of frames actually read
+   *
+   * @note all internal channels are transfered
+   * @note dst is *assumed* to be of the same number of channels as this object
+   * @note dst will be expanded to fit frames, if necessary (which is not real-time safe)
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t ReadBuffer(std::vector<T>& dst, uint_t nframes, bool overwrite = true)
+  {
+    nframes = std::min(nframes, GetAvailableFrames());
+    if ((channels * nframes) > dst.size()) dst.resize(channels * nframes);
+    return nframes ? ReadBuffer(0, &dst[0], 0, channels, channels, nframes, overwrite) : 0;
+  }
+
+protected:
+  /*--------------------------------------------------------------------------------*/
+  /** Wake any waiting consumer
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Notify()
+  {
+    // order the publication of data (above) before the check for waiters (see WaitForFrames())
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_seq_cst))
+    {
+      std::lock_guard<std::mutex> lock(waitlock);
+      waitcondition.notify_all();
+    }
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Delete all layers
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Clear()
+  {
+    uint_t i;
+
+    for (i = 0; i < (uint_t)layers.size(); i++) delete layers[i];
+    layers.clear();
+    nlayers = 0;
+  }
+
+protected:
+  typedef struct
+  {
+    std::vector<T>        slab;         // circular slab of frames
+    std::atomic<uint64_t> written;      // absolute position written up to (published)
+    std::atomic<bool>     active;
+    bool                  reserved;     // being added (protected by layerlock)
+  } LAYER;
+
+  std::vector<LAYER *>    layers;
+  uint_t                  channels;
+  uint_t                  slabframes;
+  std::atomic<uint64_t>   readpos;      // absolute read position (published)
+  std::atomic<uint_t>     nlayers;
+  std::atomic<uint_t>     waiters;
+  std::mutex              layerlock;    // protects adding/deleting layers against reading
+  std::mutex              waitlock;
+  std::condition_variable waitcondition;
+
+private:
+  // copying is not supported
+  ConcurrentMultilayerBuffer(const ConcurrentMultilayerBuffer&);
+  ConcurrentMultilayerBuffer& operator = (const ConcurrentMultilayerBuffer&);
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
@@ -0,0 +1,462 @@
+#include <string.h>
+
+#include <algorithm>
+
+#define BBCDEBUG_LEVEL 1
+#include "Convolver.h"
+#include "simd_utils.h"
+
+BBC_AUDIOTOOLBOX_START
+
+Convolver::Convolver() : fft(NULL),
+                         blocksize(0),
+                         maxpartitions(0),
+                         stride(0),
+                         nslices(1),
+                         pos(0),
+                         head(0),
+                         generation(0),
+                         taskphase(Phase_Inputs),
+                         ntasks(0),
+                         busy(0),
+                         quit(false)
+{
+  nexttask  = 0;
+  tasksdone = 0;
+}
+
+Convolver::~Convolver()
+{
+  StopThreads();
+  FreeBuffers();
+}
+
+void Convolver::StopThreads()
+{
+  uint_t i;
+
+  {
+    std::lock_guard<std::mutex> lock(tlock);
+    quit = true;
+  }
+  taskcond.notify_all();
+
+  for (i = 0; i < threads.size(); i++)
+  {
+    threads[i]->join();
+    delete threads[i];
+  }
+  threads.clear();
+
+  quit = false;
+}
+
+void Convolver::FreeBuffers()
+{
+  uint_t i;
+
+  for (i = 0; i < inputs.size(); i++)
+  {
+    FFT::FreeBuffer(inputs[i].history);
+    FFT::FreeBuffer(inputs[i].fdl);
+  }
+  inputs.clear();
+
+  for (i = 0; i < outputs.size(); i++)
+  {
+    FFT::FreeBuffer(outputs[i].acc);
+    FFT::FreeBuffer(outputs[i].block);
+  }
+  outputs.clear();
+
+  for (i = 0; i < filters.size(); i++)
+  {
+    if (filters[i].owned) delete filters[i].filter;
+  }
+  filters.clear();
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set up convolver
+ *
+ * @param _blocksize block size (a power of 2)
+ * @param _ninputs number of inputs
+ * @param _noutputs number of outputs
+ * @param _maxpartitions maximum number of filter partitions
+ * @param nthreads number of worker threads (in addition to the thread calling Process())
+ *
+ * @return true if set up successfully
+ *
+ * @note all filters and routes are removed
+ */
+/*--------------------------------------------------------------------------------*/
+bool Convolver::Setup(uint_t _blocksize, uint_t _ninputs, uint_t _noutputs, uint_t _maxpartitions, uint_t nthreads)
+{
+  uint_t i;
+
+  StopThreads();
+  FreeBuffers();
+  blocksize = 0;
+
+  if (!_ninputs || !_noutputs || !_maxpartitions || ((fft = FFT::Get(2 * _blocksize)) == NULL))
+  {
+    BBCERROR("Invalid convolver parameters (block size %u, %u inputs, %u outputs, %u partitions)", _blocksize, _ninputs, _noutputs, _maxpartitions);
+    return false;
+  }
+
+  maxpartitions = _maxpartitions;
+  stride        = (FFT::GetRealBufferSize(2 * _blocksize) + 7) & ~7U;
+
+  inputs.resize(_ninputs);
+  for (i = 0; i < _ninputs; i++)
+  {
+    inputs[i].history = FFT::AllocateBuffer(2 * _blocksize);
+    inputs[i].fdl     = FFT::AllocateBuffer(maxpartitions * stride);
+    inputs[i].used    = false;
+    if (!inputs[i].history || !inputs[i].fdl) return false;
+  }
+
+  // split accumulation of each output into enough partition ranges for at least two tasks per thread
+  nslices = nthreads ? std::min((2 * (nthreads + 1) + _noutputs - 1) / _noutputs, maxpartitions) : 1;
+
+  outputs.resize(_noutputs);
+  for (i = 0; i < _noutputs; i++)
+  {
+    outputs[i].acc   = FFT::AllocateBuffer(nslices * stride);
+    outputs[i].block = FFT::AllocateBuffer(_blocksize);
+    if (!outputs[i].acc || !outputs[i].block) return false;
+  }
+
+  blocksize = _blocksize;
+
+  Reset();
+
+  for (i = 0; i < nthreads; i++) threads.push_back(new std::thread(&Convolver::WorkerThread, this));
+
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Add filter from impulse response
+ *
+ * @param ir impulse response
+ * @param irlength length of impulse response in samples
+ * @param gain gain to apply to impulse response
+ *
+ * @return filter index or -1 if the convolver is not set up or the filter could not be created
+ */
+/*--------------------------------------------------------------------------------*/
+sint_t Convolver::AddFilter(const float *ir, uint_t irlength, float gain)
+{
+  BlockConvolver::Filter *filter;
+
+  if (!blocksize || !ir || !irlength) return -1;
+
+  filter = new BlockConvolver::Filter(blocksize, ir, irlength, gain);
+  if (!filter->IsValid())
+  {
+    BBCERROR("Failed to create filter (block size %u, length %u)", blocksize, irlength);
+    delete filter;
+    return -1;
+  }
+
+  FILTER f = {filter, true};
+  filters.push_back(f);
+
+  return (sint_t)filters.size() - 1;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Add existing filter (which may be shared with other convolvers)
+ *
+ * @param filter filter with the same block size as this convolver
+ *
+ * @return filter index or -1 if filter is incompatible or invalid
+ *
+ * @note the filter is NOT copied and must not be deleted whilst in use
+ */
+/*--------------------------------------------------------------------------------*/
+sint_t Convolver::AddFilter(const BlockConvolver::Filter *filter)
+{
+  if (!filter || !filter->IsValid() || (filter->GetBlockSize() != blocksize))
+  {
+    BBCERROR("Filter is incompatible with convolver (block size %u)", blocksize);
+    return -1;
+  }
+
+  FILTER f = {filter, false};
+  filters.push_back(f);
+
+  return (sint_t)filters.size() - 1;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Add route from input to output through filter
+ *
+ * @return true if route is valid
+ */
+/*--------------------------------------------------------------------------------*/
+bool Convolver::AddRoute(uint_t input, uint_t output, uint_t filter)
+{
+  if ((input >= inputs.size()) || (output >= outputs.size()) || (filter >= filters.size()))
+  {
+    BBCERROR("Invalid convolver route (input %u, output %u, filter %u)", input, output, filter);
+    return false;
+  }
+
+  ROUTE route = {input, filter};
+  outputs[output].routes.push_back(route);
+  inputs[input].used = true;
+
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Remove all routes
+ */
+/*--------------------------------------------------------------------------------*/
+void Convolver::ClearRoutes()
+{
+  uint_t i;
+
+  for (i = 0; i < inputs.size(); i++)  inputs[i].used = false;
+  for (i = 0; i < outputs.size(); i++) outputs[i].routes.clear();
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Clear all input and output
+ */
+/*--------------------------------------------------------------------------------*/
+void Convolver::Reset()
+{
+  uint_t i;
+
+  for (i = 0; i < inputs.size(); i++)
+  {
+    memset(inputs[i].history, 0, 2 * blocksize * sizeof(*inputs[i].history));
+    memset(inputs[i].fdl,     0, maxpartitions * stride * sizeof(*inputs[i].fdl));
+  }
+  for (i = 0; i < outputs.size(); i++)
+  {
+    memset(outputs[i].block, 0, blocksize * sizeof(*outputs[i].block));
+  }
+
+  pos  = 0;
+  head = 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process audio
+ *
+ * @param src source buffer
+ * @param dst destination buffer
+ * @param srcchannel source channel of first input
+ * @param nsrcchannels total number of source channels
+ * @param dstchannel destination channel of first output
+ * @param ndstchannels total number of destination channels
+ * @param nframes number of sample frames to process
+ */
+/*--------------------------------------------------------------------------------*/
+void Convolver::Process(const Sample_t *src, Sample_t *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes)
+{
+  const uint_t nin  = std::min((uint_t)inputs.size(),  limited::subz(nsrcchannels, srcchannel));
+  const uint_t nout = std::min((uint_t)outputs.size(), limited::subz(ndstchannels, dstchannel));
+  uint_t i, j, n;
+
+  if (!blocksize) return;
+
+  src += srcchannel;
+  dst += dstchannel;
+  while (nframes)
+  {
+    n = std::min(nframes, blocksize - pos);
+
+    // input goes into second half of input history (zeros for inputs with no source channel), output comes from the previous block
+    for (i = 0; i < nin; i++)
+    {
+      float *p = inputs[i].history + blocksize + pos;
+      for (j = 0; j < n; j++) p[j] = (float)src[j * nsrcchannels + i];
+    }
+    for (; i < inputs.size(); i++)
+    {
+      memset(inputs[i].history + blocksize + pos, 0, n * sizeof(*inputs[i].history));
+    }
+    for (i = 0; i < nout; i++)
+    {
+      const float *p = outputs[i].block + pos;
+      for (j = 0; j < n; j++) dst[j * ndstchannels + i] = (Sample_t)p[j];
+    }
+
+    src     += n * nsrcchannels;
+    dst     += n * ndstchannels;
+    pos     += n;
+    nframes -= n;
+
+    if (pos == blocksize)
+    {
+      ProcessBlock();
+      pos = 0;
+    }
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process a complete block of input
+ */
+/*--------------------------------------------------------------------------------*/
+void Convolver::ProcessBlock()
+{
+  head = (head + maxpartitions - 1) % maxpartitions;
+
+  // all input spectra must be calculated before any output can be accumulated and all bins of an output accumulated before it can be inverse transformed
+  RunTasks(Phase_Inputs,     (uint_t)inputs.size());
+  RunTasks(Phase_Accumulate, (uint_t)outputs.size() * nslices);
+  RunTasks(Phase_Outputs,    (uint_t)outputs.size());
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Run all tasks of a phase on the audio thread and worker threads
+ */
+/*--------------------------------------------------------------------------------*/
+void Convolver::RunTasks(Phase_t phase, uint_t n)
+{
+  if (threads.size())
+  {
+    {
+      std::unique_lock<std::mutex> lock(tlock);
+
+      // wait for any worker still looking for tasks from the previous set
+      while (busy) donecond.wait(lock);
+
+      taskphase = phase;
+      ntasks    = n;
+      nexttask  = 0;
+      tasksdone = 0;
+      generation++;
+    }
+    taskcond.notify_all();
+
+    DoTasks(phase, n);
+
+    std::unique_lock<std::mutex> lock(tlock);
+    while (tasksdone < n) donecond.wait(lock);
+  }
+  else
+  {
+    uint_t i;
+
+    for (i = 0; i < n; i++) RunTask(phase, i);
+  }
+}
+
+void Convolver::DoTasks(Phase_t phase, uint_t n)
+{
+  uint_t i;
+
+  while ((i = nexttask++) < n)
+  {
+    RunTask(phase, i);
+
+    if ((++tasksdone) == n)
+    {
+      std::lock_guard<std::mutex> lock(tlock);
+      donecond.notify_all();
+    }
+  }
+}
+
+void Convolver::RunTask(Phase_t phase, uint_t index)
+{
+  if (phase == Phase_Inputs)
+  {
+    INPUT& input = inputs[index];
+
+    if (input.used)
+    {
+      // transform last two blocks of input into frequency-domain delay line
+      float *spectrum = input.fdl + head * stride;
+      memcpy(spectrum, input.history, 2 * blocksize * sizeof(*input.history));
+      fft->RealForward(spectrum);
+    }
+
+    // shift input along by one block
+    memcpy(input.history, input.history + blocksize, blocksize * sizeof(*input.history));
+  }
+  else if (phase == Phase_Accumulate)
+  {
+    OUTPUT&      output = outputs[index / nslices];
+    const uint_t slice  = index % nslices;
+    float        *acc   = output.acc + slice * stride;
+    uint_t       i, j;
+
+    if (output.routes.size())
+    {
+      // accumulate this slice's share of the partitions of all routes in the frequency domain
+      memset(acc, 0, stride * sizeof(*acc));
+      for (i = 0; i < output.routes.size(); i++)
+      {
+        const ROUTE&                  route  = output.routes[i];
+        const INPUT&                  input  = inputs[route.input];
+        const BlockConvolver::Filter *filter = filters[route.filter].filter;
+        const uint_t                  np     = std::min(filter->GetPartitions(), maxpartitions);
+        const uint_t                  j2     = ((slice + 1) * np) / nslices;
+
+        for (j = (slice * np) / nslices; j < j2; j++)
+        {
+          ComplexMultiplyAccumulate(acc, input.fdl + ((head + j) % maxpartitions) * stride, filter->GetPartition(j), blocksize + 1);
+        }
+      }
+    }
+  }
+  else
+  {
+    OUTPUT& output = outputs[index];
+    uint_t  i, j;
+
+    if (output.routes.size())
+    {
+      // sum partial spectra of slices
+      for (i = 1; i < nslices; i++)
+      {
+        const float *acc = output.acc + i * stride;
+        for (j = 0; j < 2 * (blocksize + 1); j++) output.acc[j] += acc[j];
+      }
+
+      // single inverse transform, second half is the (non-aliased) output
+      fft->RealInverse(output.acc);
+      memcpy(output.block, output.acc + blocksize, blocksize * sizeof(*output.block));
+    }
+    else memset(output.block, 0, blocksize * sizeof(*output.block));
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Worker thread
+ */
+/*--------------------------------------------------------------------------------*/
+void Convolver::Worker()
+{
+  std::unique_lock<std::mutex> lock(tlock);
+  uint64_t seen = generation;
+
+  while (!quit)
+  {
+    if (generation != seen)
+    {
+      const Phase_t phase = taskphase;
+      const uint_t  n     = ntasks;
+
+      seen = generation;
+      busy++;
+      lock.unlock();
+
+      DoTasks(phase, n);
+
+      lock.lock();
+      if (!(--busy)) donecond.notify_all();
+    }
+    else taskcond.wait(lock);
+  }
+}
+
+BBC_AUDIOTOOLBOX_END
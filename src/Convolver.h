@@ -0,0 +1,212 @@
+#ifndef __CONVOLVER__
+#define __CONVOLVER__
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "BlockConvolver.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Multi-channel uniformly partitioned convolver
+ *
+ * Any number of routes, each convolving an input with a filter (see BlockConvolver::Filter) and adding
+ * the result to an output, are processed together such that:
+ *   the spectrum of each input is calculated once per block, whatever number of routes use it
+ *   filter spectra are shared by all routes that use them
+ *   the routes to each output are accumulated in the frequency domain so that each output needs only
+ *   a single inverse transform per block
+ *
+ * Each block is processed in three phases (input transforms, output accumulation and output inverse
+ * transforms), the tasks of each phase being shared between the audio thread and a pool of worker
+ * threads; the accumulation (which is most of the work) is split into ranges of partitions of each
+ * output, the partial spectra being summed before the inverse transform, so that it is spread over
+ * all threads even when there are fewer outputs than threads (e.g. binaural)
+ *
+ * The latency is one block
+ *
+ * @note filters and routes must not be changed whilst Process() is being called
+ */
+/*--------------------------------------------------------------------------------*/
+class Convolver
+{
+public:
+  Convolver();
+  ~Convolver();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set up convolver
+   *
+   * @param _blocksize block size (a power of 2)
+   * @param _ninputs number of inputs
+   * @param _noutputs number of outputs
+   * @param _maxpartitions maximum number of filter partitions
+   * @param nthreads number of worker threads (in addition to the thread calling Process())
+   *
+   * @return true if set up successfully
+   *
+   * @note all filters and routes are removed
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool Setup(uint_t _blocksize, uint_t _ninputs, uint_t _noutputs, uint_t _maxpartitions, uint_t nthreads = 0);
+
+  uint_t GetBlockSize()     const {return blocksize;}
+  uint_t GetInputs()        const {return (uint_t)inputs.size();}
+  uint_t GetOutputs()       const {return (uint_t)outputs.size();}
+  uint_t GetMaxPartitions() const {return maxpartitions;}
+  uint_t GetLatency()       const {return blocksize;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Add filter from impulse response
+   *
+   * @param ir impulse response
+   * @param irlength length of impulse response in samples
+   * @param gain gain to apply to impulse response
+   *
+   * @return filter index or -1 if the convolver is not set up or the filter could not be created
+   */
+  /*--------------------------------------------------------------------------------*/
+  sint_t AddFilter(const float *ir, uint_t irlength, float gain = 1.f);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Add existing filter (which may be shared with other convolvers)
+   *
+   * @param filter filter with the same block size as this convolver
+   *
+   * @return filter index or -1 if filter is incompatible or invalid
+   *
+   * @note the filter is NOT copied and must not be deleted whilst in use
+   */
+  /*--------------------------------------------------------------------------------*/
+  sint_t AddFilter(const BlockConvolver::Filter *filter);
+
+  uint_t GetFilters() const {return (uint_t)filters.size();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Add route from input to output through filter
+   *
+   * @return true if route is valid
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool AddRoute(uint_t input, uint_t output, uint_t filter);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Remove all routes
+   */
+  /*--------------------------------------------------------------------------------*/
+  void ClearRoutes();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Clear all input and output
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Process audio
+   *
+   * @param src source buffer
+   * @param dst destination buffer
+   * @param srcchannel source channel of first input
+   * @param nsrcchannels total number of source channels
+   * @param dstchannel destination channel of first output
+   * @param ndstchannels total number of destination channels
+   * @param nframes number of sample frames to process
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Process(const Sample_t *src, Sample_t *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes);
+
+protected:
+  typedef enum
+  {
+    Phase_Inputs = 0,
+    Phase_Accumulate,
+    Phase_Outputs,
+  } Phase_t;
+
+  typedef struct
+  {
+    const BlockConvolver::Filter *filter;
+    bool                         owned;
+  } FILTER;
+
+  typedef struct
+  {
+    uint_t input;
+    uint_t filter;
+  } ROUTE;
+
+  typedef struct
+  {
+    float *history;             // last two blocks of input
+    float *fdl;                 // frequency-domain delay line (maxpartitions spectra)
+    bool  used;                 // true if any route uses this input
+  } INPUT;
+
+  typedef struct
+  {
+    std::vector<ROUTE> routes;
+    float              *acc;    // spectrum accumulators, one per slice (the first is also the inverse transform buffer)
+    float              *block;  // current block of output
+  } OUTPUT;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Process a complete block of input
+   */
+  /*--------------------------------------------------------------------------------*/
+  void ProcessBlock();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Run all tasks of a phase on the audio thread and worker threads
+   */
+  /*--------------------------------------------------------------------------------*/
+  void RunTasks(Phase_t phase, uint_t n);
+  void DoTasks(Phase_t phase, uint_t n);
+  void RunTask(Phase_t phase, uint_t index);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Worker thread
+   */
+  /*--------------------------------------------------------------------------------*/
+  static void WorkerThread(Convolver *convolver) {convolver->Worker();}
+  void Worker();
+
+  void StopThreads();
+  void FreeBuffers();
+
+protected:
+  const FFT                  *fft;
+  uint_t                     blocksize;
+  uint_t                     maxpartitions;
+  uint_t                     stride;        // floats per spectrum
+  uint_t                     nslices;       // number of accumulation tasks (partition ranges) per output
+  uint_t                     pos;           // position within input/output blocks
+  uint_t                     head;          // index of most recent spectra in frequency-domain delay lines
+  std::vector<FILTER>        filters;
+  std::vector<INPUT>         inputs;
+  std::vector<OUTPUT>        outputs;
+  std::vector<std::thread *> threads;
+  std::mutex                 tlock;
+  std::condition_variable    taskcond;      // signalled when tasks are available
+  std::condition_variable    donecond;      // signalled when tasks are complete or a worker is idle
+  uint64_t                   generation;    // incremented for each set of tasks (protected by tlock)
+  Phase_t                    taskphase;     // (protected by tlock)
+  uint_t                     ntasks;        // (protected by tlock)
+  uint_t                     busy;          // number of workers running tasks (protected by tlock)
+  std::atomic<uint_t>        nexttask;
+  std::atomic<uint_t>        tasksdone;
+  bool                       quit;
+
+private:
+  // copying is not supported
+  Convolver(const Convolver&);
+  Convolver& operator = (const Convolver&);
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
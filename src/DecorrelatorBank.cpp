@@ -0,0 +1,354 @@
+
+#include <math.h>
+
+#include <algorithm>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#elif defined(__SSE3__)
+#include <pmmintrin.h>
+#endif
+
+#define BBCDEBUG_LEVEL 1
+#include "DecorrelatorBank.h"
+
+BBC_AUDIOTOOLBOX_START
+
+DecorrelatorBank::DecorrelatorBank() : noutputs(0),
+                                       nstages(0),
+                                       blockframes(1)
+{
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set up bank with explicit delays and coeffs
+ *
+ * @param _noutputs number of outputs (chains)
+ * @param _nstages number of all-pass stages in each chain
+ * @param _delays array of (_noutputs * _nstages) delays in samples (output-major: all stages of output 0 first)
+ * @param _coeffs array of (_noutputs * _nstages) coeffs (same order)
+ *
+ * @return true if set up successfully
+ *
+ * @note all outputs initially take their input from source channel 0
+ */
+/*--------------------------------------------------------------------------------*/
+bool DecorrelatorBank::Setup(uint_t _noutputs, uint_t _nstages, const uint_t *_delays, const float *_coeffs)
+{
+  uint_t i, j, length = 0;
+
+  if (!_noutputs || !_nstages || !_delays || !_coeffs)
+  {
+    BBCERROR("Invalid decorrelator bank parameters (%u outputs, %u stages)", _noutputs, _nstages);
+    return false;
+  }
+
+  noutputs = _noutputs;
+  nstages  = _nstages;
+
+  delays.resize(noutputs * nstages);
+  coeffs.resize(noutputs * nstages);
+  inputs.assign(noutputs, 0);
+  stages.resize(nstages);
+
+  // re-arrange into stage-major order so that each stage's parameters are contiguous across outputs
+  blockframes = MaxBlockFrames;
+  for (i = 0; i < nstages; i++)
+  {
+    STAGE& stage = stages[i];
+
+    stage.offset = length * noutputs;
+    stage.length = 1;
+    stage.pos    = 0;
+
+    for (j = 0; j < noutputs; j++)
+    {
+      const uint_t delay = std::max(_delays[j * nstages + i], 1u);
+
+      delays[i * noutputs + j] = delay;
+      coeffs[i * noutputs + j] = _coeffs[j * nstages + i];
+
+      stage.length = std::max(stage.length, delay);
+
+      // blocks can be no longer than the shortest delay
+      blockframes  = std::min(blockframes, delay);
+    }
+
+    length += stage.length;
+  }
+
+  state.resize(length * noutputs);
+  block.resize(MaxBlockFrames * noutputs);
+  delayed.resize(MaxBlockFrames * noutputs);
+
+  BBCDEBUG1(("Decorrelator bank: %u outputs, %u stages, %u samples of state, %u frames per block", noutputs, nstages, (uint_t)state.size(), blockframes));
+
+  Reset();
+
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set up bank from a generated preset (see GeneratePreset())
+ */
+/*--------------------------------------------------------------------------------*/
+bool DecorrelatorBank::SetupPreset(uint_t _noutputs, uint_t _nstages, double samplerate, double maxdelay, float coeff, uint32_t seed)
+{
+  std::vector<uint_t> _delays;
+  std::vector<float>  _coeffs;
+
+  GeneratePreset(_noutputs, _nstages, samplerate, _delays, _coeffs, maxdelay, coeff, seed);
+
+  return Setup(_noutputs, _nstages, _delays.size() ? &_delays[0] : NULL, _coeffs.size() ? &_coeffs[0] : NULL);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return true if n is prime
+ */
+/*--------------------------------------------------------------------------------*/
+static bool IsPrime(uint_t n)
+{
+  uint_t i;
+
+  if (n < 2) return false;
+  for (i = 2; (i * i) <= n; i++)
+  {
+    if (!(n % i)) return false;
+  }
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Simple repeatable random number generator returning values in the range 0 <= x < 1
+ */
+/*--------------------------------------------------------------------------------*/
+static double Random(uint32_t& seed)
+{
+  seed = seed * 1664525 + 1013904223;
+  return (double)(seed >> 8) / 16777216.0;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Generate a set of delays and coeffs for a bank of mutually decorrelated chains
+ *
+ * @param noutputs number of outputs (chains)
+ * @param nstages number of all-pass stages in each chain
+ * @param samplerate sample rate
+ * @param delays destination for (noutputs * nstages) delays in samples (output-major)
+ * @param coeffs destination for (noutputs * nstages) coeffs (output-major)
+ * @param maxdelay nominal total delay of each chain in seconds
+ * @param coeff nominal coeff magnitude
+ * @param seed seed for random variations (the same seed always gives the same preset)
+ *
+ * Each stage is given a nominal delay, with delays decreasing geometrically along the chain, and
+ * every output is given the nearest unused prime delay (so that no two chains share any delay and
+ * all delays are mutually prime), coeffs are randomly varied around the nominal magnitude with
+ * alternating signs
+ *
+ * The sum of the nominal delays of each chain is maxdelay, keeping impulse responses short to limit
+ * the smearing of transients (with many outputs, delays spread further from the nominal delays)
+ */
+/*--------------------------------------------------------------------------------*/
+void DecorrelatorBank::GeneratePreset(uint_t noutputs, uint_t nstages, double samplerate,
+                                      std::vector<uint_t>& delays, std::vector<float>& coeffs,
+                                      double maxdelay, float coeff, uint32_t seed)
+{
+  const double        ratio = .6;           // ratio of nominal delays of successive stages
+  const double        total = maxdelay * samplerate;
+  const uint_t        mind  = std::max((uint_t)(.0005 * samplerate), 2u);   // very short delays decorrelate poorly
+  std::vector<uint_t> used;
+  std::vector<uint_t> stagedelays(noutputs);
+  double              nominal;
+  uint_t              i, j;
+
+  delays.resize(noutputs * nstages);
+  coeffs.resize(noutputs * nstages);
+  if (!noutputs) return;
+
+  // nominal delay of first stage such that the sum of nominal delays is the total
+  nominal = total * (1.0 - ratio) / (1.0 - pow(ratio, (double)nstages));
+
+  for (i = 0; i < nstages; i++, nominal *= ratio)
+  {
+    // find the noutputs unused primes nearest the nominal delay (searching alternately either side)
+    const uint_t centre = std::max((uint_t)floor(nominal + .5), mind);
+    uint_t       n = 0, k;
+
+    for (k = 0; n < noutputs; k++)
+    {
+      uint_t d;
+
+      if ((k & 1) && (centre >= (mind + (k >> 1) + 1))) d = centre - ((k >> 1) + 1);
+      else if (!(k & 1))                                d = centre + (k >> 1);
+      else continue;
+
+      if (IsPrime(d) && (std::find(used.begin(), used.end(), d) == used.end()))
+      {
+        used.push_back(d);
+        stagedelays[n++] = d;
+      }
+    }
+
+    // shuffle so that the delays of a chain are not all consistently shorter or longer than those of another
+    for (j = noutputs - 1; j > 0; j--)
+    {
+      std::swap(stagedelays[j], stagedelays[(uint_t)(Random(seed) * (double)(j + 1))]);
+    }
+
+    for (j = 0; j < noutputs; j++)
+    {
+      delays[j * nstages + i] = stagedelays[j];
+      // vary coeffs by +/- 20% and alternate signs between stages and between outputs
+      coeffs[j * nstages + i] = (float)((((i + j) & 1) ? -1.0 : 1.0) * coeff * (.8 + .4 * Random(seed)));
+    }
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Clear all state
+ */
+/*--------------------------------------------------------------------------------*/
+void DecorrelatorBank::Reset()
+{
+  uint_t i;
+
+  std::fill(state.begin(), state.end(), 0.f);
+  for (i = 0; i < stages.size(); i++) stages[i].pos = 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process all outputs of a frame through a stage
+ *
+ * Implements y[n] = c.x[n] + w[n - d], w[n] = x[n] - c.y[n] for each output
+ *
+ * @param data x[n] on entry, y[n] on exit
+ * @param delayed w[n - d]
+ * @param coeffs coeffs
+ * @param w destination for w[n]
+ * @param n number of outputs
+ */
+/*--------------------------------------------------------------------------------*/
+static void ProcessFrame(float *data, const float *delayed, const float *coeffs, float *w, uint_t n)
+{
+  uint_t i = 0;
+
+#if defined(__AVX__)
+  for (; (i + 8) <= n; i += 8)
+  {
+    const __m256 c = _mm256_loadu_ps(coeffs + i);
+    const __m256 x = _mm256_loadu_ps(data + i);
+    const __m256 y = _mm256_add_ps(_mm256_mul_ps(c, x), _mm256_loadu_ps(delayed + i));
+    _mm256_storeu_ps(data + i, y);
+    _mm256_storeu_ps(w + i, _mm256_sub_ps(x, _mm256_mul_ps(c, y)));
+  }
+#endif
+#if defined(__SSE3__)
+  for (; (i + 4) <= n; i += 4)
+  {
+    const __m128 c = _mm_loadu_ps(coeffs + i);
+    const __m128 x = _mm_loadu_ps(data + i);
+    const __m128 y = _mm_add_ps(_mm_mul_ps(c, x), _mm_loadu_ps(delayed + i));
+    _mm_storeu_ps(data + i, y);
+    _mm_storeu_ps(w + i, _mm_sub_ps(x, _mm_mul_ps(c, y)));
+  }
+#endif
+  for (; i < n; i++)
+  {
+    const float x = data[i];
+    data[i] = coeffs[i] * x + delayed[i];
+    w[i]    = x - coeffs[i] * data[i];
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process block (in block, nframes <= blockframes) through all stages
+ */
+/*--------------------------------------------------------------------------------*/
+void DecorrelatorBank::ProcessBlock(uint_t nframes)
+{
+  uint_t i, j, k;
+
+  for (i = 0; i < nstages; i++)
+  {
+    STAGE&       stage = stages[i];
+    float        *ring = &state[stage.offset];
+    const uint_t *d    = &delays[i * noutputs];
+    uint_t       pos;
+
+    // gather delayed samples for the whole block: since the block is no longer than any delay,
+    // none of these are written by this block
+    for (j = 0; j < noutputs; j++)
+    {
+      pos = (stage.pos + stage.length - d[j]) % stage.length;
+
+      for (k = 0; k < nframes; k++)
+      {
+        delayed[k * noutputs + j] = ring[pos * noutputs + j];
+        if ((++pos) == stage.length) pos = 0;
+      }
+    }
+
+    // process frames, writing new state directly into ring buffer
+    for (k = 0, pos = stage.pos; k < nframes; k++)
+    {
+      ProcessFrame(&block[k * noutputs], &delayed[k * noutputs], &coeffs[i * noutputs], ring + pos * noutputs, noutputs);
+      if ((++pos) == stage.length) pos = 0;
+    }
+
+    stage.pos = pos;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process audio
+ *
+ * @param src source buffer
+ * @param dst destination buffer
+ * @param srcchannel source starting channel
+ * @param nsrcchannels total number of source channels
+ * @param dstchannel destination starting channel
+ * @param ndstchannels total number of destination channels
+ * @param nframes number of sample frames to process
+ *
+ * @note output n is written to destination channel (dstchannel + n)
+ * @note src and dst MUST NOT overlap
+ */
+/*--------------------------------------------------------------------------------*/
+void DecorrelatorBank::Process(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes)
+{
+  if (!noutputs) return;
+
+  const uint_t nin  = limited::subz(nsrcchannels, srcchannel);
+  const uint_t nout = std::min(noutputs, limited::subz(ndstchannels, dstchannel));
+
+  // offset buffer pointers by starting channels
+  src += srcchannel;
+  dst += dstchannel;
+
+  while (nframes)
+  {
+    const uint_t n = std::min(nframes, blockframes);
+    uint_t i, j;
+
+    // distribute inputs to outputs (missing channels are silent)
+    for (i = 0; i < n; i++, src += nsrcchannels)
+    {
+      float *p = &block[i * noutputs];
+
+      for (j = 0; j < noutputs; j++) p[j] = (inputs[j] < nin) ? src[inputs[j]] : 0.f;
+    }
+
+    ProcessBlock(n);
+
+    for (i = 0; i < n; i++, dst += ndstchannels)
+    {
+      const float *p = &block[i * noutputs];
+
+      for (j = 0; j < nout; j++) dst[j] = p[j];
+    }
+
+    nframes -= n;
+  }
+}
+
+BBC_AUDIOTOOLBOX_END
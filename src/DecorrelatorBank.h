@@ -0,0 +1,154 @@
+#ifndef __DECORRELATOR_BANK__
+#define __DECORRELATOR_BANK__
+
+#include <vector>
+
+#include <bbcat-base/misc.h>
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Bank of all-pass decorrelators
+ *
+ * Each output is the input passed through its own chain of all-pass filters (see AllPassFilter),
+ * all chains having the same number of stages but each stage having different delays and coeffs
+ * for each output
+ *
+ * The state of all chains is held in a single structure: for each stage, one ring buffer of frames
+ * with one sample per output, so that each stage processes all outputs together (SIMD across outputs)
+ *
+ * Audio is processed in blocks no longer than the shortest delay so that all delayed samples for a
+ * block are available before the block is processed
+ *
+ * GeneratePreset() generates sets of delays and coeffs which are mutually decorrelated whilst keeping
+ * the impulse response of each chain short (to preserve transients)
+ */
+/*--------------------------------------------------------------------------------*/
+class DecorrelatorBank
+{
+public:
+  DecorrelatorBank();
+  ~DecorrelatorBank() {}
+
+  enum
+  {
+    MaxBlockFrames = 256,
+  };
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set up bank with explicit delays and coeffs
+   *
+   * @param _noutputs number of outputs (chains)
+   * @param _nstages number of all-pass stages in each chain
+   * @param _delays array of (_noutputs * _nstages) delays in samples (output-major: all stages of output 0 first)
+   * @param _coeffs array of (_noutputs * _nstages) coeffs (same order)
+   *
+   * @return true if set up successfully
+   *
+   * @note all outputs initially take their input from source channel 0
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool Setup(uint_t _noutputs, uint_t _nstages, const uint_t *_delays, const float *_coeffs);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set up bank from a generated preset (see GeneratePreset())
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool SetupPreset(uint_t _noutputs, uint_t _nstages, double samplerate, double maxdelay = .015, float coeff = .5f, uint32_t seed = 1);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Generate a set of delays and coeffs for a bank of mutually decorrelated chains
+   *
+   * @param noutputs number of outputs (chains)
+   * @param nstages number of all-pass stages in each chain
+   * @param samplerate sample rate
+   * @param delays destination for (noutputs * nstages) delays in samples (output-major)
+   * @param coeffs destination for (noutputs * nstages) coeffs (output-major)
+   * @param maxdelay nominal total delay of each chain in seconds
+   * @param coeff nominal coeff magnitude
+   * @param seed seed for random variations (the same seed always gives the same preset)
+   *
+   * Each stage is given a nominal delay, with delays decreasing geometrically along the chain, and
+   * every output is given the nearest unused prime delay (so that no two chains share any delay and
+   * all delays are mutually prime), coeffs are randomly varied around the nominal magnitude with
+   * alternating signs
+   *
+   * The sum of the nominal delays of each chain is maxdelay, keeping impulse responses short to limit
+   * the smearing of transients (with many outputs, delays spread further from the nominal delays)
+   */
+  /*--------------------------------------------------------------------------------*/
+  static void GeneratePreset(uint_t noutputs, uint_t nstages, double samplerate,
+                             std::vector<uint_t>& delays, std::vector<float>& coeffs,
+                             double maxdelay = .015, float coeff = .5f, uint32_t seed = 1);
+
+  uint_t GetOutputs() const {return noutputs;}
+  uint_t GetStages()  const {return nstages;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return delay and coeff of a stage of an output
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetDelay(uint_t output, uint_t stage) const {return ((output < noutputs) && (stage < nstages)) ? delays[stage * noutputs + output] : 0;}
+  float  GetCoeff(uint_t output, uint_t stage) const {return ((output < noutputs) && (stage < nstages)) ? coeffs[stage * noutputs + output] : 0.f;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set source channel (relative to srcchannel in Process()) for an output
+   */
+  /*--------------------------------------------------------------------------------*/
+  void   SetInput(uint_t output, uint_t channel) {if (output < noutputs) inputs[output] = channel;}
+  uint_t GetInput(uint_t output) const {return (output < noutputs) ? inputs[output] : 0;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Clear all state
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Process audio
+   *
+   * @param src source buffer
+   * @param dst destination buffer
+   * @param srcchannel source starting channel
+   * @param nsrcchannels total number of source channels
+   * @param dstchannel destination starting channel
+   * @param ndstchannels total number of destination channels
+   * @param nframes number of sample frames to process
+   *
+   * @note output n is written to destination channel (dstchannel + n)
+   * @note src and dst MUST NOT overlap
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Process(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes);
+
+protected:
+  /*--------------------------------------------------------------------------------*/
+  /** Process block (in block, nframes <= blockframes) through all stages
+   */
+  /*--------------------------------------------------------------------------------*/
+  void ProcessBlock(uint_t nframes);
+
+protected:
+  typedef struct
+  {
+    uint_t offset;              // offset of ring buffer within state
+    uint_t length;              // length of ring buffer in frames (longest delay of stage)
+    uint_t pos;                 // write position in frames
+  } STAGE;
+
+protected:
+  uint_t              noutputs;
+  uint_t              nstages;
+  std::vector<uint_t> delays;           // stage-major
+  std::vector<float>  coeffs;           // stage-major
+  std::vector<uint_t> inputs;
+  std::vector<STAGE>  stages;
+  std::vector<float>  state;            // ring buffers for all stages (frames of noutputs samples)
+  std::vector<float>  block;            // block of frames (noutputs samples per frame)
+  std::vector<float>  delayed;          // block of delayed samples
+  uint_t              blockframes;
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
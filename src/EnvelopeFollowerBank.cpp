@@ -0,0 +1,268 @@
+#include <math.h>
+
+#include <algorithm>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#elif defined(__SSE3__)
+#include <pmmintrin.h>
+#endif
+
+#define BBCDEBUG_LEVEL 1
+#include "EnvelopeFollowerBank.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Update n envelopes with one frame of detector input
+ *
+ * @param x input samples
+ * @param env envelopes
+ * @param hold maximum envelopes
+ * @param att attack coeffs
+ * @param rel release coeffs
+ * @param n number of channels
+ * @param square true to square input (RMS), false for absolute value (peak)
+ */
+/*--------------------------------------------------------------------------------*/
+static void UpdateEnvelopes(const float *x, float *env, float *hold, const float *att, const float *rel, uint_t n, bool square)
+{
+  uint_t i = 0;
+
+#ifdef __AVX__
+  {
+    const __m256 absmask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+    for (; (i + 8) <= n; i += 8)
+    {
+      const __m256 s = _mm256_loadu_ps(x + i);
+      const __m256 d = square ? _mm256_mul_ps(s, s) : _mm256_and_ps(s, absmask);
+      const __m256 e = _mm256_loadu_ps(env + i);
+      // select attack coeff where detector is above envelope, otherwise release
+      const __m256 c = _mm256_blendv_ps(_mm256_loadu_ps(rel + i), _mm256_loadu_ps(att + i), _mm256_cmp_ps(d, e, _CMP_GT_OQ));
+      const __m256 y = _mm256_add_ps(d, _mm256_mul_ps(c, _mm256_sub_ps(e, d)));
+
+      _mm256_storeu_ps(env + i, y);
+      _mm256_storeu_ps(hold + i, _mm256_max_ps(_mm256_loadu_ps(hold + i), y));
+    }
+  }
+#endif
+#if defined(__AVX__) || defined(__SSE3__)
+  {
+    const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    for (; (i + 4) <= n; i += 4)
+    {
+      const __m128 s = _mm_loadu_ps(x + i);
+      const __m128 d = square ? _mm_mul_ps(s, s) : _mm_and_ps(s, absmask);
+      const __m128 e = _mm_loadu_ps(env + i);
+      // select attack coeff where detector is above envelope, otherwise release
+      const __m128 m = _mm_cmpgt_ps(d, e);
+      const __m128 c = _mm_or_ps(_mm_and_ps(m, _mm_loadu_ps(att + i)), _mm_andnot_ps(m, _mm_loadu_ps(rel + i)));
+      const __m128 y = _mm_add_ps(d, _mm_mul_ps(c, _mm_sub_ps(e, d)));
+
+      _mm_storeu_ps(env + i, y);
+      _mm_storeu_ps(hold + i, _mm_max_ps(_mm_loadu_ps(hold + i), y));
+    }
+  }
+#endif
+  for (; i < n; i++)
+  {
+    const float d = square ? x[i] * x[i] : fabsf(x[i]);
+    const float c = (d > env[i]) ? att[i] : rel[i];
+
+    env[i]  = d + c * (env[i] - d);
+    hold[i] = std::max(hold[i], env[i]);
+  }
+}
+
+EnvelopeFollowerBank::EnvelopeFollowerBank() : channels(0),
+                                               samplerate(48000.0),
+                                               detector(Detector_Peak),
+                                               decimation(1),
+                                               count(0)
+{
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set up bank
+ *
+ * @param _channels number of channels
+ * @param _samplerate sample rate
+ * @param _preset initial ballistics
+ * @param _decimation number of frames per output frame
+ *
+ * @return true if set up successfully
+ */
+/*--------------------------------------------------------------------------------*/
+bool EnvelopeFollowerBank::Setup(uint_t _channels, double _samplerate, Preset_t _preset, uint_t _decimation)
+{
+  if (!_channels || (_samplerate <= 0.0))
+  {
+    BBCERROR("Invalid envelope follower parameters (%u channels, %0.1lfHz)", _channels, _samplerate);
+    return false;
+  }
+
+  channels   = _channels;
+  samplerate = _samplerate;
+
+  attackcoeffs.resize(channels);
+  releasecoeffs.resize(channels);
+  envelopes.resize(channels);
+  holds.resize(channels);
+  frame.resize(channels);
+
+  SetDecimation(_decimation);
+  SetPreset(_preset);
+
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set detector and ballistics of all channels from preset
+ */
+/*--------------------------------------------------------------------------------*/
+void EnvelopeFollowerBank::SetPreset(Preset_t preset)
+{
+  switch (preset)
+  {
+    default:
+    case Preset_Peak:
+      SetDetector(Detector_Peak);
+      SetBallistics(0.0, 1.5);
+      break;
+
+    case Preset_RMS:
+      SetDetector(Detector_RMS);
+      SetBallistics(.3, .3);
+      break;
+
+    case Preset_PPM:
+      // fall of 24dB in 2.8s
+      SetDetector(Detector_Peak);
+      SetBallistics(.0025, 2.8 / log(pow(10.0, 24.0 / 20.0)));
+      break;
+
+    case Preset_VU:
+      // 99% of reading in 300ms
+      SetDetector(Detector_Peak);
+      SetBallistics(.3 / log(100.0), .3 / log(100.0));
+      break;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set attack and release time constants of all channels or a single channel
+ *
+ * @param attack attack time constant in seconds (0 = instantaneous)
+ * @param release release time constant in seconds (0 = instantaneous)
+ */
+/*--------------------------------------------------------------------------------*/
+void EnvelopeFollowerBank::SetBallistics(double attack, double release)
+{
+  uint_t i;
+
+  for (i = 0; i < channels; i++) SetBallistics(i, attack, release);
+}
+
+void EnvelopeFollowerBank::SetBallistics(uint_t channel, double attack, double release)
+{
+  if (channel < channels)
+  {
+    attackcoeffs[channel]  = CalcCoeff(attack);
+    releasecoeffs[channel] = CalcCoeff(release);
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return one-pole coefficient for time constant
+ */
+/*--------------------------------------------------------------------------------*/
+float EnvelopeFollowerBank::CalcCoeff(double t) const
+{
+  return (t > 0.0) ? (float)exp(-1.0 / (t * samplerate)) : 0.f;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Reset envelopes
+ */
+/*--------------------------------------------------------------------------------*/
+void EnvelopeFollowerBank::Reset()
+{
+  std::fill(envelopes.begin(), envelopes.end(), 0.f);
+  std::fill(holds.begin(), holds.end(), 0.f);
+  count = 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process audio
+ *
+ * @param src source buffer
+ * @param dst destination buffer for decimated output (or NULL)
+ * @param srcchannel source starting channel
+ * @param nsrcchannels total number of source channels
+ * @param dstchannel destination starting channel
+ * @param ndstchannels total number of destination channels
+ * @param nframes number of sample frames to process
+ *
+ * @return number of (decimated) frames written to dst
+ *
+ * @note dst must have space for (nframes / GetDecimation()) + 1 frames
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t EnvelopeFollowerBank::Process(const Sample_t *src, Sample_t *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes)
+{
+  const uint_t nin  = std::min(channels, limited::subz(nsrcchannels, srcchannel));
+  const uint_t nout = dst ? std::min(channels, limited::subz(ndstchannels, dstchannel)) : 0;
+  const bool   square = (detector == Detector_RMS);
+  uint_t i, j, noutput = 0;
+
+  if (!channels) return 0;
+
+  // missing source channels are silent
+  std::fill(frame.begin(), frame.end(), 0.f);
+
+  src += srcchannel;
+  if (dst) dst += dstchannel;
+  for (i = 0; i < nframes; i++, src += nsrcchannels)
+  {
+    for (j = 0; j < nin; j++) frame[j] = (float)src[j];
+
+    UpdateEnvelopes(&frame[0], &envelopes[0], &holds[0], &attackcoeffs[0], &releasecoeffs[0], channels, square);
+
+    if ((++count) == decimation)
+    {
+      // output maximum envelopes of decimation period
+      if (dst)
+      {
+        for (j = 0; j < nout; j++) dst[j] = (Sample_t)(square ? sqrtf(holds[j]) : holds[j]);
+        dst += ndstchannels;
+        noutput++;
+      }
+
+      std::fill(holds.begin(), holds.end(), 0.f);
+      count = 0;
+    }
+  }
+
+  return noutput;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return current envelope of a channel / all channels
+ */
+/*--------------------------------------------------------------------------------*/
+Sample_t EnvelopeFollowerBank::GetEnvelope(uint_t channel) const
+{
+  if (channel < channels) return (Sample_t)((detector == Detector_RMS) ? sqrtf(envelopes[channel]) : envelopes[channel]);
+  return 0;
+}
+
+void EnvelopeFollowerBank::GetEnvelopes(Sample_t *dst) const
+{
+  uint_t i;
+
+  for (i = 0; i < channels; i++) dst[i] = GetEnvelope(i);
+}
+
+BBC_AUDIOTOOLBOX_END
@@ -0,0 +1,150 @@
+#ifndef __ENVELOPE_FOLLOWER_BANK__
+#define __ENVELOPE_FOLLOWER_BANK__
+
+#include <vector>
+
+#include <bbcat-base/misc.h>
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Bank of envelope followers (for meters and dynamics processors) for interleaved audio
+ *
+ * Each channel has a one-pole envelope follower with separate attack and release time constants,
+ * the coefficient for each sample is selected by a compare and mask (rather than a branch) so that
+ * all channels are processed together (SIMD across channels)
+ *
+ * The detector is either peak (absolute value) or RMS (square, with the square root taken on output)
+ *
+ * Output can be decimated for metering: every 'decimation' frames, the maximum envelope of each channel
+ * over those frames is output (so that no peaks are missed)
+ *
+ * Presets:
+ *   Peak: instantaneous attack, 1.5s release time constant
+ *   RMS:  300ms time constant (attack and release)
+ *   PPM:  BBC (IEC 60268-10 type IIa) style: 2.5ms attack, fall of 24dB in 2.8s
+ *   VU:   rectified average, 65ms time constant (99% of reading in 300ms)
+ */
+/*--------------------------------------------------------------------------------*/
+class EnvelopeFollowerBank
+{
+public:
+  EnvelopeFollowerBank();
+  ~EnvelopeFollowerBank() {}
+
+  typedef enum
+  {
+    Detector_Peak = 0,
+    Detector_RMS,
+  } Detector_t;
+
+  typedef enum
+  {
+    Preset_Peak = 0,
+    Preset_RMS,
+    Preset_PPM,
+    Preset_VU,
+  } Preset_t;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set up bank
+   *
+   * @param _channels number of channels
+   * @param _samplerate sample rate
+   * @param _preset initial ballistics
+   * @param _decimation number of frames per output frame
+   *
+   * @return true if set up successfully
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool Setup(uint_t _channels, double _samplerate, Preset_t _preset = Preset_Peak, uint_t _decimation = 1);
+
+  uint_t     GetChannels()   const {return channels;}
+  double     GetSampleRate() const {return samplerate;}
+  Detector_t GetDetector()   const {return detector;}
+  uint_t     GetDecimation() const {return decimation;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set detector and ballistics of all channels from preset
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetPreset(Preset_t preset);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set detector
+   *
+   * @note resets envelopes
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetDetector(Detector_t _detector) {detector = _detector; Reset();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set attack and release time constants of all channels or a single channel
+   *
+   * @param attack attack time constant in seconds (0 = instantaneous)
+   * @param release release time constant in seconds (0 = instantaneous)
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetBallistics(double attack, double release);
+  void SetBallistics(uint_t channel, double attack, double release);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set number of frames per output frame
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetDecimation(uint_t _decimation) {decimation = std::max(_decimation, (uint_t)1); count = 0;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Reset envelopes
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Process audio
+   *
+   * @param src source buffer
+   * @param dst destination buffer for decimated output (or NULL)
+   * @param srcchannel source starting channel
+   * @param nsrcchannels total number of source channels
+   * @param dstchannel destination starting channel
+   * @param ndstchannels total number of destination channels
+   * @param nframes number of sample frames to process
+   *
+   * @return number of (decimated) frames written to dst
+   *
+   * @note dst must have space for (nframes / GetDecimation()) + 1 frames
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t Process(const Sample_t *src, Sample_t *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return current envelope of a channel / all channels
+   */
+  /*--------------------------------------------------------------------------------*/
+  Sample_t GetEnvelope(uint_t channel) const;
+  void     GetEnvelopes(Sample_t *dst) const;
+
+protected:
+  /*--------------------------------------------------------------------------------*/
+  /** Return one-pole coefficient for time constant
+   */
+  /*--------------------------------------------------------------------------------*/
+  float CalcCoeff(double t) const;
+
+protected:
+  uint_t             channels;
+  double             samplerate;
+  Detector_t         detector;
+  uint_t             decimation;
+  uint_t             count;             // frames since last output frame
+  std::vector<float> attackcoeffs;
+  std::vector<float> releasecoeffs;
+  std::vector<float> envelopes;
+  std::vector<float> holds;             // maximum envelopes since last output frame
+  std::vector<float> frame;             // current input frame
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
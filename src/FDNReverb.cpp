@@ -0,0 +1,533 @@
+
+#include <math.h>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#elif defined(__SSE3__)
+#include <pmmintrin.h>
+#endif
+
+#define BBCDEBUG_LEVEL 1
+#include "FDNReverb.h"
+#include "BiQuad.h"
+
+BBC_AUDIOTOOLBOX_START
+
+FDNReverb::FDNReverb() : ninputs(0),
+                         noutputs(0),
+                         nlines(0),
+                         linesperoutput(0),
+                         samplerate(48000.0),
+                         matrix(Matrix_Hadamard),
+                         blockframes(1),
+                         rt60(2.0),
+                         rt60high(0.0),
+                         crossover(4000.0),
+                         dry(0.f),
+                         wet(1.f)
+{
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set up reverb
+ *
+ * @param _ninputs number of input channels
+ * @param _noutputs number of output channels
+ * @param _samplerate sample rate
+ * @param _nlines number of delay lines (power of 2, MinLines to MaxLines)
+ * @param _matrix feedback matrix type
+ *
+ * @return true if set up successfully
+ *
+ * @note default delays (20ms to 80ms), decay time (2s) and diffusion are set up
+ */
+/*--------------------------------------------------------------------------------*/
+bool FDNReverb::Setup(uint_t _ninputs, uint_t _noutputs, double _samplerate, uint_t _nlines, Matrix_t _matrix)
+{
+  uint_t i;
+
+  if (!_ninputs || !_noutputs || (_samplerate <= 0.0) ||
+      (_nlines < MinLines) || (_nlines > MaxLines) || (_nlines & (_nlines - 1)))
+  {
+    BBCERROR("Invalid FDN reverb parameters (%u inputs, %u outputs, %0.1lfHz, %u lines)", _ninputs, _noutputs, _samplerate, _nlines);
+    return false;
+  }
+
+  ninputs    = _ninputs;
+  noutputs   = _noutputs;
+  nlines     = _nlines;
+  samplerate = _samplerate;
+  matrix     = _matrix;
+
+  damping.num0.resize(nlines);
+  damping.num1.resize(nlines);
+  damping.num2.resize(nlines);
+  damping.den1.resize(nlines);
+  damping.den2.resize(nlines);
+  damping.w1.resize(nlines);
+  damping.w2.resize(nlines);
+
+  // pseudo-random (but repeatable) signs for distribution of inputs to lines and lines to outputs
+  // with the input gain such that the energy of the response is independent of the number of lines
+  inputsigns.resize(nlines);
+  {
+    const float         ingain = (float)sqrt((double)ninputs / (double)nlines);
+    std::vector<float>  linesigns(nlines);
+    uint32_t            seed   = 0x2545f491;
+    uint_t              step, nbits, j;
+
+    for (i = 0; i < nlines; i++)
+    {
+      seed = seed * 1664525 + 1013904223;
+      inputsigns[i] = (seed & 0x10000000) ? -ingain : ingain;
+      seed = seed * 1664525 + 1013904223;
+      linesigns[i]  = (seed & 0x10000000) ? -1.f : 1.f;
+    }
+
+    // with no more outputs than lines, each output takes a separate subset of (a power of 2) lines:
+    // output n takes lines n, n + step, n + 2 * step...
+    // with more outputs than lines, each output takes all lines with a different set of signs: the first
+    // nlines outputs use the (orthogonal) rows of a Hadamard matrix, each further set of nlines outputs
+    // uses the same rows multiplied by the quadratic form sum(bit[k] * bit[k + m]) of the line index
+    // (m = 1 ... log2(nlines) - 1) which keeps correlations between outputs low (at most 1/sqrt(nlines) between the
+    // first two sets); any outputs beyond these use pseudo-random signs
+    if (noutputs <= nlines)
+    {
+      for (linesperoutput = 1; (2 * linesperoutput * noutputs) <= nlines; linesperoutput *= 2) ;
+    }
+    else linesperoutput = nlines;
+    step = nlines / linesperoutput;
+    for (nbits = 0; (1U << nbits) < nlines; nbits++) ;
+
+    // gain such that the total energy of all outputs is independent of the number of outputs
+    const float outgain = (float)sqrt((double)nlines / (double)(noutputs * linesperoutput));
+
+    outputlines.resize(noutputs * linesperoutput);
+    outputgains.resize(noutputs * linesperoutput);
+    for (i = 0; i < noutputs; i++)
+    {
+      for (j = 0; j < linesperoutput; j++)
+      {
+        const uint_t line = ((i % step) + j * step) % nlines;
+        float        sign = linesigns[line];
+
+        if (i >= step)
+        {
+          // set of outputs (see above)
+          const uint_t set = i / nlines;
+
+          if (set < nbits)
+          {
+            // sign is parity of (Hadamard row & line) + quadratic form of line (both are linear over XOR)
+            uint_t bits = ((i % nlines) & line) ^ (set ? (line & (line >> set)) : 0), parity = 0;
+
+            for (; bits; bits &= bits - 1) parity ^= 1;
+            if (parity) sign = -sign;
+          }
+          else
+          {
+            seed  = seed * 1664525 + 1013904223;
+            sign *= (seed & 0x10000000) ? -1.f : 1.f;
+          }
+        }
+
+        outputlines[i * linesperoutput + j] = line;
+        outputgains[i * linesperoutput + j] = sign * outgain;
+      }
+    }
+  }
+
+  inblock.resize(MaxBlockFrames * ninputs);
+  diffblock.resize(MaxBlockFrames * ninputs);
+  outblock.resize(MaxBlockFrames * noutputs);
+  lineblock.resize(MaxBlockFrames * nlines);
+
+  diffusion.SetChannels(ninputs);
+
+  BBCDEBUG1(("FDN reverb: %u inputs, %u outputs, %u lines, %s matrix", ninputs, noutputs, nlines, (matrix == Matrix_Hadamard) ? "Hadamard" : "Householder"));
+
+  SetDelays(.02, .08);
+  SetDiffusion(4);
+
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return true if n is prime
+ */
+/*--------------------------------------------------------------------------------*/
+static bool IsPrime(uint_t n)
+{
+  uint_t i;
+
+  if (n < 2) return false;
+  for (i = 2; (i * i) <= n; i++)
+  {
+    if (!(n % i)) return false;
+  }
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set delays to be spread geometrically between two delays (and mutually prime)
+ *
+ * @param mindelay shortest delay in seconds
+ * @param maxdelay longest delay in seconds
+ *
+ * @note resets the delay lines
+ */
+/*--------------------------------------------------------------------------------*/
+void FDNReverb::SetDelays(double mindelay, double maxdelay)
+{
+  if (nlines)
+  {
+    std::vector<uint_t> _delays(nlines);
+    const double d1    = std::max(mindelay * samplerate, 2.0);
+    const double d2    = std::max(maxdelay * samplerate, d1);
+    const double ratio = pow(d2 / d1, 1.0 / (double)(nlines - 1));
+    uint_t i, last = 0;
+
+    for (i = 0; i < nlines; i++)
+    {
+      // use the next unused prime
+      uint_t d = std::max((uint_t)floor(d1 * pow(ratio, (double)i) + .5), last + 1);
+
+      while (!IsPrime(d)) d++;
+
+      _delays[i] = last = d;
+    }
+
+    SetDelays(&_delays[0]);
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set delays explicitly
+ *
+ * @param _delays array of GetLines() delays in samples (each at least 1)
+ *
+ * @note resets the delay lines
+ */
+/*--------------------------------------------------------------------------------*/
+void FDNReverb::SetDelays(const uint_t *_delays)
+{
+  uint_t i;
+
+  delays.resize(nlines);
+  lines.resize(nlines);
+
+  blockframes = MaxBlockFrames;
+  for (i = 0; i < nlines; i++)
+  {
+    delays[i] = std::max(_delays[i], 1u);
+    lines[i].SetLength(delays[i]);
+
+    // blocks can be no longer than the shortest delay
+    blockframes = std::min(blockframes, delays[i]);
+  }
+
+  BBCDEBUG1(("FDN reverb: delays %u to %u samples, %u frames per block", nlines ? delays[0] : 0, nlines ? delays[nlines - 1] : 0, blockframes));
+
+  UpdateDamping();
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set decay time (RT60)
+ *
+ * @param _rt60 time in seconds for the reverb to decay by 60dB at low frequencies
+ * @param _rt60high time in seconds for the reverb to decay by 60dB at high frequencies (0 = same as _rt60)
+ * @param _crossover crossover frequency between low and high frequency decay times
+ */
+/*--------------------------------------------------------------------------------*/
+void FDNReverb::SetDecayTime(double _rt60, double _rt60high, double _crossover)
+{
+  rt60      = _rt60;
+  rt60high  = _rt60high;
+  crossover = _crossover;
+  UpdateDamping();
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Recalculate damping filters from delays and decay times
+ */
+/*--------------------------------------------------------------------------------*/
+void FDNReverb::UpdateDamping()
+{
+  const double lowtime  = std::max(rt60, 1.0e-3);
+  const double hightime = (rt60high > 0.0) ? rt60high : lowtime;
+  const double freq     = std::min(crossover, .45 * samplerate);
+  uint_t i;
+
+  for (i = 0; i < delays.size(); i++)
+  {
+    // attenuation (dB) of one pass around a line of this length to give the required decay times
+    const double lowgain  = -60.0 * (double)delays[i] / (samplerate * lowtime);
+    const double highgain = -60.0 * (double)delays[i] / (samplerate * hightime);
+    const double scale    = pow(10.0, .05 * lowgain);
+
+    // high shelf sets the high frequency attenuation relative to the low frequency attenuation
+    BiQuadCoeffs coeffs(BiQuadCoeffs::HSH, freq, samplerate, highgain - lowgain);
+
+    damping.num0[i] = (float)(coeffs.current.num0 * scale);
+    damping.num1[i] = (float)(coeffs.current.num1 * scale);
+    damping.num2[i] = (float)(coeffs.current.num2 * scale);
+    damping.den1[i] = (float)coeffs.current.den1;
+    damping.den2[i] = (float)coeffs.current.den2;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set input diffusion
+ *
+ * @param nfilters number of all-pass filters (0 = no diffusion)
+ * @param coeff all-pass coeff
+ *
+ * @note resets the diffusion filters
+ */
+/*--------------------------------------------------------------------------------*/
+void FDNReverb::SetDiffusion(uint_t nfilters, float coeff)
+{
+  // mutually prime delays (in samples at 48kHz) between ~1ms and ~8ms
+  static const uint_t basedelays[] = {47, 113, 163, 233, 283, 353, 389};
+  std::vector<uint_t> _delays(nfilters);
+  std::vector<float>  coeffs(nfilters, coeff);
+  uint_t i;
+
+  for (i = 0; i < nfilters; i++)
+  {
+    _delays[i] = std::max((uint_t)floor(basedelays[i % NUMBEROF(basedelays)] * (1 + i / NUMBEROF(basedelays)) * samplerate / 48000.0 + .5), 1u);
+  }
+
+  diffusion.SetFilterCount(nfilters, nfilters ? &_delays[0] : NULL, nfilters ? &coeffs[0] : NULL);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Clear all delay lines and filters
+ */
+/*--------------------------------------------------------------------------------*/
+void FDNReverb::Reset()
+{
+  uint_t i;
+
+  for (i = 0; i < lines.size(); i++) lines[i].Reset();
+  std::fill(damping.w1.begin(), damping.w1.end(), 0.f);
+  std::fill(damping.w2.begin(), damping.w2.end(), 0.f);
+  diffusion.SetChannels(ninputs);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Apply normalised fast Walsh-Hadamard transform to n values in place (n a power of 2)
+ */
+/*--------------------------------------------------------------------------------*/
+void FDNReverb::Hadamard(float *data, uint_t n)
+{
+  const float scale = (float)(1.0 / sqrt((double)n));
+  uint_t h, i, j;
+
+  for (h = 1; h < n; h <<= 1)
+  {
+    for (i = 0; i < n; i += 2 * h)
+    {
+      float *p1 = data + i, *p2 = p1 + h;
+
+      j = 0;
+#if defined(__AVX__)
+      for (; (j + 8) <= h; j += 8)
+      {
+        __m256 a = _mm256_loadu_ps(p1 + j), b = _mm256_loadu_ps(p2 + j);
+        _mm256_storeu_ps(p1 + j, _mm256_add_ps(a, b));
+        _mm256_storeu_ps(p2 + j, _mm256_sub_ps(a, b));
+      }
+#endif
+#if defined(__SSE3__)
+      for (; (j + 4) <= h; j += 4)
+      {
+        __m128 a = _mm_loadu_ps(p1 + j), b = _mm_loadu_ps(p2 + j);
+        _mm_storeu_ps(p1 + j, _mm_add_ps(a, b));
+        _mm_storeu_ps(p2 + j, _mm_sub_ps(a, b));
+      }
+#endif
+      for (; j < h; j++)
+      {
+        float a = p1[j], b = p2[j];
+        p1[j] = a + b;
+        p2[j] = a - b;
+      }
+    }
+  }
+
+  for (i = 0; i < n; i++) data[i] *= scale;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Apply Householder reflection (I - 2/n . 1.1^T) to n values in place
+ */
+/*--------------------------------------------------------------------------------*/
+void FDNReverb::Householder(float *data, uint_t n)
+{
+  float  sum = 0.f;
+  uint_t i;
+
+  for (i = 0; i < n; i++) sum += data[i];
+  sum *= 2.f / (float)n;
+  for (i = 0; i < n; i++) data[i] -= sum;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process a frame of lines through the damping biquads (transposed direct form II)
+ */
+/*--------------------------------------------------------------------------------*/
+static void ProcessDamping(float *data, const float *num0, const float *num1, const float *num2, const float *den1, const float *den2, float *w1, float *w2, uint_t n)
+{
+  uint_t i = 0;
+
+#if defined(__AVX__)
+  for (; (i + 8) <= n; i += 8)
+  {
+    const __m256 x = _mm256_loadu_ps(data + i);
+    const __m256 y = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(num0 + i), x), _mm256_loadu_ps(w1 + i));
+    _mm256_storeu_ps(w1 + i, _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(num1 + i), x), _mm256_mul_ps(_mm256_loadu_ps(den1 + i), y)), _mm256_loadu_ps(w2 + i)));
+    _mm256_storeu_ps(w2 + i, _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(num2 + i), x), _mm256_mul_ps(_mm256_loadu_ps(den2 + i), y)));
+    _mm256_storeu_ps(data + i, y);
+  }
+#endif
+#if defined(__SSE3__)
+  for (; (i + 4) <= n; i += 4)
+  {
+    const __m128 x = _mm_loadu_ps(data + i);
+    const __m128 y = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(num0 + i), x), _mm_loadu_ps(w1 + i));
+    _mm_storeu_ps(w1 + i, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(num1 + i), x), _mm_mul_ps(_mm_loadu_ps(den1 + i), y)), _mm_loadu_ps(w2 + i)));
+    _mm_storeu_ps(w2 + i, _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(num2 + i), x), _mm_mul_ps(_mm_loadu_ps(den2 + i), y)));
+    _mm_storeu_ps(data + i, y);
+  }
+#endif
+  for (; i < n; i++)
+  {
+    const float x = data[i];
+    const float y = num0[i] * x + w1[i];
+    w1[i]   = num1[i] * x - den1[i] * y + w2[i];
+    w2[i]   = num2[i] * x - den2[i] * y;
+    data[i] = y;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process a block of frames (nframes <= shortest delay)
+ */
+/*--------------------------------------------------------------------------------*/
+void FDNReverb::ProcessBlock(uint_t nframes)
+{
+  uint_t i, j;
+
+  // diffuse input
+  diffusion.Process(&inblock[0], &diffblock[0], 0, ninputs, 0, ninputs, nframes);
+
+  // read outputs of lines for the whole block: since the block is no longer than any delay these were
+  // all written by previous blocks (the oldest sample of each line is in the slot that is written next)
+  for (i = 0; i < nlines; i++)
+  {
+    const float  *p  = lines[i].GetBuffer();
+    uint_t       pos = lines[i].GetPosition();
+
+    for (j = 0; j < nframes; j++)
+    {
+      lineblock[j * nlines + i] = p[pos];
+      if ((++pos) == delays[i]) pos = 0;
+    }
+  }
+
+  for (j = 0; j < nframes; j++)
+  {
+    float       *data = &lineblock[j * nlines];
+    float       *out  = &outblock[j * noutputs];
+    const float *in   = &diffblock[j * ninputs];
+
+    // damping
+    ProcessDamping(data,
+                   &damping.num0[0], &damping.num1[0], &damping.num2[0],
+                   &damping.den1[0], &damping.den2[0],
+                   &damping.w1[0], &damping.w2[0],
+                   nlines);
+
+    // outputs are taken from damped line outputs
+    for (i = 0; i < noutputs; i++)
+    {
+      const uint_t *ol  = &outputlines[i * linesperoutput];
+      const float  *og  = &outputgains[i * linesperoutput];
+      float        sum  = 0.f;
+      uint_t       k;
+
+      for (k = 0; k < linesperoutput; k++) sum += og[k] * data[ol[k]];
+      out[i] = sum;
+    }
+
+    // feedback matrix
+    if (matrix == Matrix_Hadamard) Hadamard(data, nlines);
+    else                           Householder(data, nlines);
+
+    // add input
+    for (i = 0; i < nlines; i++) data[i] += inputsigns[i] * in[i % ninputs];
+  }
+
+  // write new samples back into lines
+  for (i = 0; i < nlines; i++) lines[i].Write(&lineblock[i], nframes, nlines);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process audio
+ *
+ * @param src source buffer
+ * @param dst destination buffer
+ * @param srcchannel source starting channel
+ * @param nsrcchannels total number of source channels
+ * @param dstchannel destination starting channel
+ * @param ndstchannels total number of destination channels
+ * @param nframes number of sample frames to process
+ *
+ * @note GetInputs() channels are read from src and GetOutputs() channels are written to dst
+ * @note dry output channel n is input channel (n % GetInputs())
+ * @note src can == dst IFF src and dst channel parameters are the same
+ */
+/*--------------------------------------------------------------------------------*/
+void FDNReverb::Process(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes)
+{
+  if (!nlines) return;
+
+  const uint_t nin  = std::min(ninputs,  limited::subz(nsrcchannels, srcchannel));
+  const uint_t nout = std::min(noutputs, limited::subz(ndstchannels, dstchannel));
+
+  // offset buffer pointers by starting channels
+  src += srcchannel;
+  dst += dstchannel;
+
+  while (nframes)
+  {
+    const uint_t n = std::min(nframes, blockframes);
+    uint_t i, j;
+
+    // copy input (missing channels are silent)
+    for (i = 0; i < n; i++)
+    {
+      float *p = &inblock[i * ninputs];
+
+      for (j = 0; j < nin; j++) p[j] = src[i * nsrcchannels + j];
+      for (; j < ninputs; j++)  p[j] = 0.f;
+    }
+
+    ProcessBlock(n);
+
+    // mix dry input (undiffused) and wet output into destination
+    for (i = 0; i < n; i++, dst += ndstchannels)
+    {
+      const float *in  = &inblock[i * ninputs];
+      const float *out = &outblock[i * noutputs];
+
+      for (j = 0; j < nout; j++) dst[j] = dry * in[j % ninputs] + wet * out[j];
+    }
+
+    src     += n * nsrcchannels;
+    nframes -= n;
+  }
+}
+
+BBC_AUDIOTOOLBOX_END
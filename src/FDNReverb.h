@@ -0,0 +1,220 @@
+#ifndef __FDN_REVERB__
+#define __FDN_REVERB__
+
+#include <vector>
+
+#include "AllPassFilter.h"
+#include "RingBuffer.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Feedback delay network reverb
+ *
+ * N delay lines (N a power of two from 4 to 64, typically 8, 16 or 32) are fed back through an
+ * orthogonal matrix after each line's output has been passed through a damping biquad which sets
+ * the decay time of that line at low and high frequencies (a low/high shelf about a crossover)
+ *
+ * The feedback matrix is either a (normalised) Hadamard matrix, evaluated with a fast Walsh-Hadamard
+ * transform in O(N log N) operations, or a Householder reflection (I - 2/N . 1.1^T), evaluated in O(N)
+ *
+ * Inputs are optionally diffused by an AllPassFilterChain before being distributed (with varying signs)
+ * across the lines and outputs are taken from different subsets of lines, again with varying signs
+ * (if there are more outputs than lines, each output is a differently signed mix of all lines)
+ *
+ * Audio is processed in blocks no longer than the shortest delay so that the output of every line
+ * for the whole block is available before the block is processed, lines are then processed together
+ * with SIMD across lines
+ *
+ * Each instance holds all of its own state so separate instances (e.g. one per room) can be
+ * processed concurrently from different threads
+ */
+/*--------------------------------------------------------------------------------*/
+class FDNReverb
+{
+public:
+  typedef enum
+  {
+    Matrix_Hadamard = 0,
+    Matrix_Householder,
+  } Matrix_t;
+
+  FDNReverb();
+  ~FDNReverb() {}
+
+  enum
+  {
+    MaxBlockFrames = 256,
+    MinLines       = 4,
+    MaxLines       = 64,
+  };
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set up reverb
+   *
+   * @param _ninputs number of input channels
+   * @param _noutputs number of output channels
+   * @param _samplerate sample rate
+   * @param _nlines number of delay lines (power of 2, MinLines to MaxLines)
+   * @param _matrix feedback matrix type
+   *
+   * @return true if set up successfully
+   *
+   * @note default delays (20ms to 80ms), decay time (2s) and diffusion are set up
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool Setup(uint_t _ninputs, uint_t _noutputs, double _samplerate, uint_t _nlines = 16, Matrix_t _matrix = Matrix_Hadamard);
+
+  uint_t   GetInputs()     const {return ninputs;}
+  uint_t   GetOutputs()    const {return noutputs;}
+  uint_t   GetLines()      const {return nlines;}
+  double   GetSampleRate() const {return samplerate;}
+  Matrix_t GetMatrix()     const {return matrix;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set feedback matrix type
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetMatrix(Matrix_t _matrix) {matrix = _matrix;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set delays to be spread geometrically between two delays (and mutually prime)
+   *
+   * @param mindelay shortest delay in seconds
+   * @param maxdelay longest delay in seconds
+   *
+   * @note resets the delay lines
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetDelays(double mindelay, double maxdelay);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set delays explicitly
+   *
+   * @param _delays array of GetLines() delays in samples (each at least 1)
+   *
+   * @note resets the delay lines
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetDelays(const uint_t *_delays);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return delay of line in samples
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetDelay(uint_t n) const {return (n < delays.size()) ? delays[n] : 0;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set decay time (RT60)
+   *
+   * @param _rt60 time in seconds for the reverb to decay by 60dB at low frequencies
+   * @param _rt60high time in seconds for the reverb to decay by 60dB at high frequencies (0 = same as _rt60)
+   * @param _crossover crossover frequency between low and high frequency decay times
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetDecayTime(double _rt60, double _rt60high = 0.0, double _crossover = 4000.0);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set input diffusion
+   *
+   * @param nfilters number of all-pass filters (0 = no diffusion)
+   * @param coeff all-pass coeff
+   *
+   * @note resets the diffusion filters
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetDiffusion(uint_t nfilters, float coeff = .6f);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set dry and wet gains
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetMix(float _dry, float _wet) {dry = _dry; wet = _wet;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Clear all delay lines and filters
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Process audio
+   *
+   * @param src source buffer
+   * @param dst destination buffer
+   * @param srcchannel source starting channel
+   * @param nsrcchannels total number of source channels
+   * @param dstchannel destination starting channel
+   * @param ndstchannels total number of destination channels
+   * @param nframes number of sample frames to process
+   *
+   * @note GetInputs() channels are read from src and GetOutputs() channels are written to dst
+   * @note dry output channel n is input channel (n % GetInputs())
+   * @note src can == dst IFF src and dst channel parameters are the same
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Process(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Apply normalised fast Walsh-Hadamard transform to n values in place (n a power of 2)
+   */
+  /*--------------------------------------------------------------------------------*/
+  static void Hadamard(float *data, uint_t n);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Apply Householder reflection (I - 2/n . 1.1^T) to n values in place
+   */
+  /*--------------------------------------------------------------------------------*/
+  static void Householder(float *data, uint_t n);
+
+protected:
+  /*--------------------------------------------------------------------------------*/
+  /** Recalculate damping filters from delays and decay times
+   */
+  /*--------------------------------------------------------------------------------*/
+  void UpdateDamping();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Process a block of frames (nframes <= shortest delay)
+   */
+  /*--------------------------------------------------------------------------------*/
+  void ProcessBlock(uint_t nframes);
+
+protected:
+  // per-line biquad coeffs and state, arranged for SIMD across lines
+  typedef struct
+  {
+    std::vector<float> num0, num1, num2;
+    std::vector<float> den1, den2;
+    std::vector<float> w1, w2;
+  } DAMPING;
+
+protected:
+  uint_t                          ninputs;
+  uint_t                          noutputs;
+  uint_t                          nlines;
+  uint_t                          linesperoutput;            // number of lines mixed into each output
+  double                          samplerate;
+  Matrix_t                        matrix;
+  std::vector<uint_t>             delays;
+  std::vector<RingBuffer<float> > lines;
+  DAMPING                         damping;
+  AllPassFilterChain<float>       diffusion;
+  std::vector<float>              inputsigns;                // sign (and gain) of input into each line
+  std::vector<uint_t>             outputlines;               // lines mixed into each output (noutputs x linesperoutput)
+  std::vector<float>              outputgains;               // sign and gain of each line into each output (noutputs x linesperoutput)
+  std::vector<float>              inblock;                   // input block (ninputs x frames)
+  std::vector<float>              diffblock;                 // diffused input block (ninputs x frames)
+  std::vector<float>              outblock;                  // wet output block (noutputs x frames)
+  std::vector<float>              lineblock;                 // line block (nlines x frames)
+  uint_t                          blockframes;               // maximum frames per block
+  double                          rt60;
+  double                          rt60high;
+  double                          crossover;
+  float                           dry;
+  float                           wet;
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
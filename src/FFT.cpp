@@ -0,0 +1,417 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+#include <map>
+#include <mutex>
+
+#define BBCDEBUG_LEVEL 1
+#include "FFT.h"
+#include "simd_utils.h"
+
+BBC_AUDIOTOOLBOX_START
+
+#if ENABLE_FFTW
+// in FFT_FFTW.cpp
+extern FFT *CreateFFTWFFT(uint_t n);
+#endif
+
+/*--------------------------------------------------------------------------------*/
+/** In-place complex FFT of a single size
+ *
+ * Bit-reversal permutation followed by radix-4 passes (each pass being two radix-2 decimation-in-time
+ * stages combined so that data is read and written once per two stages), preceded by a single radix-2
+ * pass when log2(n) is odd
+ */
+/*--------------------------------------------------------------------------------*/
+class ComplexFFTCore
+{
+public:
+  ComplexFFTCore(uint_t _n);
+
+  void Transform(float *data, bool inverse) const;
+
+protected:
+  template<bool INVERSE>
+  void Radix4Pass(float *data, uint_t m, const float *w1, const float *w2) const;
+
+protected:
+  uint_t                n;
+  bool                  radix2;           // true if a single radix-2 pass is needed first
+  std::vector<uint32_t> swaps;            // pairs of indices to be swapped for bit reversal
+  std::vector<float>    twiddles[2];      // forward and inverse twiddles for each radix-4 pass
+};
+
+ComplexFFTCore::ComplexFFTCore(uint_t _n) : n(_n),
+                                            radix2(false)
+{
+  uint_t bits = 0, i, j, k, m;
+
+  while ((1U << bits) < n) bits++;
+
+  // bit reversal swaps
+  for (i = 0; i < n; i++)
+  {
+    for (j = k = 0; k < bits; k++) j |= ((i >> k) & 1) << (bits - 1 - k);
+    if (i < j)
+    {
+      swaps.push_back(i);
+      swaps.push_back(j);
+    }
+  }
+
+  radix2 = ((bits & 1) != 0);
+
+  // twiddles for each radix-4 pass: W(4m)^k then W(4m)^2k for k = 0..m-1
+  for (m = radix2 ? 2 : 1; (4 * m) <= n; m *= 4)
+  {
+    for (i = 1; i <= 2; i++)
+    {
+      for (k = 0; k < m; k++)
+      {
+        const double a = 2.0 * M_PI * (double)(i * k) / (double)(4 * m);
+        twiddles[0].push_back((float)cos(a));
+        twiddles[0].push_back((float)-sin(a));
+        twiddles[1].push_back((float)cos(a));
+        twiddles[1].push_back((float)sin(a));
+      }
+    }
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Combine groups of four length m transforms into length 4m transforms
+ *
+ * @param data complex data
+ * @param m length of sub-transforms
+ * @param w1 twiddles W(4m)^k
+ * @param w2 twiddles W(4m)^2k
+ */
+/*--------------------------------------------------------------------------------*/
+template<bool INVERSE>
+void ComplexFFTCore::Radix4Pass(float *data, uint_t m, const float *w1, const float *w2) const
+{
+  uint_t j, k;
+
+  for (j = 0; j < n; j += 4 * m)
+  {
+    float *p0 = data + 2 * j, *p1 = p0 + 2 * m, *p2 = p1 + 2 * m, *p3 = p2 + 2 * m;
+
+    k = 0;
+
+#ifdef __AVX__
+    for (; (k + 4) <= m; k += 4)
+    {
+      const __m256 a  = _mm256_loadu_ps(w2 + 2 * k);
+      const __m256 b  = _mm256_loadu_ps(w1 + 2 * k);
+      const __m256 x0 = _mm256_loadu_ps(p0 + 2 * k);
+      const __m256 x2 = _mm256_loadu_ps(p2 + 2 * k);
+      const __m256 t1 = ComplexMultiply(_mm256_loadu_ps(p1 + 2 * k), a);
+      const __m256 t3 = ComplexMultiply(_mm256_loadu_ps(p3 + 2 * k), a);
+      const __m256 c0 = _mm256_add_ps(x0, t1), c1 = _mm256_sub_ps(x0, t1);
+      const __m256 d2 = ComplexMultiply(_mm256_add_ps(x2, t3), b);
+      const __m256 d3 = ComplexRotate(ComplexMultiply(_mm256_sub_ps(x2, t3), b), INVERSE);
+
+      _mm256_storeu_ps(p0 + 2 * k, _mm256_add_ps(c0, d2));
+      _mm256_storeu_ps(p2 + 2 * k, _mm256_sub_ps(c0, d2));
+      _mm256_storeu_ps(p1 + 2 * k, _mm256_add_ps(c1, d3));
+      _mm256_storeu_ps(p3 + 2 * k, _mm256_sub_ps(c1, d3));
+    }
+#endif
+#if defined(__AVX__) || defined(__SSE3__)
+    for (; (k + 2) <= m; k += 2)
+    {
+      const __m128 a  = _mm_loadu_ps(w2 + 2 * k);
+      const __m128 b  = _mm_loadu_ps(w1 + 2 * k);
+      const __m128 x0 = _mm_loadu_ps(p0 + 2 * k);
+      const __m128 x2 = _mm_loadu_ps(p2 + 2 * k);
+      const __m128 t1 = ComplexMultiply(_mm_loadu_ps(p1 + 2 * k), a);
+      const __m128 t3 = ComplexMultiply(_mm_loadu_ps(p3 + 2 * k), a);
+      const __m128 c0 = _mm_add_ps(x0, t1), c1 = _mm_sub_ps(x0, t1);
+      const __m128 d2 = ComplexMultiply(_mm_add_ps(x2, t3), b);
+      const __m128 d3 = ComplexRotate(ComplexMultiply(_mm_sub_ps(x2, t3), b), INVERSE);
+
+      _mm_storeu_ps(p0 + 2 * k, _mm_add_ps(c0, d2));
+      _mm_storeu_ps(p2 + 2 * k, _mm_sub_ps(c0, d2));
+      _mm_storeu_ps(p1 + 2 * k, _mm_add_ps(c1, d3));
+      _mm_storeu_ps(p3 + 2 * k, _mm_sub_ps(c1, d3));
+    }
+#endif
+    for (; k < m; k++)
+    {
+      const float ar = w2[2 * k], ai = w2[2 * k + 1];
+      const float br = w1[2 * k], bi = w1[2 * k + 1];
+      const float x1r = p1[2 * k], x1i = p1[2 * k + 1];
+      const float x3r = p3[2 * k], x3i = p3[2 * k + 1];
+      const float t1r = x1r * ar - x1i * ai, t1i = x1r * ai + x1i * ar;
+      const float t3r = x3r * ar - x3i * ai, t3i = x3r * ai + x3i * ar;
+      const float c0r = p0[2 * k] + t1r, c0i = p0[2 * k + 1] + t1i;
+      const float c1r = p0[2 * k] - t1r, c1i = p0[2 * k + 1] - t1i;
+      const float c2r = p2[2 * k] + t3r, c2i = p2[2 * k + 1] + t3i;
+      const float c3r = p2[2 * k] - t3r, c3i = p2[2 * k + 1] - t3i;
+      const float d2r = c2r * br - c2i * bi, d2i = c2r * bi + c2i * br;
+      const float e3r = c3r * br - c3i * bi, e3i = c3r * bi + c3i * br;
+      // multiply by -i (forward) or i (inverse)
+      const float d3r = INVERSE ? -e3i : e3i, d3i = INVERSE ? e3r : -e3r;
+
+      p0[2 * k] = c0r + d2r; p0[2 * k + 1] = c0i + d2i;
+      p2[2 * k] = c0r - d2r; p2[2 * k + 1] = c0i - d2i;
+      p1[2 * k] = c1r + d3r; p1[2 * k + 1] = c1i + d3i;
+      p3[2 * k] = c1r - d3r; p3[2 * k + 1] = c1i - d3i;
+    }
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Perform in-place complex transform
+ */
+/*--------------------------------------------------------------------------------*/
+void ComplexFFTCore::Transform(float *data, bool inverse) const
+{
+  const float *tw = &twiddles[inverse ? 1 : 0][0];
+  uint_t i, m;
+
+  // bit reversal (swapping complex values as 64-bit items)
+  for (i = 0; i < swaps.size(); i += 2)
+  {
+    uint64_t *p = (uint64_t *)data, t = p[swaps[i]];
+    p[swaps[i]]     = p[swaps[i + 1]];
+    p[swaps[i + 1]] = t;
+  }
+
+  if (radix2)
+  {
+    for (i = 0; i < n; i += 2)
+    {
+      float *p = data + 2 * i;
+      const float r = p[2], im = p[3];
+
+      p[2] = p[0] - r; p[3] = p[1] - im;
+      p[0] = p[0] + r; p[1] = p[1] + im;
+    }
+  }
+
+  for (m = radix2 ? 2 : 1; (4 * m) <= n; tw += 4 * m, m *= 4)
+  {
+    if (inverse) Radix4Pass<true>(data, m, tw, tw + 2 * m);
+    else         Radix4Pass<false>(data, m, tw, tw + 2 * m);
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Built-in FFT implementation
+ *
+ * Real transforms of size n use a complex transform of size n/2 followed (forward) or preceded
+ * (inverse) by a split of the even and odd parts
+ */
+/*--------------------------------------------------------------------------------*/
+class BuiltInFFT : public FFT
+{
+public:
+  BuiltInFFT(uint_t n);
+  virtual ~BuiltInFFT() {}
+
+  virtual const char *GetName() const {return "built-in";}
+
+  virtual void RealForward(float *data) const;
+  virtual void RealInverse(float *data) const;
+
+  virtual void ComplexForward(float *data) const {full.Transform(data, false);}
+  virtual void ComplexInverse(float *data) const {full.Transform(data, true);}
+
+protected:
+  ComplexFFTCore     full;
+  ComplexFFTCore     half;
+  std::vector<float> realtwiddles;      // W(n)^k for k = 0..n/4
+};
+
+BuiltInFFT::BuiltInFFT(uint_t n) : FFT(n),
+                                   full(n),
+                                   half(n / 2)
+{
+  uint_t k;
+
+  for (k = 0; k <= (n / 4); k++)
+  {
+    const double a = 2.0 * M_PI * (double)k / (double)n;
+    realtwiddles.push_back((float)cos(a));
+    realtwiddles.push_back((float)-sin(a));
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Real forward transform: n real samples -> n/2 + 1 complex values
+ */
+/*--------------------------------------------------------------------------------*/
+void BuiltInFFT::RealForward(float *data) const
+{
+  const uint_t h = size / 2;
+  uint_t k;
+
+  // treat even/odd samples as real/imag parts
+  half.Transform(data, false);
+
+  {
+    const float zr = data[0], zi = data[1];
+    data[0]        = zr + zi;
+    data[1]        = 0.f;
+    data[size]     = zr - zi;
+    data[size + 1] = 0.f;
+  }
+
+  for (k = 1; k <= (h / 2); k++)
+  {
+    const uint_t j = h - k;
+    const float  wr = realtwiddles[2 * k], wi = realtwiddles[2 * k + 1];
+    // A = Z[k], B = conj(Z[h - k])
+    const float  ar = data[2 * k], ai = data[2 * k + 1];
+    const float  br = data[2 * j], bi = -data[2 * j + 1];
+    // E = (A + B) / 2, O = -i(A - B) / 2
+    const float  er = .5f * (ar + br), ei = .5f * (ai + bi);
+    const float  orr = .5f * (ai - bi), oi = -.5f * (ar - br);
+    // T = W^k * O
+    const float  tr = wr * orr - wi * oi, ti = wr * oi + wi * orr;
+
+    // X[k] = E + T, X[h - k] = conj(E - T)
+    data[2 * k]     = er + tr;
+    data[2 * k + 1] = ei + ti;
+    data[2 * j]     = er - tr;
+    data[2 * j + 1] = ti - ei;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Real inverse transform: n/2 + 1 complex values -> n real samples
+ */
+/*--------------------------------------------------------------------------------*/
+void BuiltInFFT::RealInverse(float *data) const
+{
+  const uint_t h = size / 2;
+  uint_t k;
+
+  {
+    const float x0 = data[0], xh = data[size];
+    data[0] = x0 + xh;
+    data[1] = x0 - xh;
+  }
+
+  for (k = 1; k <= (h / 2); k++)
+  {
+    const uint_t j = h - k;
+    const float  wr = realtwiddles[2 * k], wi = realtwiddles[2 * k + 1];
+    // A = X[k], B = conj(X[h - k])
+    const float  ar = data[2 * k], ai = data[2 * k + 1];
+    const float  br = data[2 * j], bi = -data[2 * j + 1];
+    // E = A + B, O = (A - B) * conj(W^k)
+    const float  er = ar + br, ei = ai + bi;
+    const float  dr = ar - br, di = ai - bi;
+    const float  orr = dr * wr + di * wi, oi = di * wr - dr * wi;
+
+    // Z[k] = E + iO, Z[h - k] = conj(E) + i.conj(O)
+    data[2 * k]     = er - oi;
+    data[2 * k + 1] = ei + orr;
+    data[2 * j]     = er + oi;
+    data[2 * j + 1] = orr - ei;
+  }
+
+  half.Transform(data, true);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Cache of FFT objects, one per size
+ */
+/*--------------------------------------------------------------------------------*/
+class FFTCache
+{
+public:
+  FFTCache() {}
+  ~FFTCache()
+  {
+    std::map<uint_t,FFT *>::iterator it;
+
+    for (it = ffts.begin(); it != ffts.end(); ++it) delete it->second;
+  }
+
+  const FFT *Get(uint_t n, FFT *(*create)(uint_t))
+  {
+    std::lock_guard<std::mutex> lock(tlock);
+    std::map<uint_t,FFT *>::iterator it;
+
+    if ((it = ffts.find(n)) != ffts.end()) return it->second;
+
+    FFT *fft = (*create)(n);
+    ffts[n] = fft;
+    return fft;
+  }
+
+protected:
+  std::mutex             tlock;
+  std::map<uint_t,FFT *> ffts;
+};
+
+/*--------------------------------------------------------------------------------*/
+/** Return (cached) FFT for size n
+ *
+ * @param n transform size (a power of 2 >= 2)
+ *
+ * @return FFT object or NULL if n is invalid
+ *
+ * @note the object is owned by the cache and must NOT be deleted
+ */
+/*--------------------------------------------------------------------------------*/
+const FFT *FFT::Get(uint_t n)
+{
+  static FFTCache cache;
+
+  if (!IsValidSize(n))
+  {
+    BBCERROR("Invalid FFT size %u (must be a power of 2 >= 2)", n);
+    return NULL;
+  }
+
+  return cache.Get(n, &FFT::Create);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Create new FFT object of the preferred implementation
+ */
+/*--------------------------------------------------------------------------------*/
+FFT *FFT::Create(uint_t n)
+{
+#if ENABLE_FFTW
+  return CreateFFTWFFT(n);
+#else
+  return new BuiltInFFT(n);
+#endif
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Allocate/free zeroed, aligned buffer of n floats
+ */
+/*--------------------------------------------------------------------------------*/
+float *FFT::AllocateBuffer(uint_t n)
+{
+  const size_t align = 32;
+  uint8_t *p, *buffer = NULL;
+
+  // over-allocate and store original pointer before aligned buffer
+  if ((p = (uint8_t *)malloc(n * sizeof(float) + align + sizeof(void *))) != NULL)
+  {
+    buffer = p + sizeof(void *);
+    buffer += (align - ((size_t)buffer & (align - 1))) & (align - 1);
+    ((void **)buffer)[-1] = p;
+
+    memset(buffer, 0, n * sizeof(float));
+  }
+  else BBCERROR("Failed to allocate FFT buffer of %u floats", n);
+
+  return (float *)buffer;
+}
+
+void FFT::FreeBuffer(float *buffer)
+{
+  if (buffer) free(((void **)buffer)[-1]);
+}
+
+BBC_AUDIOTOOLBOX_END
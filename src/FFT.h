@@ -0,0 +1,119 @@
+#ifndef __FFT__
+#define __FFT__
+
+#include <bbcat-base/misc.h>
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** FFT abstraction
+ *
+ * FFT objects are plans for a single (power of 2) size, obtained from a thread-safe cache using Get()
+ * and shared by all users of that size; plans are never modified after creation so any number of
+ * threads may use the same plan simultaneously
+ *
+ * All transforms operate in place on float buffers, which should be allocated using AllocateBuffer()
+ * (aligned for SIMD)
+ *
+ * Real transforms: the buffer holds n + 2 floats (see GetRealBufferSize()), the forward transform takes
+ * n real samples and produces n/2 + 1 interleaved complex values (DC to Nyquist), the inverse transform
+ * does the reverse
+ *
+ * Complex transforms: the buffer holds n interleaved complex values (2 * n floats)
+ *
+ * Forward transforms use exp(-i...), inverse transforms use exp(+i...) and are NOT normalised (the
+ * result of an inverse transform of a forward transform is the original data multiplied by n)
+ *
+ * The built-in implementation is a radix-2^2 (radix-4 with radix-2 butterflies) FFT using SSE3/AVX
+ * butterflies, real transforms being calculated with a half-size complex transform; when ENABLE_GPL
+ * is set and FFTW is available (ENABLE_FFTW) FFTW is used instead
+ */
+/*--------------------------------------------------------------------------------*/
+class FFT
+{
+public:
+  virtual ~FFT() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return (cached) FFT for size n
+   *
+   * @param n transform size (a power of 2 >= 2)
+   *
+   * @return FFT object or NULL if n is invalid
+   *
+   * @note the object is owned by the cache and must NOT be deleted
+   */
+  /*--------------------------------------------------------------------------------*/
+  static const FFT *Get(uint_t n);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return whether n is a valid transform size
+   */
+  /*--------------------------------------------------------------------------------*/
+  static bool IsValidSize(uint_t n) {return ((n >= 2) && !(n & (n - 1)));}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of floats required for real and complex transforms of size n
+   */
+  /*--------------------------------------------------------------------------------*/
+  static uint_t GetRealBufferSize(uint_t n)    {return n + 2;}
+  static uint_t GetComplexBufferSize(uint_t n) {return 2 * n;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Allocate/free zeroed, aligned buffer of n floats
+   */
+  /*--------------------------------------------------------------------------------*/
+  static float *AllocateBuffer(uint_t n);
+  static void   FreeBuffer(float *buffer);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return transform size
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetSize() const {return size;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return name of implementation
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual const char *GetName() const = 0;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Real transforms
+   *
+   * @param data buffer of GetRealBufferSize() floats
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual void RealForward(float *data) const = 0;
+  virtual void RealInverse(float *data) const = 0;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Complex transforms
+   *
+   * @param data buffer of GetComplexBufferSize() floats
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual void ComplexForward(float *data) const = 0;
+  virtual void ComplexInverse(float *data) const = 0;
+
+protected:
+  FFT(uint_t n) : size(n) {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Create new FFT object of the preferred implementation
+   */
+  /*--------------------------------------------------------------------------------*/
+  static FFT *Create(uint_t n);
+
+protected:
+  uint_t size;
+
+private:
+  // copying is not supported
+  FFT(const FFT&);
+  FFT& operator = (const FFT&);
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
@@ -0,0 +1,66 @@
+#include <fftw3.h>
+
+#define BBCDEBUG_LEVEL 1
+#include "FFT.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** FFTW implementation (only built when ENABLE_GPL is set and FFTW is found, which sets ENABLE_FFTW)
+ *
+ * Plans are created in place on a scratch buffer and executed using FFTW's new-array functions
+ * (which are thread-safe) on the caller's buffers
+ */
+/*--------------------------------------------------------------------------------*/
+class FFTWFFT : public FFT
+{
+public:
+  FFTWFFT(uint_t n);
+  virtual ~FFTWFFT();
+
+  virtual const char *GetName() const {return "FFTW";}
+
+  virtual void RealForward(float *data)    const {fftwf_execute_dft_r2c(realforward, data, (fftwf_complex *)data);}
+  virtual void RealInverse(float *data)    const {fftwf_execute_dft_c2r(realinverse, (fftwf_complex *)data, data);}
+  virtual void ComplexForward(float *data) const {fftwf_execute_dft(complexforward, (fftwf_complex *)data, (fftwf_complex *)data);}
+  virtual void ComplexInverse(float *data) const {fftwf_execute_dft(complexinverse, (fftwf_complex *)data, (fftwf_complex *)data);}
+
+protected:
+  fftwf_plan realforward;
+  fftwf_plan realinverse;
+  fftwf_plan complexforward;
+  fftwf_plan complexinverse;
+};
+
+FFTWFFT::FFTWFFT(uint_t n) : FFT(n)
+{
+  // planning with FFTW_MEASURE overwrites the buffer so use a scratch buffer
+  float *buffer = AllocateBuffer(GetComplexBufferSize(n) + 2);
+  const unsigned flags = FFTW_MEASURE | FFTW_UNALIGNED;
+
+  realforward    = fftwf_plan_dft_r2c_1d(n, buffer, (fftwf_complex *)buffer, flags);
+  realinverse    = fftwf_plan_dft_c2r_1d(n, (fftwf_complex *)buffer, buffer, flags);
+  complexforward = fftwf_plan_dft_1d(n, (fftwf_complex *)buffer, (fftwf_complex *)buffer, FFTW_FORWARD, flags);
+  complexinverse = fftwf_plan_dft_1d(n, (fftwf_complex *)buffer, (fftwf_complex *)buffer, FFTW_BACKWARD, flags);
+
+  FreeBuffer(buffer);
+}
+
+FFTWFFT::~FFTWFFT()
+{
+  fftwf_destroy_plan(realforward);
+  fftwf_destroy_plan(realinverse);
+  fftwf_destroy_plan(complexforward);
+  fftwf_destroy_plan(complexinverse);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Create FFTW object (called from FFT::Create())
+ */
+/*--------------------------------------------------------------------------------*/
+FFT *CreateFFTWFFT(uint_t n)
+{
+  return new FFTWFFT(n);
+}
+
+BBC_AUDIOTOOLBOX_END
@@ -37,6 +37,134 @@ extern uint_t FractionalSampleAdditionalDelayRequired();
 extern double FractionalSample(const double *buffer, uint_t channel, uint_t channels, uint_t length, double pos);
 extern double FractionalSample(const float  *buffer, uint_t channel, uint_t channels, uint_t length, double pos);
 
+/*--------------------------------------------------------------------------------*/
+/** Generate a block of samples from floating point positions within a buffer, assuming the buffer is circular
+ *
+ * @param buffer buffer containing channels x length samples
+ * @param channel first channel to read from
+ * @param channels number of channels buffer contains (and therefore the step for each sample of the same channel)
+ * @param length number of sample frames in the buffer
+ * @param dst destination buffer
+ * @param dstchannel first channel in destination to write to
+ * @param dstchannels total number of channels in destination buffer
+ * @param nchannels number of channels to generate
+ * @param nframes number of frames to generate
+ * @param pos position of first frame
+ * @param inc position increment for each frame (can be fractional, zero or negative)
+ *
+ * @return position of the frame *after* the last generated frame, wrapped to the buffer length
+ *
+ * @note each frame is identical to calling FractionalSample() above for each channel, including the delay of the filter
+ * @note the filter is stored as a transposed (polyphase) float table so that the taps for a single position are contiguous
+ * @note and channels are processed together (SIMD across channels when more than one channel is requested)
+ * @note any buffer length is supported: the buffer is treated as circular and reads that wrap (or buffers shorter than the filter) are gathered tap by tap
+ */
+/*--------------------------------------------------------------------------------*/
+extern double FractionalSamples(const float  *buffer, uint_t channel, uint_t channels, uint_t length,
+                                float  *dst, uint_t dstchannel, uint_t dstchannels,
+                                uint_t nchannels, uint_t nframes,
+                                double pos, double inc = 1.0);
+extern double FractionalSamples(const double *buffer, uint_t channel, uint_t channels, uint_t length,
+                                double *dst, uint_t dstchannel, uint_t dstchannels,
+                                uint_t nchannels, uint_t nframes,
+                                double pos, double inc = 1.0);
+
+/*--------------------------------------------------------------------------------*/
+/** Selectable quality fractional sample interpolation
+ *
+ * Each kernel uses GetTaps() samples *before* the requested position (like FractionalSample() above)
+ * and so the result at position pos is the signal at (pos - GetDelay())
+ *
+ * Kernels are stateless and shared, use Get() to obtain one:
+ *
+ *   const InterpolationKernel& kernel = InterpolationKernel::Get(InterpolationKernel::Quality_CubicHermite);
+ *   pos = kernel.Interpolate(buffer, 0, channels, length, dst, 0, channels, channels, nframes, pos, rate);
+ *
+ * Quality_Sinc14 is identical to FractionalSample() / FractionalSamples()
+ */
+/*--------------------------------------------------------------------------------*/
+class InterpolationKernel
+{
+public:
+  typedef enum
+  {
+    Quality_Linear = 0,         // 2 taps, control-rate smoothing
+    Quality_CubicHermite,       // 4 taps, modulation effects
+    Quality_Lagrange4,          // 4 taps
+    Quality_Lagrange6,          // 6 taps
+    Quality_Sinc14,             // 14 taps, 128x oversampled sinc (the original FractionalSample() filter)
+    Quality_Sinc32,             // 32 taps, Kaiser windowed sinc with interpolated phases, mastering quality
+
+    Quality_Count,
+  } Quality_t;
+
+  virtual ~InterpolationKernel() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return shared kernel for the specified quality
+   */
+  /*--------------------------------------------------------------------------------*/
+  static const InterpolationKernel& Get(Quality_t quality);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return quality and name of kernel
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual Quality_t  GetQuality() const = 0;
+  virtual const char *GetName()   const = 0;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of samples used for each interpolated sample
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual uint_t GetTaps() const = 0;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return additional items in buffers required for delay to work (equivalent of FractionalSampleAdditionalDelayRequired())
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetAdditionalDelayRequired() const {return GetTaps();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return latency (in samples) of the interpolated output relative to the requested position
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetDelay() const {return GetTaps() / 2 + 1;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return approximate cost (arithmetic operations) of generating a single frame of nchannels
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual uint_t GetCost(uint_t nchannels = 1) const = 0;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return the sample given by a floating point position within a buffer, assuming the buffer is circular
+   *
+   * @note see FractionalSample() above for parameters
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual double Interpolate(const float  *buffer, uint_t channel, uint_t channels, uint_t length, double pos) const = 0;
+  virtual double Interpolate(const double *buffer, uint_t channel, uint_t channels, uint_t length, double pos) const = 0;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Generate a block of samples from floating point positions within a buffer, assuming the buffer is circular
+   *
+   * @note see FractionalSamples() above for parameters
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual double Interpolate(const float  *buffer, uint_t channel, uint_t channels, uint_t length,
+                             float  *dst, uint_t dstchannel, uint_t dstchannels,
+                             uint_t nchannels, uint_t nframes,
+                             double pos, double inc = 1.0) const = 0;
+  virtual double Interpolate(const double *buffer, uint_t channel, uint_t channels, uint_t length,
+                             double *dst, uint_t dstchannel, uint_t dstchannels,
+                             uint_t nchannels, uint_t nframes,
+                             double pos, double inc = 1.0) const = 0;
+
+protected:
+  InterpolationKernel() {}
+};
+
 BBC_AUDIOTOOLBOX_END
 
 #endif
@@ -0,0 +1,163 @@
+#include <string.h>
+
+#include <algorithm>
+
+#define BBCDEBUG_LEVEL 1
+#include "HRIRCache.h"
+#include "simd_utils.h"
+
+BBC_AUDIOTOOLBOX_START
+
+HRIRCache::HRIRCache() : fft(NULL),
+                         blocksize(0),
+                         length(0),
+                         npartitions(0),
+                         imagoffset(0),
+                         stride(0),
+                         nhrirs(0),
+                         nstored(0),
+                         fftbuf(NULL)
+{
+}
+
+HRIRCache::~HRIRCache()
+{
+  FreeChunks();
+}
+
+void HRIRCache::FreeChunks()
+{
+  uint_t i;
+
+  for (i = 0; i < chunks.size(); i++) FFT::FreeBuffer(chunks[i]);
+  chunks.clear();
+  partitions.clear();
+  hashes.clear();
+
+  FFT::FreeBuffer(fftbuf);
+  fftbuf = NULL;
+
+  nhrirs  = 0;
+  nstored = 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set up (empty) cache
+ *
+ * @param _blocksize block (and partition) size (a power of 2)
+ * @param _length length of each HRIR in samples
+ *
+ * @return true if set up successfully
+ */
+/*--------------------------------------------------------------------------------*/
+bool HRIRCache::Setup(uint_t _blocksize, uint_t _length)
+{
+  FreeChunks();
+  blocksize = 0;
+
+  if (!_length || ((fft = FFT::Get(2 * _blocksize)) == NULL))
+  {
+    BBCERROR("Invalid HRIR cache parameters (block size %u, length %u)", _blocksize, _length);
+    return false;
+  }
+
+  if ((fftbuf = FFT::AllocateBuffer(FFT::GetRealBufferSize(2 * _blocksize))) == NULL) return false;
+
+  blocksize   = _blocksize;
+  length      = _length;
+  npartitions = (length + blocksize - 1) / blocksize;
+  imagoffset  = (GetBins() + 7) & ~7U;
+  stride      = 2 * imagoffset;
+
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Add HRIR pair
+ *
+ * @param left left ear HRIR (GetLength() samples)
+ * @param right right ear HRIR (GetLength() samples)
+ *
+ * @return HRIR index or -1 if cache is not set up
+ */
+/*--------------------------------------------------------------------------------*/
+sint_t HRIRCache::Add(const float *left, const float *right)
+{
+  const float *irs[] = {left, right};
+  uint_t i, j;
+
+  if (!blocksize) return -1;
+
+  for (i = 0; i < NUMBEROF(irs); i++)
+  {
+    for (j = 0; j < npartitions; j++)
+    {
+      partitions.push_back(StorePartition(irs[i] + j * blocksize, std::min(blocksize, length - j * blocksize)));
+    }
+  }
+
+  return (sint_t)(nhrirs++);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Store partition, returning index of stored spectrum (or -1 for all zeros)
+ */
+/*--------------------------------------------------------------------------------*/
+sint_t HRIRCache::StorePartition(const float *ir, uint_t n)
+{
+  // fold normalisation of inverse transform into spectra
+  const float scale = 1.f / (float)(2 * blocksize);
+  uint64_t    hash  = 14695981039346656037ULL;
+  bool        zero  = true;
+  uint_t      i;
+
+  // FNV-1a hash of samples
+  for (i = 0; i < n; i++)
+  {
+    const uint8_t *p = (const uint8_t *)(ir + i);
+    uint_t j;
+
+    for (j = 0; j < sizeof(*ir); j++) hash = (hash ^ p[j]) * 1099511628211ULL;
+    zero &= (ir[i] == 0.f);
+  }
+
+  if (zero) return -1;
+
+  memset(fftbuf, 0, FFT::GetRealBufferSize(2 * blocksize) * sizeof(*fftbuf));
+  for (i = 0; i < n; i++) fftbuf[i] = ir[i] * scale;
+  fft->RealForward(fftbuf);
+
+  // compare spectrum with stored spectra of partitions with the same hash
+  {
+    std::multimap<uint64_t,sint_t>::const_iterator it;
+    std::pair<std::multimap<uint64_t,sint_t>::const_iterator, std::multimap<uint64_t,sint_t>::const_iterator> range = hashes.equal_range(hash);
+    for (it = range.first; it != range.second; ++it)
+    {
+      const float *re = chunks[it->second / ChunkPartitions] + (it->second % ChunkPartitions) * stride;
+
+      for (i = 0; i < GetBins(); i++)
+      {
+        if ((re[i] != fftbuf[2 * i]) || (re[imagoffset + i] != fftbuf[2 * i + 1])) break;
+      }
+      if (i == GetBins()) return it->second;
+    }
+  }
+
+  // store new spectrum
+  if (!(nstored % ChunkPartitions))
+  {
+    float *chunk;
+
+    if ((chunk = FFT::AllocateBuffer(ChunkPartitions * stride)) == NULL) return -1;
+    chunks.push_back(chunk);
+  }
+
+  float *re = chunks[nstored / ChunkPartitions] + (nstored % ChunkPartitions) * stride;
+  DeinterleaveComplex(fftbuf, re, re + imagoffset, GetBins());
+
+  hashes.insert(std::pair<uint64_t,sint_t>(hash, (sint_t)nstored));
+
+  return (sint_t)(nstored++);
+}
+
+BBC_AUDIOTOOLBOX_END
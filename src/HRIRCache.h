@@ -0,0 +1,129 @@
+#ifndef __HRIR_CACHE__
+#define __HRIR_CACHE__
+
+#include <vector>
+#include <map>
+
+#include "FFT.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Compact frequency-domain cache of a set of HRIR pairs for partitioned convolution (see HRIRConvolver)
+ *
+ * Each HRIR (left and right) is split into partitions of one block, the spectrum of each partition
+ * (FFT size two blocks) being stored in split (SoA) form: all real parts followed by all imaginary parts,
+ * so that multiply-accumulates need no shuffling
+ *
+ * Identical partitions (within or between HRIRs) are stored once and all-zero partitions (e.g. the
+ * onset delays of distant ears) are not stored at all; a partition can therefore be compared between
+ * HRIRs simply by comparing pointers (so that crossfades need only process partitions that differ)
+ *
+ * Once all HRIRs have been added the cache may be shared by any number of convolvers and threads
+ */
+/*--------------------------------------------------------------------------------*/
+class HRIRCache
+{
+public:
+  HRIRCache();
+  ~HRIRCache();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set up (empty) cache
+   *
+   * @param _blocksize block (and partition) size (a power of 2)
+   * @param _length length of each HRIR in samples
+   *
+   * @return true if set up successfully
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool Setup(uint_t _blocksize, uint_t _length);
+
+  uint_t GetBlockSize()  const {return blocksize;}
+  uint_t GetLength()     const {return length;}
+  uint_t GetPartitions() const {return npartitions;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of complex values in each spectrum (blocksize + 1)
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetBins() const {return blocksize + 1;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return offset (in floats) from real parts to imaginary parts of each spectrum
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetImagOffset() const {return imagoffset;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Add HRIR pair
+   *
+   * @param left left ear HRIR (GetLength() samples)
+   * @param right right ear HRIR (GetLength() samples)
+   *
+   * @return HRIR index or -1 if cache is not set up
+   */
+  /*--------------------------------------------------------------------------------*/
+  sint_t Add(const float *left, const float *right);
+
+  uint_t GetHRIRs() const {return nhrirs;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of partition spectra stored (after removal of duplicate and zero partitions)
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetStoredPartitions() const {return nstored;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return spectrum of partition (real parts, imaginary parts are at GetImagOffset())
+   *
+   * @param hrir HRIR index
+   * @param ear 0 = left, 1 = right
+   * @param partition partition index
+   *
+   * @return spectrum or NULL if the partition is all zeros
+   */
+  /*--------------------------------------------------------------------------------*/
+  const float *GetPartition(uint_t hrir, uint_t ear, uint_t partition) const
+  {
+    const sint_t n = partitions[(hrir * 2 + ear) * npartitions + partition];
+    return (n >= 0) ? chunks[n / ChunkPartitions] + (n % ChunkPartitions) * stride : NULL;
+  }
+
+protected:
+  enum
+  {
+    ChunkPartitions = 64,
+  };
+
+  /*--------------------------------------------------------------------------------*/
+  /** Store partition, returning index of stored spectrum (or -1 for all zeros)
+   */
+  /*--------------------------------------------------------------------------------*/
+  sint_t StorePartition(const float *ir, uint_t n);
+
+  void FreeChunks();
+
+protected:
+  const FFT                     *fft;
+  uint_t                        blocksize;
+  uint_t                        length;
+  uint_t                        npartitions;
+  uint_t                        imagoffset;
+  uint_t                        stride;         // floats per stored spectrum
+  uint_t                        nhrirs;
+  uint_t                        nstored;
+  std::vector<sint_t>           partitions;     // index of stored spectrum for each partition of each HRIR
+  std::vector<float *>          chunks;         // storage for ChunkPartitions spectra each
+  std::multimap<uint64_t,sint_t> hashes;        // hashes of stored partitions
+  float                         *fftbuf;
+
+private:
+  // copying is not supported
+  HRIRCache(const HRIRCache&);
+  HRIRCache& operator = (const HRIRCache&);
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
@@ -0,0 +1,325 @@
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#define BBCDEBUG_LEVEL 1
+#include "HRIRConvolver.h"
+#include "simd_utils.h"
+
+BBC_AUDIOTOOLBOX_START
+
+HRIRConvolver::HRIRConvolver() : cache(NULL),
+                                 fft(NULL),
+                                 blocksize(0),
+                                 npartitions(0),
+                                 nbins(0),
+                                 imagoffset(0),
+                                 stride(0),
+                                 pos(0),
+                                 head(0),
+                                 nfading(0),
+                                 fftbuf(NULL),
+                                 fadeout(NULL)
+{
+  memset(ears, 0, sizeof(ears));
+}
+
+HRIRConvolver::~HRIRConvolver()
+{
+  FreeBuffers();
+}
+
+void HRIRConvolver::FreeBuffers()
+{
+  uint_t i;
+
+  for (i = 0; i < objects.size(); i++)
+  {
+    FFT::FreeBuffer(objects[i].history);
+    FFT::FreeBuffer(objects[i].fdl);
+  }
+  objects.clear();
+
+  for (i = 0; i < NUMBEROF(ears); i++)
+  {
+    FFT::FreeBuffer(ears[i].same);
+    FFT::FreeBuffer(ears[i].added);
+    FFT::FreeBuffer(ears[i].removed);
+    FFT::FreeBuffer(ears[i].block);
+  }
+  memset(ears, 0, sizeof(ears));
+
+  FFT::FreeBuffer(fftbuf);
+  FFT::FreeBuffer(fadeout);
+  fftbuf  = NULL;
+  fadeout = NULL;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set up convolver
+ *
+ * @param _cache HRIR cache (which must be set up, must not be changed and must not be deleted whilst in use)
+ * @param _nobjects number of objects
+ *
+ * @return true if set up successfully
+ *
+ * @note all objects use HRIR 0 after set up
+ */
+/*--------------------------------------------------------------------------------*/
+bool HRIRConvolver::Setup(const HRIRCache *_cache, uint_t _nobjects)
+{
+  uint_t i;
+
+  FreeBuffers();
+  blocksize = 0;
+
+  if (!_cache || !_cache->GetHRIRs() || !_nobjects || ((fft = FFT::Get(2 * _cache->GetBlockSize())) == NULL))
+  {
+    BBCERROR("Invalid HRIR convolver parameters (%u HRIRs, %u objects)", _cache ? _cache->GetHRIRs() : 0, _nobjects);
+    return false;
+  }
+
+  cache       = _cache;
+  npartitions = cache->GetPartitions();
+  nbins       = cache->GetBins();
+  imagoffset  = cache->GetImagOffset();
+  stride      = 2 * imagoffset;
+
+  objects.resize(_nobjects);
+  for (i = 0; i < _nobjects; i++)
+  {
+    objects[i].history  = FFT::AllocateBuffer(2 * cache->GetBlockSize());
+    objects[i].fdl      = FFT::AllocateBuffer(npartitions * stride);
+    objects[i].hrir     = 0;
+    objects[i].nexthrir = 0;
+    if (!objects[i].history || !objects[i].fdl) return false;
+  }
+
+  for (i = 0; i < NUMBEROF(ears); i++)
+  {
+    ears[i].same    = FFT::AllocateBuffer(stride);
+    ears[i].added   = FFT::AllocateBuffer(stride);
+    ears[i].removed = FFT::AllocateBuffer(stride);
+    ears[i].block   = FFT::AllocateBuffer(cache->GetBlockSize());
+    if (!ears[i].same || !ears[i].added || !ears[i].removed || !ears[i].block) return false;
+  }
+
+  if (((fftbuf  = FFT::AllocateBuffer(FFT::GetRealBufferSize(2 * cache->GetBlockSize()))) == NULL) ||
+      ((fadeout = FFT::AllocateBuffer(cache->GetBlockSize())) == NULL)) return false;
+
+  blocksize = cache->GetBlockSize();
+
+  // raised cosine fade-out (the fade-in being its complement)
+  for (i = 0; i < blocksize; i++) fadeout[i] = (float)(.5 + .5 * cos(M_PI * ((double)i + .5) / (double)blocksize));
+
+  Reset();
+
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set HRIR of object
+ *
+ * @param object object index
+ * @param hrir HRIR index within cache
+ *
+ * @return true if object and HRIR are valid
+ *
+ * @note the change takes effect (with a crossfade) from the next block processed; if the HRIR is
+ * changed more than once within a block only the last change is used
+ */
+/*--------------------------------------------------------------------------------*/
+bool HRIRConvolver::SetHRIR(uint_t object, uint_t hrir)
+{
+  if ((object >= objects.size()) || (hrir >= cache->GetHRIRs()))
+  {
+    BBCERROR("Invalid HRIR %u for object %u", hrir, object);
+    return false;
+  }
+
+  objects[object].nexthrir = hrir;
+
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Clear all input and output
+ */
+/*--------------------------------------------------------------------------------*/
+void HRIRConvolver::Reset()
+{
+  uint_t i;
+
+  for (i = 0; i < objects.size(); i++)
+  {
+    memset(objects[i].history, 0, 2 * blocksize * sizeof(*objects[i].history));
+    memset(objects[i].fdl,     0, npartitions * stride * sizeof(*objects[i].fdl));
+
+    // no need to crossfade from silence
+    objects[i].hrir = objects[i].nexthrir;
+  }
+  for (i = 0; i < NUMBEROF(ears); i++)
+  {
+    memset(ears[i].block, 0, blocksize * sizeof(*ears[i].block));
+  }
+
+  pos     = 0;
+  head    = 0;
+  nfading = 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process audio
+ *
+ * @param src source buffer (one channel per object)
+ * @param dst destination buffer (left and right ears)
+ * @param srcchannel source channel of first object
+ * @param nsrcchannels total number of source channels
+ * @param dstchannel destination channel of left ear (right ear is the next channel)
+ * @param ndstchannels total number of destination channels
+ * @param nframes number of sample frames to process
+ */
+/*--------------------------------------------------------------------------------*/
+void HRIRConvolver::Process(const Sample_t *src, Sample_t *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes)
+{
+  const uint_t nin  = std::min((uint_t)objects.size(), limited::subz(nsrcchannels, srcchannel));
+  const uint_t nout = std::min((uint_t)NUMBEROF(ears), limited::subz(ndstchannels, dstchannel));
+  uint_t i, j, n;
+
+  if (!blocksize) return;
+
+  src += srcchannel;
+  dst += dstchannel;
+  while (nframes)
+  {
+    n = std::min(nframes, blocksize - pos);
+
+    // input goes into second half of input history, output comes from the previous block
+    for (i = 0; i < nin; i++)
+    {
+      float *p = objects[i].history + blocksize + pos;
+      for (j = 0; j < n; j++) p[j] = (float)src[j * nsrcchannels + i];
+    }
+    for (i = 0; i < nout; i++)
+    {
+      const float *p = ears[i].block + pos;
+      for (j = 0; j < n; j++) dst[j * ndstchannels + i] = (Sample_t)p[j];
+    }
+
+    src     += n * nsrcchannels;
+    dst     += n * ndstchannels;
+    pos     += n;
+    nframes -= n;
+
+    if (pos == blocksize)
+    {
+      ProcessBlock();
+      pos = 0;
+    }
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process a complete block of input
+ */
+/*--------------------------------------------------------------------------------*/
+void HRIRConvolver::ProcessBlock()
+{
+  uint_t i, j, k;
+
+  head = (head + npartitions - 1) % npartitions;
+
+  nfading = 0;
+  for (i = 0; i < objects.size(); i++)
+  {
+    OBJECT& object    = objects[i];
+    float   *spectrum = object.fdl + head * stride;
+
+    // transform last two blocks of input into (split) frequency-domain delay line
+    memcpy(fftbuf, object.history, 2 * blocksize * sizeof(*object.history));
+    fft->RealForward(fftbuf);
+    DeinterleaveComplex(fftbuf, spectrum, spectrum + imagoffset, nbins);
+
+    // shift input along by one block
+    memcpy(object.history, object.history + blocksize, blocksize * sizeof(*object.history));
+
+    if (object.nexthrir != object.hrir) nfading++;
+  }
+
+  for (i = 0; i < NUMBEROF(ears); i++)
+  {
+    memset(ears[i].same, 0, stride * sizeof(*ears[i].same));
+    if (nfading)
+    {
+      memset(ears[i].added,   0, stride * sizeof(*ears[i].added));
+      memset(ears[i].removed, 0, stride * sizeof(*ears[i].removed));
+    }
+  }
+
+  for (i = 0; i < objects.size(); i++)
+  {
+    OBJECT& object = objects[i];
+
+    for (j = 0; j < npartitions; j++)
+    {
+      const float *x = object.fdl + ((head + j) % npartitions) * stride;
+
+      for (k = 0; k < NUMBEROF(ears); k++)
+      {
+        EAR&        ear = ears[k];
+        const float *hn = cache->GetPartition(object.nexthrir, k, j);
+        const float *ho = cache->GetPartition(object.hrir, k, j);
+
+        // identical partitions are shared by the cache so need only be processed once
+        if (hn == ho)
+        {
+          if (hn) ComplexMultiplyAccumulate(ear.same, ear.same + imagoffset, x, x + imagoffset, hn, hn + imagoffset, nbins);
+        }
+        else
+        {
+          if (hn) ComplexMultiplyAccumulate(ear.added,   ear.added   + imagoffset, x, x + imagoffset, hn, hn + imagoffset, nbins);
+          if (ho) ComplexMultiplyAccumulate(ear.removed, ear.removed + imagoffset, x, x + imagoffset, ho, ho + imagoffset, nbins);
+        }
+      }
+    }
+
+    object.hrir = object.nexthrir;
+  }
+
+  for (i = 0; i < NUMBEROF(ears); i++)
+  {
+    EAR& ear = ears[i];
+
+    if (nfading)
+    {
+      // output = same + added + fadeout * (removed - added)
+      for (j = 0; j < stride; j++)
+      {
+        ear.same[j]    += ear.added[j];
+        ear.removed[j] -= ear.added[j];
+      }
+
+      memcpy(ear.block, Inverse(ear.same), blocksize * sizeof(*ear.block));
+
+      const float *diff = Inverse(ear.removed);
+      for (j = 0; j < blocksize; j++) ear.block[j] += fadeout[j] * diff[j];
+    }
+    else memcpy(ear.block, Inverse(ear.same), blocksize * sizeof(*ear.block));
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Inverse transform split spectrum, returning pointer to (non-aliased) output block
+ */
+/*--------------------------------------------------------------------------------*/
+const float *HRIRConvolver::Inverse(const float *spectrum)
+{
+  InterleaveComplex(spectrum, spectrum + imagoffset, fftbuf, nbins);
+  fft->RealInverse(fftbuf);
+
+  // second half is the non-aliased output
+  return fftbuf + blocksize;
+}
+
+BBC_AUDIOTOOLBOX_END
@@ -0,0 +1,144 @@
+#ifndef __HRIR_CONVOLVER__
+#define __HRIR_CONVOLVER__
+
+#include <vector>
+
+#include "HRIRCache.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Binaural convolver for any number of objects whose HRIRs (from a shared HRIRCache) may change every block
+ *
+ * Each object is convolved with the left and right ear HRIRs of its current HRIR using uniformly
+ * partitioned convolution, all objects being accumulated in the frequency domain so that steady state
+ * needs only one inverse transform per ear per block
+ *
+ * When the HRIR of an object is changed the output is crossfaded (raised cosine over one block) from the
+ * old HRIR to the new one without running two convolutions: partitions common to both HRIRs are
+ * multiply-accumulated once and only partitions that differ are multiply-accumulated for both, the
+ * difference being inverse transformed (once per ear for all crossfading objects) and added with the
+ * fade-out window
+ *
+ * The latency is one block
+ */
+/*--------------------------------------------------------------------------------*/
+class HRIRConvolver
+{
+public:
+  HRIRConvolver();
+  ~HRIRConvolver();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set up convolver
+   *
+   * @param _cache HRIR cache (which must be set up, must not be changed and must not be deleted whilst in use)
+   * @param _nobjects number of objects
+   *
+   * @return true if set up successfully
+   *
+   * @note all objects use HRIR 0 after set up
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool Setup(const HRIRCache *_cache, uint_t _nobjects);
+
+  uint_t GetBlockSize() const {return blocksize;}
+  uint_t GetObjects()   const {return (uint_t)objects.size();}
+  uint_t GetLatency()   const {return blocksize;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set HRIR of object
+   *
+   * @param object object index
+   * @param hrir HRIR index within cache
+   *
+   * @return true if object and HRIR are valid
+   *
+   * @note the change takes effect (with a crossfade) from the next block processed; if the HRIR is
+   * changed more than once within a block only the last change is used
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool SetHRIR(uint_t object, uint_t hrir);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of objects currently being crossfaded (for diagnostics)
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetFadingObjects() const {return nfading;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Clear all input and output
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Process audio
+   *
+   * @param src source buffer (one channel per object)
+   * @param dst destination buffer (left and right ears)
+   * @param srcchannel source channel of first object
+   * @param nsrcchannels total number of source channels
+   * @param dstchannel destination channel of left ear (right ear is the next channel)
+   * @param ndstchannels total number of destination channels
+   * @param nframes number of sample frames to process
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Process(const Sample_t *src, Sample_t *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes);
+
+protected:
+  typedef struct
+  {
+    float  *history;            // last two blocks of input
+    float  *fdl;                // frequency-domain delay line (split spectra, one per partition)
+    uint_t hrir;                // HRIR used for the last block
+    uint_t nexthrir;            // HRIR to use for the next block
+  } OBJECT;
+
+  typedef struct
+  {
+    float *same;                // accumulator for partitions common to old and new HRIRs
+    float *added;               // accumulator for partitions only in the new HRIRs
+    float *removed;             // accumulator for partitions only in the old HRIRs
+    float *block;               // current block of output
+  } EAR;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Process a complete block of input
+   */
+  /*--------------------------------------------------------------------------------*/
+  void ProcessBlock();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Inverse transform split spectrum, returning pointer to (non-aliased) output block
+   */
+  /*--------------------------------------------------------------------------------*/
+  const float *Inverse(const float *spectrum);
+
+  void FreeBuffers();
+
+protected:
+  const HRIRCache     *cache;
+  const FFT           *fft;
+  uint_t              blocksize;
+  uint_t              npartitions;
+  uint_t              nbins;
+  uint_t              imagoffset;
+  uint_t              stride;     // floats per split spectrum
+  uint_t              pos;        // position within input/output blocks
+  uint_t              head;       // index of most recent spectra in frequency-domain delay lines
+  uint_t              nfading;
+  std::vector<OBJECT> objects;
+  EAR                 ears[2];
+  float               *fftbuf;
+  float               *fadeout;   // crossfade window for old HRIRs
+
+private:
+  // copying is not supported
+  HRIRConvolver(const HRIRConvolver&);
+  HRIRConvolver& operator = (const HRIRConvolver&);
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
@@ -0,0 +1,110 @@
+#include <math.h>
+
+#include <algorithm>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#elif defined(__SSE3__)
+#include <pmmintrin.h>
+#endif
+
+#define BBCDEBUG_LEVEL 1
+#include "Histogram.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Calculate histogram bins of n values: bin = floor(nbins * (value - min) / range) limited to 0..nbins-1
+ *
+ * @note calculations are performed in double precision so that results are identical to Histogram::CalcIndex()
+ * @note the limits are applied before conversion so truncation is the same as floor()
+ */
+/*--------------------------------------------------------------------------------*/
+void CalcHistogramBins(const float *values, uint_t n, double min, double range, uint_t nbins, uint_t *bins)
+{
+  const double top = (double)nbins - 1.0;
+  uint_t i = 0;
+
+  if (!nbins) return;
+
+#ifdef __AVX__
+  {
+    const __m256d vmin   = _mm256_set1_pd(min);
+    const __m256d vrange = _mm256_set1_pd(range);
+    const __m256d vn     = _mm256_set1_pd((double)nbins);
+    const __m256d vzero  = _mm256_setzero_pd();
+    const __m256d vtop   = _mm256_set1_pd(top);
+
+    for (; (i + 4) <= n; i += 4)
+    {
+      __m256d x = _mm256_div_pd(_mm256_mul_pd(vn, _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(values + i)), vmin)), vrange);
+      x = _mm256_min_pd(_mm256_max_pd(x, vzero), vtop);
+      _mm_storeu_si128((__m128i *)(bins + i), _mm256_cvttpd_epi32(x));
+    }
+  }
+#elif defined(__SSE3__)
+  {
+    const __m128d vmin   = _mm_set1_pd(min);
+    const __m128d vrange = _mm_set1_pd(range);
+    const __m128d vn     = _mm_set1_pd((double)nbins);
+    const __m128d vzero  = _mm_setzero_pd();
+    const __m128d vtop   = _mm_set1_pd(top);
+
+    for (; (i + 4) <= n; i += 4)
+    {
+      const __m128 v = _mm_loadu_ps(values + i);
+      __m128d x1 = _mm_div_pd(_mm_mul_pd(vn, _mm_sub_pd(_mm_cvtps_pd(v), vmin)), vrange);
+      __m128d x2 = _mm_div_pd(_mm_mul_pd(vn, _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), vmin)), vrange);
+      x1 = _mm_min_pd(_mm_max_pd(x1, vzero), vtop);
+      x2 = _mm_min_pd(_mm_max_pd(x2, vzero), vtop);
+      _mm_storeu_si128((__m128i *)(bins + i), _mm_unpacklo_epi64(_mm_cvttpd_epi32(x1), _mm_cvttpd_epi32(x2)));
+    }
+  }
+#endif
+  for (; i < n; i++) bins[i] = (uint_t)limited::limit(floor(((double)nbins * ((double)values[i] - min)) / range), 0.0, top);
+}
+
+void CalcHistogramBins(const double *values, uint_t n, double min, double range, uint_t nbins, uint_t *bins)
+{
+  const double top = (double)nbins - 1.0;
+  uint_t i = 0;
+
+  if (!nbins) return;
+
+#ifdef __AVX__
+  {
+    const __m256d vmin   = _mm256_set1_pd(min);
+    const __m256d vrange = _mm256_set1_pd(range);
+    const __m256d vn     = _mm256_set1_pd((double)nbins);
+    const __m256d vzero  = _mm256_setzero_pd();
+    const __m256d vtop   = _mm256_set1_pd(top);
+
+    for (; (i + 4) <= n; i += 4)
+    {
+      __m256d x = _mm256_div_pd(_mm256_mul_pd(vn, _mm256_sub_pd(_mm256_loadu_pd(values + i), vmin)), vrange);
+      x = _mm256_min_pd(_mm256_max_pd(x, vzero), vtop);
+      _mm_storeu_si128((__m128i *)(bins + i), _mm256_cvttpd_epi32(x));
+    }
+  }
+#elif defined(__SSE3__)
+  {
+    const __m128d vmin   = _mm_set1_pd(min);
+    const __m128d vrange = _mm_set1_pd(range);
+    const __m128d vn     = _mm_set1_pd((double)nbins);
+    const __m128d vzero  = _mm_setzero_pd();
+    const __m128d vtop   = _mm_set1_pd(top);
+
+    for (; (i + 4) <= n; i += 4)
+    {
+      __m128d x1 = _mm_div_pd(_mm_mul_pd(vn, _mm_sub_pd(_mm_loadu_pd(values + i),     vmin)), vrange);
+      __m128d x2 = _mm_div_pd(_mm_mul_pd(vn, _mm_sub_pd(_mm_loadu_pd(values + i + 2), vmin)), vrange);
+      x1 = _mm_min_pd(_mm_max_pd(x1, vzero), vtop);
+      x2 = _mm_min_pd(_mm_max_pd(x2, vzero), vtop);
+      _mm_storeu_si128((__m128i *)(bins + i), _mm_unpacklo_epi64(_mm_cvttpd_epi32(x1), _mm_cvttpd_epi32(x2)));
+    }
+  }
+#endif
+  for (; i < n; i++) bins[i] = (uint_t)limited::limit(floor(((double)nbins * (values[i] - min)) / range), 0.0, top);
+}
+
+BBC_AUDIOTOOLBOX_END
@@ -1,47 +1,107 @@
 #ifndef __HISTOGRAM__
 #define __HISTOGRAM__
 
+#include <math.h>
+
 #include <vector>
+#include <algorithm>
+#include <mutex>
 
 #include <bbcat-base/EnhancedFile.h>
 
 BBC_AUDIOTOOLBOX_START
 
+/*--------------------------------------------------------------------------------*/
+/** Calculate histogram bins of n values: bin = floor(nbins * (value - min) / range) limited to 0..nbins-1
+ *
+ * @note float and double versions are vectorised
+ * @note the multiply is performed before the divide (not a reciprocal multiply) so that values on bin
+ * boundaries are placed in the upper bin
+ */
+/*--------------------------------------------------------------------------------*/
+extern void CalcHistogramBins(const float  *values, uint_t n, double min, double range, uint_t nbins, uint_t *bins);
+extern void CalcHistogramBins(const double *values, uint_t n, double min, double range, uint_t nbins, uint_t *bins);
+template<typename TYPE>
+void CalcHistogramBins(const TYPE *values, uint_t n, double min, double range, uint_t nbins, uint_t *bins)
+{
+  uint_t i;
+
+  for (i = 0; i < n; i++) bins[i] = (uint_t)limited::limit(floor(((double)nbins * ((double)values[i] - min)) / range), 0.0, (double)nbins - 1.0);
+}
+
 /*--------------------------------------------------------------------------------*/
 /** Histogram object, accumulates data (of type ITEMTYPE) at indices (of type INDEXTYPE)
+ *
+ * Bins can be spaced linearly, logarithmically or in dB (for level statistics), for the latter
+ * modes min, max and step are specified in the log domain (decades or dB)
+ *
+ * Cumulative counts are cached (and only recalculated after data has been added) so that
+ * quantiles (e.g. p50, p95, p99) can be found by binary search
  */
 /*--------------------------------------------------------------------------------*/
 template<typename INDEXTYPE, typename ITEMTYPE>
 class Histogram
 {
 public:
+  typedef enum
+  {
+    Bins_Linear = 0,
+    Bins_Log,                           // bins spaced in log10(index)
+    Bins_dB,                            // bins spaced in 20.log10(|index|) (index is an amplitude)
+    Bins_dBPower,                       // bins spaced in 10.log10(|index|) (index is a power)
+  } Bins_t;
+
   /*--------------------------------------------------------------------------------*/
   /** Construct from min value, max value and step
    */
   /*--------------------------------------------------------------------------------*/
   Histogram(INDEXTYPE _min  = INDEXTYPE(0),
             INDEXTYPE _max  = INDEXTYPE(1),
-            INDEXTYPE _step = INDEXTYPE(1)) {SetRange(_min, _max, _step);}
+            INDEXTYPE _step = INDEXTYPE(1),
+            Bins_t    _bins = Bins_Linear) {SetRange(_min, _max, _step, _bins);}
   Histogram(const Histogram& obj) : min(obj.min),
                                     range(obj.range),
+                                    bins(obj.bins),
                                     histogram(obj.histogram),
-                                    total(obj.total) {}
+                                    total(obj.total),
+                                    cumulativevalid(false) {}
   ~Histogram() {}
 
+  /*--------------------------------------------------------------------------------*/
+  /** Assignment operator
+   */
+  /*--------------------------------------------------------------------------------*/
+  Histogram& operator = (const Histogram& obj)
+  {
+    min             = obj.min;
+    range           = obj.range;
+    bins            = obj.bins;
+    histogram       = obj.histogram;
+    total           = obj.total;
+    // cumulative counts are not copied (obj may be recalculating them in another thread)
+    cumulativevalid = false;
+    return *this;
+  }
+
   /*--------------------------------------------------------------------------------*/
   /** Set range of histogram from min value, max value and step
+   *
+   * @note for log and dB bins, min, max and step are in decades or dB
    */
   /*--------------------------------------------------------------------------------*/
-  void SetRange(INDEXTYPE _min, INDEXTYPE _max, INDEXTYPE _step = INDEXTYPE(1))
+  void SetRange(INDEXTYPE _min, INDEXTYPE _max, INDEXTYPE _step = INDEXTYPE(1), Bins_t _bins = Bins_Linear)
   {
     min   = _min;
     range = _max - _min;
+    bins  = _bins;
 
     uint_t n = (uint_t)ceil(range / _step);
     histogram.resize(n);
+
     Reset();
   }
   uint_t GetSize() const {return (uint_t)histogram.size();}
+  Bins_t GetBins() const {return bins;}
 
   /*--------------------------------------------------------------------------------*/
   /** Each index holds count and sum
@@ -61,6 +121,7 @@ public:
     ITEM dummy = {0, ITEMTYPE(0)};
     histogram.assign(histogram.size(), dummy);
     total = dummy;
+    cumulativevalid = false;
   }
 
   /*--------------------------------------------------------------------------------*/
@@ -82,6 +143,93 @@ public:
     item.data += val;
     total.count++;
     total.data += val;
+    cumulativevalid = false;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Add block of data to histogram
+   *
+   * @param indices array of n indices
+   * @param n number of items
+   * @param vals array of n values (or NULL to add zeros)
+   *
+   * @note for float and double indices, binning is vectorised
+   */
+  /*--------------------------------------------------------------------------------*/
+  void AddMultiple(const INDEXTYPE *indices, uint_t n, const ITEMTYPE *vals = NULL)
+  {
+    if (histogram.size())
+    {
+      uint_t   binindices[256];
+      ITEMTYPE sum = ITEMTYPE(0);
+      uint_t   i, j, m;
+
+      for (i = 0; i < n; i += m)
+      {
+        m = std::min(n - i, (uint_t)NUMBEROF(binindices));
+
+        CalcIndices(indices + i, m, binindices);
+
+        if (vals)
+        {
+          for (j = 0; j < m; j++)
+          {
+            ITEM& item = histogram[binindices[j]];
+            item.count++;
+            item.data += vals[i + j];
+            sum       += vals[i + j];
+          }
+        }
+        else
+        {
+          for (j = 0; j < m; j++) histogram[binindices[j]].count++;
+        }
+      }
+
+      total.count += n;
+      total.data  += sum;
+      cumulativevalid = false;
+    }
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Add count and sum directly to a bin
+   */
+  /*--------------------------------------------------------------------------------*/
+  void AddToBin(uint_t bin, uint_t count, ITEMTYPE data)
+  {
+    if (bin < histogram.size())
+    {
+      ITEM& item = histogram[bin];
+      item.count += count;
+      item.data  += data;
+      total.count += count;
+      total.data  += data;
+      cumulativevalid = false;
+    }
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Merge another histogram (with the same range and step) into this one
+   *
+   * @return false if the histograms have different numbers of bins
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool Merge(const Histogram& obj)
+  {
+    if (obj.histogram.size() != histogram.size()) return false;
+
+    uint_t i;
+    for (i = 0; i < histogram.size(); i++)
+    {
+      histogram[i].count += obj.histogram[i].count;
+      histogram[i].data  += obj.histogram[i].data;
+    }
+    total.count += obj.total.count;
+    total.data  += obj.total.data;
+    cumulativevalid = false;
+
+    return true;
   }
 
   /*--------------------------------------------------------------------------------*/
@@ -102,8 +250,29 @@ public:
   /*--------------------------------------------------------------------------------*/
   uint_t CalcIndex(INDEXTYPE index) const
   {
-    index = (INDEXTYPE(histogram.size()) * (index - min)) / range;
-    return (uint_t)limited::limit((sint_t)index, 0, (sint_t)(histogram.size() - 1));
+    return (uint_t)limited::limit(floor(((double)histogram.size() * (Map(index) - (double)min)) / (double)range), 0.0, (double)histogram.size() - 1.0);
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return indices into data for n indices
+   */
+  /*--------------------------------------------------------------------------------*/
+  void CalcIndices(const INDEXTYPE *indices, uint_t n, uint_t *dst) const
+  {
+    if (bins == Bins_Linear) CalcHistogramBins(indices, n, (double)min, (double)range, (uint_t)histogram.size(), dst);
+    else
+    {
+      // map into log domain then bin
+      double mapped[256];
+      uint_t i, j, m;
+
+      for (i = 0; i < n; i += m)
+      {
+        m = std::min(n - i, (uint_t)NUMBEROF(mapped));
+        for (j = 0; j < m; j++) mapped[j] = Map(indices[i + j]);
+        CalcHistogramBins(mapped, m, (double)min, (double)range, (uint_t)histogram.size(), dst + i);
+      }
+    }
   }
 
   /*--------------------------------------------------------------------------------*/
@@ -112,9 +281,63 @@ public:
   /*--------------------------------------------------------------------------------*/
   INDEXTYPE CalcReversedIndex(uint_t index) const
   {
-    return min + ((INDEXTYPE(2) * range * (INDEXTYPE)index + INDEXTYPE(1)) / (INDEXTYPE)(2 * histogram.size()));
+    if (bins == Bins_Linear) return min + ((INDEXTYPE(2) * range * (INDEXTYPE)index + INDEXTYPE(1)) / (INDEXTYPE)(2 * histogram.size()));
+
+    // return centre of bin in log domain
+    return Unmap((double)min + (double)range * (double)(2 * index + 1) / (double)(2 * histogram.size()));
   }
 
+  /*--------------------------------------------------------------------------------*/
+  /** Return cumulative counts (count of each bin and all bins below it)
+   *
+   * @note cached, only recalculated when data has been added; the recalculation is protected by a
+   * @note mutex so that const methods may still be called from many threads at once (as long as no
+   * @note thread is modifying the histogram)
+   */
+  /*--------------------------------------------------------------------------------*/
+  const std::vector<uint_t>& GetCumulativeCounts() const
+  {
+    std::lock_guard<std::mutex> lock(cumulativelock);
+
+    if (!cumulativevalid)
+    {
+      uint_t i, sum = 0;
+
+      cumulative.resize(histogram.size());
+      for (i = 0; i < histogram.size(); i++) cumulative[i] = (sum += histogram[i].count);
+      cumulativevalid = true;
+    }
+
+    return cumulative;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return bin containing quantile (0 = minimum, .5 = median, 1 = maximum) of indices
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t CalcQuantileIndex(double quantile) const
+  {
+    const std::vector<uint_t>& counts = GetCumulativeCounts();
+    double target, nearest;
+
+    if (!total.count) return 0;
+
+    // target count is rounded up unless it is (within rounding error) an integer already (e.g. .07 * 100)
+    target  = limited::limit(quantile, 0.0, 1.0) * (double)total.count;
+    nearest = floor(target + .5);
+    target  = (fabs(target - nearest) <= 1.0e-9 * nearest) ? nearest : ceil(target);
+
+    // find first bin at which the cumulative count reaches target
+    target = std::max(target, 1.0);
+    return (uint_t)(std::lower_bound(counts.begin(), counts.end(), (uint_t)target) - counts.begin());
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Calculate quantile (0 = minimum, .5 = median, 1 = maximum) of indices
+   */
+  /*--------------------------------------------------------------------------------*/
+  INDEXTYPE CalculateQuantile(double quantile) const {return total.count ? CalcReversedIndex(CalcQuantileIndex(quantile)) : INDEXTYPE(0);}
+
   /*--------------------------------------------------------------------------------*/
   /** Calculate mean index (traditional histogram mean)
    */
@@ -170,15 +393,11 @@ public:
     list.resize(histogram.size());
     if (total.count)
     {
+      const std::vector<uint_t>& counts = GetCumulativeCounts();
       const double mul = 100.0 / (double)total.count;
-      double sum = 0.0;
       uint_t i;
 
-      for (i = 0; i < histogram.size(); i++)
-      {
-        sum    += (double)histogram[i].count;
-        list[i] = (float)(mul * sum);
-      }
+      for (i = 0; i < histogram.size(); i++) list[i] = (float)(mul * (double)counts[i]);
     }
     else list.assign(list.size(), 0.0);
   }
@@ -240,9 +459,39 @@ public:
   }
 
 protected:
-  INDEXTYPE         min, range;
-  std::vector<ITEM> histogram;
-  ITEM              total;
+  /*--------------------------------------------------------------------------------*/
+  /** Map index into binning domain and back
+   */
+  /*--------------------------------------------------------------------------------*/
+  double Map(INDEXTYPE index) const
+  {
+    switch (bins)
+    {
+      case Bins_Log:     return log10(std::max((double)index, 1.0e-300));
+      case Bins_dB:      return 20.0 * log10(std::max(fabs((double)index), 1.0e-300));
+      case Bins_dBPower: return 10.0 * log10(std::max(fabs((double)index), 1.0e-300));
+      default:           return (double)index;
+    }
+  }
+  INDEXTYPE Unmap(double val) const
+  {
+    switch (bins)
+    {
+      case Bins_Log:     return (INDEXTYPE)pow(10.0, val);
+      case Bins_dB:      return (INDEXTYPE)pow(10.0, val / 20.0);
+      case Bins_dBPower: return (INDEXTYPE)pow(10.0, val / 10.0);
+      default:           return (INDEXTYPE)val;
+    }
+  }
+
+protected:
+  INDEXTYPE                   min, range;
+  Bins_t                      bins;
+  std::vector<ITEM>           histogram;
+  ITEM                        total;
+  mutable std::vector<uint_t> cumulative;         // cached cumulative counts
+  mutable bool                cumulativevalid;
+  mutable std::mutex          cumulativelock;     // protects cumulative and cumulativevalid in const methods
 };
 
 BBC_AUDIOTOOLBOX_END
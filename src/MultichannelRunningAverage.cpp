@@ -0,0 +1,296 @@
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#elif defined(__SSE3__)
+#include <pmmintrin.h>
+#endif
+
+#define BBCDEBUG_LEVEL 1
+#include "MultichannelRunningAverage.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Copy (or square) n samples
+ */
+/*--------------------------------------------------------------------------------*/
+static void CopySamples(const float *src, float *dst, uint_t n, bool squared)
+{
+  uint_t i = 0;
+
+  if (!squared)
+  {
+    memcpy(dst, src, n * sizeof(*dst));
+    return;
+  }
+
+#ifdef __AVX__
+  for (; (i + 8) <= n; i += 8)
+  {
+    const __m256 x = _mm256_loadu_ps(src + i);
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(x, x));
+  }
+#endif
+#if defined(__AVX__) || defined(__SSE3__)
+  for (; (i + 4) <= n; i += 4)
+  {
+    const __m128 x = _mm_loadu_ps(src + i);
+    _mm_storeu_ps(dst + i, _mm_mul_ps(x, x));
+  }
+#endif
+  for (; i < n; i++) dst[i] = src[i] * src[i];
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Update n sums with new samples and samples leaving the window
+ */
+/*--------------------------------------------------------------------------------*/
+static void UpdateSums(float *sums, const float *x, const float *old, uint_t n)
+{
+  uint_t i = 0;
+
+#ifdef __AVX__
+  for (; (i + 8) <= n; i += 8)
+  {
+    _mm256_storeu_ps(sums + i, _mm256_add_ps(_mm256_loadu_ps(sums + i), _mm256_sub_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(old + i))));
+  }
+#endif
+#if defined(__AVX__) || defined(__SSE3__)
+  for (; (i + 4) <= n; i += 4)
+  {
+    _mm_storeu_ps(sums + i, _mm_add_ps(_mm_loadu_ps(sums + i), _mm_sub_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(old + i))));
+  }
+#endif
+  for (; i < n; i++) sums[i] += x[i] - old[i];
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Add n samples to n double precision sums
+ */
+/*--------------------------------------------------------------------------------*/
+static void AccumulateSums(double *sums, const float *x, uint_t n)
+{
+  uint_t i = 0;
+
+#ifdef __AVX__
+  for (; (i + 4) <= n; i += 4)
+  {
+    _mm256_storeu_pd(sums + i, _mm256_add_pd(_mm256_loadu_pd(sums + i), _mm256_cvtps_pd(_mm_loadu_ps(x + i))));
+  }
+#elif defined(__SSE3__)
+  for (; (i + 2) <= n; i += 2)
+  {
+    _mm_storeu_pd(sums + i, _mm_add_pd(_mm_loadu_pd(sums + i), _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)(x + i))))));
+  }
+#endif
+  for (; i < n; i++) sums[i] += (double)x[i];
+}
+
+MultichannelRunningAverage::MultichannelRunningAverage(uint_t _channels, uint_t _length, bool _squared) : channels(0),
+                                                                                                          length(0),
+                                                                                                          squared(false),
+                                                                                                          pos(0),
+                                                                                                          written(0)
+{
+  Setup(_channels, _length, _squared);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set up running averages
+ *
+ * @param _channels number of channels
+ * @param _length length of main window (and history) in frames
+ * @param _squared true to average the squares of samples (for RMS)
+ *
+ * @note any additional windows are removed
+ */
+/*--------------------------------------------------------------------------------*/
+void MultichannelRunningAverage::Setup(uint_t _channels, uint_t _length, bool _squared)
+{
+  channels = _channels;
+  length   = _length;
+  squared  = _squared;
+
+  history.resize(length * channels);
+  frame.resize(channels);
+  resum.resize(channels);
+
+  windows.resize(1);
+  windows[0].length = length;
+
+  Reset();
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Add an additional window which re-uses the history
+ *
+ * @param _length length of window in frames (limited to GetLength())
+ *
+ * @return window index to use with GetAverage(), etc.
+ *
+ * @note the window starts with the current contents of the history
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t MultichannelRunningAverage::AddWindow(uint_t _length)
+{
+  WINDOW window;
+
+  window.length      = std::max(std::min(_length, length), (uint_t)1);
+  window.sums.resize(channels);
+  window.fresh.assign(channels, 0.0);
+  window.freshframes = 0;
+  windows.push_back(window);
+
+  // calculate sums from history
+  Resum();
+
+  return (uint_t)windows.size() - 1;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Reset history and sums
+ */
+/*--------------------------------------------------------------------------------*/
+void MultichannelRunningAverage::Reset()
+{
+  uint_t i;
+
+  if (history.size()) memset(&history[0], 0, history.size() * sizeof(history[0]));
+  for (i = 0; i < windows.size(); i++)
+  {
+    windows[i].sums.assign(channels, 0.f);
+    windows[i].fresh.assign(channels, 0.0);
+    windows[i].freshframes = 0;
+  }
+
+  pos     = 0;
+  written = 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Write interleaved frames and update all sums
+ *
+ * @param src source buffer
+ * @param srcchannel channel within source to start reading from
+ * @param nsrcchannels total number of channels in source
+ * @param nframes number of frames
+ *
+ * @note GetChannels() channels are read from src
+ */
+/*--------------------------------------------------------------------------------*/
+void MultichannelRunningAverage::Write(const float *src, uint_t srcchannel, uint_t nsrcchannels, uint_t nframes)
+{
+  if (!length || !channels || ((srcchannel + channels) > nsrcchannels)) return;
+
+  uint_t i, j, k;
+
+  src += srcchannel;
+  for (i = 0; i < nframes; i++, src += nsrcchannels)
+  {
+    float *dst = &history[pos * channels];
+
+    CopySamples(src, &frame[0], channels, squared);
+
+    // update each window with new frame and the frame leaving it
+    for (j = 0; j < windows.size(); j++)
+    {
+      WINDOW&      window = windows[j];
+      const uint_t oldpos = (pos + length - window.length) % length;
+
+      UpdateSums(&window.sums[0], &frame[0], &history[oldpos * channels], channels);
+
+      // once the fresh sums cover the whole window, use them to replace the (drifting) running sums
+      AccumulateSums(&window.fresh[0], &frame[0], channels);
+      if ((++window.freshframes) == window.length)
+      {
+        for (k = 0; k < channels; k++)
+        {
+          window.sums[k]  = (float)window.fresh[k];
+          window.fresh[k] = 0.0;
+        }
+        window.freshframes = 0;
+      }
+    }
+
+    memcpy(dst, &frame[0], channels * sizeof(*dst));
+
+    if ((++pos) == length) pos = 0;
+    written++;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Recalculate all sums exactly from history
+ */
+/*--------------------------------------------------------------------------------*/
+void MultichannelRunningAverage::Resum()
+{
+  uint_t i, j, k;
+
+  for (i = 0; i < windows.size(); i++)
+  {
+    WINDOW&      window  = windows[i];
+    const uint_t nframes = GetWindowFrames(i);
+
+    resum.assign(channels, 0.0);
+    for (j = 0; j < nframes; j++)
+    {
+      const float *data = &history[((pos + length - 1 - j) % length) * channels];
+
+      for (k = 0; k < channels; k++) resum[k] += (double)data[k];
+    }
+
+    for (k = 0; k < channels; k++) window.sums[k] = (float)resum[k];
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return current average of a channel for a window
+ *
+ * @note before a window has been filled, the average is of the frames written so far
+ */
+/*--------------------------------------------------------------------------------*/
+float MultichannelRunningAverage::GetAverage(uint_t channel, uint_t window) const
+{
+  uint_t nframes;
+
+  if ((window < windows.size()) && (channel < channels) && ((nframes = GetWindowFrames(window)) > 0))
+  {
+    return windows[window].sums[channel] / (float)nframes;
+  }
+
+  return 0.f;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return current averages of all channels for a window
+ *
+ * @param dst destination for GetChannels() averages
+ * @param window window index
+ * @param root true to return the square root of the averages (i.e. RMS when squared)
+ */
+/*--------------------------------------------------------------------------------*/
+void MultichannelRunningAverage::GetAverages(float *dst, uint_t window, bool root) const
+{
+  uint_t i;
+
+  if (window < windows.size())
+  {
+    const uint_t nframes = GetWindowFrames(window);
+    const float  mul     = nframes ? 1.f / (float)nframes : 0.f;
+
+    for (i = 0; i < channels; i++)
+    {
+      // sums may go very slightly negative due to rounding
+      const float av = windows[window].sums[i] * mul;
+      dst[i] = root ? sqrtf(std::max(av, 0.f)) : av;
+    }
+  }
+  else memset(dst, 0, channels * sizeof(*dst));
+}
+
+BBC_AUDIOTOOLBOX_END
@@ -0,0 +1,149 @@
+#ifndef __MULTICHANNEL_RUNNING_AVERAGE__
+#define __MULTICHANNEL_RUNNING_AVERAGE__
+
+#include <vector>
+
+#include <bbcat-base/misc.h>
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Running averages of many channels of interleaved audio (e.g. for RMS metering)
+ *
+ * The history is a single channel-interleaved ring of frames so that the sums of all channels
+ * are updated together (SIMD across channels) as each frame is written
+ *
+ * Besides the main window (the full length of the history), further shorter windows can be added
+ * which re-use the same history (like RunningAverage::AltAverage())
+ *
+ * Sums are held as floats; to remove the drift caused by accumulating rounding errors each window
+ * also accumulates (in double precision, with no subtractions) the frames written since it was last
+ * refreshed, which replaces the running sum each time it covers the whole window, so drift is
+ * removed continuously at a constant cost per frame (with no periodic recalculation on the audio thread)
+ */
+/*--------------------------------------------------------------------------------*/
+class MultichannelRunningAverage
+{
+public:
+  /*--------------------------------------------------------------------------------*/
+  /** Constructor
+   *
+   * @param _channels number of channels
+   * @param _length length of main window (and history) in frames
+   * @param _squared true to average the squares of samples (for RMS)
+   */
+  /*--------------------------------------------------------------------------------*/
+  MultichannelRunningAverage(uint_t _channels = 0, uint_t _length = 0, bool _squared = false);
+  ~MultichannelRunningAverage() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set up running averages
+   *
+   * @param _channels number of channels
+   * @param _length length of main window (and history) in frames
+   * @param _squared true to average the squares of samples (for RMS)
+   *
+   * @note any additional windows are removed
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Setup(uint_t _channels, uint_t _length, bool _squared = false);
+
+  uint_t GetChannels() const {return channels;}
+  uint_t GetLength()   const {return length;}
+  bool   GetSquared()  const {return squared;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Add an additional window which re-uses the history
+   *
+   * @param _length length of window in frames (limited to GetLength())
+   *
+   * @return window index to use with GetAverage(), etc.
+   *
+   * @note the window starts with the current contents of the history
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t AddWindow(uint_t _length);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of windows (including the main window 0)
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetWindows() const {return (uint_t)windows.size();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Reset history and sums
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Write interleaved frames and update all sums
+   *
+   * @param src source buffer
+   * @param srcchannel channel within source to start reading from
+   * @param nsrcchannels total number of channels in source
+   * @param nframes number of frames
+   *
+   * @note GetChannels() channels are read from src
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Write(const float *src, uint_t srcchannel, uint_t nsrcchannels, uint_t nframes);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Recalculate all sums exactly from history
+   *
+   * @note O(length x channels x windows), not needed during normal operation
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Resum();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return current sum / average of a channel for a window
+   *
+   * @note before a window has been filled, the average is of the frames written so far
+   */
+  /*--------------------------------------------------------------------------------*/
+  float GetSum(uint_t channel, uint_t window = 0) const {return ((window < windows.size()) && (channel < channels)) ? windows[window].sums[channel] : 0.f;}
+  float GetAverage(uint_t channel, uint_t window = 0) const;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return current averages of all channels for a window
+   *
+   * @param dst destination for GetChannels() averages
+   * @param window window index
+   * @param root true to return the square root of the averages (i.e. RMS when squared)
+   */
+  /*--------------------------------------------------------------------------------*/
+  void GetAverages(float *dst, uint_t window = 0, bool root = false) const;
+
+protected:
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of frames currently contributing to a window
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetWindowFrames(uint_t window) const {return (uint_t)std::min(written, (uint64_t)windows[window].length);}
+
+protected:
+  typedef struct
+  {
+    uint_t              length;
+    std::vector<float>  sums;           // one per channel
+    std::vector<double> fresh;          // sums of frames written since last refresh, one per channel
+    uint_t              freshframes;    // number of frames in fresh sums
+  } WINDOW;
+
+protected:
+  uint_t              channels;
+  uint_t              length;
+  bool                squared;
+  std::vector<float>  history;          // ring of frames of channels
+  std::vector<float>  frame;            // current (squared) frame
+  std::vector<WINDOW> windows;          // window 0 is the full length of the history
+  std::vector<double> resum;            // exact sums during recalculation
+  uint_t              pos;              // write position in frames
+  uint64_t            written;          // total frames written
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
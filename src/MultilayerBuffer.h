@@ -11,6 +11,102 @@
 
 BBC_AUDIOTOOLBOX_START
 
+/*--------------------------------------------------------------------------------*/
+/** Preallocated pool of fixed-size blocks ('chunks') of frames for MultilayerBuffer
+ *
+ * All memory is allocated when the pool is set up, chunks are handed out to and returned by buffers
+ * without any further allocation so memory use is fixed and allocation never occurs on the audio thread
+ *
+ * One pool can be shared by several buffers (with the same number of channels), limiting their total memory
+ *
+ * @note chunks are always returned to the pool clear
+ * @note NOT thread-safe, the pool must outlive every buffer using it
+ */
+/*--------------------------------------------------------------------------------*/
+template<typename T>
+class MultilayerBufferPool
+{
+public:
+  /*--------------------------------------------------------------------------------*/
+  /** Constructor
+   *
+   * @param _channels number of channels in each frame
+   * @param _chunkframes number of frames in each chunk
+   * @param _nchunks number of chunks in pool
+   */
+  /*--------------------------------------------------------------------------------*/
+  MultilayerBufferPool(uint_t _channels = 0, uint_t _chunkframes = 256, uint_t _nchunks = 0) {Setup(_channels, _chunkframes, _nchunks);}
+  ~MultilayerBufferPool() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Setup pool
+   *
+   * @param _channels number of channels in each frame
+   * @param _chunkframes number of frames in each chunk
+   * @param _nchunks number of chunks in pool
+   *
+   * @note must not be called whilst any buffer holds chunks from the pool
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Setup(uint_t _channels, uint_t _chunkframes, uint_t _nchunks)
+  {
+    uint_t i;
+
+    channels    = _channels;
+    chunkframes = _chunkframes;
+    data.assign(channels * chunkframes * _nchunks, 0);
+
+    // free list holds every chunk (first chunk at the back)
+    freechunks.resize(data.size() ? _nchunks : 0);
+    for (i = 0; i < (uint_t)freechunks.size(); i++) freechunks[i] = &data[(freechunks.size() - 1 - i) * channels * chunkframes];
+    nchunks = (uint_t)freechunks.size();
+  }
+
+  uint_t GetChannels()    const {return channels;}
+  uint_t GetChunkFrames() const {return chunkframes;}
+  uint_t GetChunks()      const {return nchunks;}
+  uint_t GetFreeChunks()  const {return (uint_t)freechunks.size();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Take a (clear) chunk from the pool
+   *
+   * @return chunk or NULL if the pool is exhausted
+   */
+  /*--------------------------------------------------------------------------------*/
+  T *Allocate()
+  {
+    T *chunk = NULL;
+
+    if (freechunks.size())
+    {
+      chunk = freechunks.back();
+      freechunks.pop_back();
+    }
+
+    return chunk;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return a chunk to the pool
+   *
+   * @note the chunk MUST be clear
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Release(T *chunk) {freechunks.push_back(chunk);}
+
+protected:
+  std::vector<T>   data;
+  std::vector<T *> freechunks;          // capacity is always nchunks so releasing never allocates
+  uint_t           channels;
+  uint_t           chunkframes;
+  uint_t           nchunks;
+
+private:
+  // copying is not supported
+  MultilayerBufferPool(const MultilayerBufferPool&);
+  MultilayerBufferPool& operator = (const MultilayerBufferPool&);
+};
+
 /*--------------------------------------------------------------------------------*/
 /** Templated class to handle buffer containing multiple layers of mixed data
  *
@@ -39,7 +135,25 @@ BBC_AUDIOTOOLBOX_START
  * |     ^ minposition                  ^ maxposition
  * |^^^^^ this data can be read and removed because it has been written by all layers
  *
- * @note the buffer expands as necessary with incoming data
+ * The data is held in circular storage so that removing read data only moves the head of the buffer
+ * (and clears the removed frames), the cost of a read is therefore independent of the amount of data buffered
+ *
+ * Layers are identified by handles which remain valid until the layer is deleted (deleting a layer
+ * does not renumber other layers), handles of deleted layers are re-used by later AddLayer() calls
+ *
+ * Layer positions are held in a tournament tree (a binary tree in which each node holds the minimum
+ * of its children) so that the minimum position is updated in O(log L) when any layer is written,
+ * rather than scanning all L layers, and positions are held relative to a base which moves when
+ * data is read so that reading does not update every layer
+ *
+ * Alternatively, the data can be held in fixed-size chunks taken from a preallocated pool (see SetPool()),
+ * chunks are taken as layers write ahead and returned to the pool as soon as they have been read, the
+ * buffer is limited to a maximum number of chunks and writes beyond this (or beyond the free chunks in the
+ * pool) are limited (back-pressure) so that memory use is fixed and no allocation ever occurs
+ *
+ * @note without a pool, the buffer expands as necessary with incoming data
+ * @note because the storage is circular (or chunked), raw access (GetWritableLayer() and GetReadableBuffer()) may
+ * @note return data in two (or more) segments
  */
 /*--------------------------------------------------------------------------------*/
 template<typename T>
@@ -53,30 +167,65 @@ public:
    * @param _layers number of layers
    */
   /*--------------------------------------------------------------------------------*/
-  MultilayerBuffer(uint_t _channels = 0, uint_t _layers = 0) {Setup(_channels, _layers);}
+  MultilayerBuffer(uint_t _channels = 0, uint_t _layers = 0) : pool(NULL),
+                                                               firstchunk(0),
+                                                               usedchunks(0),
+                                                               chunkoffset(0) {Setup(_channels, _layers);}
 
   /*--------------------------------------------------------------------------------*/
   /** Copy constructor
    */
   /*--------------------------------------------------------------------------------*/
-  MultilayerBuffer(const MultilayerBuffer& obj) : buffer(obj.buffer),
-                                                  positions(obj.positions),
-                                                  channels(obj.channels),
-                                                  minposition(obj.minposition),
-                                                  maxposition(obj.maxposition) {}
-  ~MultilayerBuffer() {}
+  MultilayerBuffer(const MultilayerBuffer& obj) : pool(NULL),
+                                                  firstchunk(0),
+                                                  usedchunks(0),
+                                                  chunkoffset(0) {operator = (obj);}
+  ~MultilayerBuffer() {ReleaseChunks();}
 
   /*--------------------------------------------------------------------------------*/
   /** Assignment operator
+   *
+   * @note a copy of a buffer using a pool does *not* use the pool (its data is copied into expandable storage)
    */
   /*--------------------------------------------------------------------------------*/
   MultilayerBuffer& operator = (const MultilayerBuffer& obj)
   {
-    buffer      = obj.buffer;
-    positions   = obj.positions;
-    channels    = obj.channels;
-    minposition = obj.minposition;
-    maxposition = obj.maxposition;
+    if (&obj != this)
+    {
+      ReleaseChunks();
+      pool = NULL;
+      chunks.clear();
+
+      positions   = obj.positions;
+      tree        = obj.tree;
+      freelayers  = obj.freelayers;
+      nlayers     = obj.nlayers;
+      base        = obj.base;
+      channels    = obj.channels;
+      length      = obj.length;
+      minposition = obj.minposition;
+      maxposition = obj.maxposition;
+
+      if (obj.pool)
+      {
+        // copy chunks into contiguous storage
+        uint_t pos = 0, n;
+
+        buffer.assign(length * channels, 0);
+        for (pos = 0; pos < length; pos += n)
+        {
+          n = std::min(length - pos, obj.GetContiguousFrames(pos));
+          memcpy(&buffer[pos * channels], obj.GetFrame(pos), n * channels * sizeof(buffer[0]));
+        }
+        head = 0;
+      }
+      else
+      {
+        buffer = obj.buffer;
+        head   = obj.head;
+      }
+    }
+    return *this;
   }
   
   /*--------------------------------------------------------------------------------*/
@@ -84,12 +233,25 @@ public:
    *
    * @param _channels number of channels in buffer
    * @param _layers number of layers
+   *
+   * @note any pool is detached (see SetPool())
    */
   /*--------------------------------------------------------------------------------*/
   void Setup(uint_t _channels, uint_t _layers)
   {
-    channels = _channels;
-    positions.resize(_layers);
+    ReleaseChunks();
+    pool        = NULL;
+    chunks.clear();
+    channels    = _channels;
+    length      = 0;
+    head        = 0;
+    buffer.clear();
+    positions.clear();
+    freelayers.clear();
+    nlayers     = 0;
+    base        = 0;
+    minposition = maxposition = 0;
+    SetLayers(_layers);
     Reset();
   }
 
@@ -99,44 +261,149 @@ public:
   /*--------------------------------------------------------------------------------*/
   void Reset()
   {
-    if (positions.size()) memset(&positions[0], 0, positions.size() * sizeof(positions[0]));
-    if (buffer.size())    memset(&buffer[0], 0, buffer.size() * sizeof(buffer[0]));
+    uint_t i;
+
+    // reset positions of all layers to the start
+    for (i = 0; i < (uint_t)positions.size(); i++)
+    {
+      if (positions[i] != InactiveLayer) positions[i] = 0;
+    }
+    base = 0;
+    RebuildTree();
+
+    if (buffer.size()) memset(&buffer[0], 0, buffer.size() * sizeof(buffer[0]));
+    head        = 0;
     minposition = maxposition = 0;
+
+    // return all chunks to the pool
+    ReleaseChunks();
   }
 
   /*--------------------------------------------------------------------------------*/
-  /** Change number of layers
+  /** Set pool to take chunks of storage from (or NULL to use expandable storage)
+   *
+   * @param _pool pool (with the same number of channels as this buffer)
+   * @param maxchunks maximum number of chunks this buffer can hold (0 = all chunks in the pool)
+   *
+   * @return true if the pool is acceptable
+   *
+   * @note the buffer is reset
+   * @note the buffer can hold up to ((maxchunks - 1) * chunk frames) frames ahead of the read position
+   * @note (more when reading is aligned to chunks)
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool SetPool(MultilayerBufferPool<T> *_pool, uint_t maxchunks = 0)
+  {
+    if (_pool && (_pool->GetChannels() != channels))
+    {
+      BBCERROR("Pool channels (%u) does not match buffer channels (%u)", _pool->GetChannels(), channels);
+      return false;
+    }
+
+    ReleaseChunks();
+    pool   = _pool;
+    chunks.assign(pool ? (maxchunks ? maxchunks : pool->GetChunks()) : 0, NULL);
+    buffer.clear();
+    length = 0;
+    Reset();
+
+    return true;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return pool (or NULL if expandable storage is used)
+   */
+  /*--------------------------------------------------------------------------------*/
+  MultilayerBufferPool<T> *GetPool() const {return pool;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Change number of layers such that layers 0 to (_layers - 1) exist and no others
    *
    * @param _layers number of layers
    *
-   * @note increasing the number of layers resets the available data back to zero but *no* data is lost
+   * @note adding layers resets the available data back to zero but *no* data is lost
    */
   /*--------------------------------------------------------------------------------*/
   void SetLayers(uint_t _layers)
   {
-    // if layers are to be *added*, minimum position has to be reset to 0
-    if (_layers > (uint_t)positions.size()) minposition = 0;
-    positions.resize(_layers);
+    uint_t i;
+
+    // new layers start at the current (logical) start of the buffer
+    if (_layers > (uint_t)positions.size()) positions.resize(_layers, base);
+
+    nlayers = 0;
+    freelayers.clear();
+    for (i = (uint_t)positions.size(); i > 0; i--)
+    {
+      uint64_t& pos = positions[i - 1];
+
+      if      (i > _layers)          pos = InactiveLayer;
+      else if (pos == InactiveLayer) pos = base;
+
+      if (pos == InactiveLayer) freelayers.push_back(i - 1);
+      else                      nlayers++;
+    }
+
+    RebuildTree();
+    UpdateMinPosition();
   }
 
   /*--------------------------------------------------------------------------------*/
-  /** Add layer at end
+  /** Add layer
+   *
+   * @return handle of new layer (the handle of a previously deleted layer may be re-used)
+   *
+   * @note the new layer starts at the start of the buffer, resetting the available data back to zero
    */
   /*--------------------------------------------------------------------------------*/
-  uint_t AddLayer() {uint_t layer = GetLayers(); SetLayers(layer + 1); return layer;}
+  uint_t AddLayer()
+  {
+    uint_t layer;
+
+    if (freelayers.size())
+    {
+      layer = freelayers.back();
+      freelayers.pop_back();
+    }
+    else
+    {
+      layer = (uint_t)positions.size();
+      positions.push_back(InactiveLayer);
+
+      // expand tree if necessary (amortised O(1))
+      if (positions.size() > (tree.size() >> 1)) RebuildTree();
+    }
+
+    nlayers++;
+    SetLayerPosition(layer, base);
+    UpdateMinPosition();
+
+    return layer;
+  }
 
   /*--------------------------------------------------------------------------------*/
-  /** Delete layer - positions are moved accordingly
+  /** Delete layer
+   *
+   * @note the handles of other layers are unaffected
+   * @note if the deleted layer was the furthest behind, more data may become available
    */
   /*--------------------------------------------------------------------------------*/
   void DeleteLayer(uint_t layer)
   {
-    if (layer < positions.size())
+    if (IsLayer(layer))
     {
-      // remove layer from array of positions
-      positions.erase(positions.begin() + layer);
+      SetLayerPosition(layer, InactiveLayer);
+      freelayers.push_back(layer);
+      nlayers--;
+      UpdateMinPosition();
     }
   }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return whether layer handle refers to an existing layer
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool IsLayer(uint_t layer) const {return ((layer < (uint_t)positions.size()) && (positions[layer] != InactiveLayer));}
    
   /*--------------------------------------------------------------------------------*/
   /** Return number of channels in buffer
@@ -148,22 +415,27 @@ public:
   /** Return number of layers in buffer
    */
   /*--------------------------------------------------------------------------------*/
-  uint_t GetLayers()   const {return (uint_t)positions.size();}
+  uint_t GetLayers()   const {return nlayers;}
   
   /*--------------------------------------------------------------------------------*/
   /** Ensure there is enough space in buffer for new data for a layer
+   *
+   * @return number of frames that can be written (only less than nframes when using a pool)
    *
    * @note it is not necessary to call this function if using WriteLayer() below and is only
    * @note needed when GetWritableLayer() is used
    */
   /*--------------------------------------------------------------------------------*/
-  void ReserveSpace(uint_t layer, uint_t nframes)
+  uint_t ReserveSpace(uint_t layer, uint_t nframes)
   {
-    if (layer < (uint_t)positions.size())
+    if (IsLayer(layer))
     {
-      uint_t maxframes = (positions[layer] + nframes) * channels;
-      if (maxframes > buffer.size()) buffer.resize(maxframes);
+      uint_t maxframes = GetLayerPosition(layer) + nframes;
+      if (maxframes > length) Resize(maxframes);
+      return std::min(nframes, limited::subz(length, GetLayerPosition(layer)));
     }
+
+    return 0;
   }
   
   /*--------------------------------------------------------------------------------*/
@@ -178,27 +450,39 @@ public:
    * @param nframes number of frames to write
    * @param inc true to increment layer position after writing
    *
-   * @note the buffer may be expanded to ensure it can hold the data
+   * @return number of frames written (only less than nframes when using a pool)
+   *
+   * @note without a pool, the buffer may be expanded to ensure it can hold the data
    * @note if inc = false, the caller is responsible to ensuring the layer's position is correctly updated (use LayerWritten() below)
    */
   /*--------------------------------------------------------------------------------*/
-  void WriteLayer(uint_t layer, const T *src, uint_t srcchannel, uint_t nsrcchannels, uint_t ndstchannel, uint_t nchannels, uint_t nframes, bool inc = true)
+  uint_t WriteLayer(uint_t layer, const T *src, uint_t srcchannel, uint_t nsrcchannels, uint_t ndstchannel, uint_t nchannels, uint_t nframes, bool inc = true)
   {
-    if (layer < (uint_t)positions.size())
+    uint_t written = 0;
+
+    if (IsLayer(layer))
     {
-      // ensure there is space in the buffer, expanding it if necessary
-      ReserveSpace(layer, nframes);
-
-      // mix data into buffer at correct place
-      MixSamples(src, srcchannel, nsrcchannels,
-                 &buffer[positions[layer] * channels],
-                 ndstchannel, channels,
-                 nchannels,
-                 nframes);
-
-      // increment layer's position if inc is true
-      if (inc) LayerWritten(layer, nframes);
+      // ensure there is space in the buffer, expanding it if necessary (limited when using a pool)
+      nframes = ReserveSpace(layer, nframes);
+
+      // mix data into buffer at correct place (in up to two segments or in chunks)
+      uint_t pos = GetLayerPosition(layer), n;
+      while (nframes && ((n = std::min(nframes, GetContiguousFrames(pos))) > 0))
+      {
+        MixSamples(src, srcchannel, nsrcchannels,
+                   GetFrame(pos),
+                   ndstchannel, channels,
+                   nchannels,
+                   n);
+        src     += n * nsrcchannels;
+        pos     += n;
+        nframes -= n;
+        written += n;
+        if (inc) LayerWritten(layer, n);
+      }
     }
+
+    return written;
   }
 
   /*--------------------------------------------------------------------------------*/
@@ -209,9 +493,59 @@ public:
    * @return pointer to data location
    *
    * @note IMPORTANT: ensure there is space in the buffer by using ReserveSpace() above *before* calling this function!
+   * @note the location is only contiguous up to the end of the circular storage, use the versions below
+   * @note to find out how many frames can be written contiguously
+   */
+  /*--------------------------------------------------------------------------------*/
+  T *GetWritableLayer(uint_t layer) {return (IsLayer(layer) && (GetLayerPosition(layer) < length)) ? GetFrame(GetLayerPosition(layer)) : NULL;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return raw pointer to next writable location for a layer and the number of frames that can be written contiguously
+   *
+   * @param layer layer number
+   * @param contiguousframes destination for number of frames that can be written at the returned location
+   *
+   * @return pointer to data location
+   *
+   * @note the next location (if any) is returned by calling this after LayerWritten() or by using GetWritableSegments()
+   */
+  /*--------------------------------------------------------------------------------*/
+  T *GetWritableLayer(uint_t layer, uint_t& contiguousframes)
+  {
+    contiguousframes = 0;
+    if (IsLayer(layer) && (GetLayerPosition(layer) < length))
+    {
+      contiguousframes = std::min(GetContiguousFrames(GetLayerPosition(layer)), length - GetLayerPosition(layer));
+      return GetFrame(GetLayerPosition(layer));
+    }
+    return NULL;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return up to two segments of writable locations for nframes of a layer
+   *
+   * @param layer layer number
+   * @param nframes number of frames to be written
+   * @param segments destination for segment pointers
+   * @param frames destination for number of frames in each segment
+   *
+   * @return number of segments (0, 1 or 2)
+   *
+   * @note space is reserved for the frames
+   * @note when using a pool, the segments may cover fewer than nframes frames (write them, call LayerWritten() and call this again)
    */
   /*--------------------------------------------------------------------------------*/
-  T *GetWritableLayer(uint_t layer) {return (layer < (uint_t)positions.size()) ? &buffer[positions[layer] * channels] : NULL;}
+  uint_t GetWritableSegments(uint_t layer, uint_t nframes, T *segments[2], uint_t frames[2])
+  {
+    uint_t n = 0;
+
+    if (IsLayer(layer) && nframes)
+    {
+      n = GetSegments(GetLayerPosition(layer), ReserveSpace(layer, nframes), segments, frames);
+    }
+
+    return n;
+  }
   
   /*--------------------------------------------------------------------------------*/
   /** Advance layer position by specified amount
@@ -222,28 +556,24 @@ public:
    * @return number of frames available to be read out
    *
    * @note this function *may* result in data being available to be read out, see GetFramesAvailable() below
+   * @note when using a pool, the advancement is limited to the space available
    */
   /*--------------------------------------------------------------------------------*/
   uint_t LayerWritten(uint_t layer, uint_t nframes)
   {
-    if (layer < (uint_t)positions.size())
+    if (IsLayer(layer))
     {
       // ensure there is enough space in buffer for advancement
-      ReserveSpace(layer, nframes);
+      nframes = ReserveSpace(layer, nframes);
 
       // advance position for layer
-      positions[layer] += nframes;
-
-      // find minimum position for layers (i.e. the maximum number of frames written by ALL layers)
-      uint_t i;
-      for (i = 0; i < (uint_t)positions.size(); i++)
-      {
-        if (i == 0) minposition = positions[i];
-        else        minposition = std::min(minposition, positions[i]);
-      }
+      SetLayerPosition(layer, positions[layer] + nframes);
 
       // find maximum position for layers (i.e. the furthest point written by ANY layer)
-      maxposition = std::max(maxposition, positions[layer]);
+      maxposition = std::max(maxposition, GetLayerPosition(layer));
+
+      // find minimum position for layers (i.e. the maximum number of frames written by ALL layers)
+      UpdateMinPosition();
     }
 
     return minposition;
@@ -257,10 +587,29 @@ public:
 
   /*--------------------------------------------------------------------------------*/
   /** Get readable buffer and number of frames available
+   *
+   * @note availableframes is limited to the frames that are contiguous, after these have been removed
+   * @note using BufferRead() any further frames can be accessed by calling this again (or use GetReadableSegments())
+   */
+  /*--------------------------------------------------------------------------------*/
+  const T *GetReadableBuffer() const {return length ? GetFrame(0) : NULL;}
+  const T *GetReadableBuffer(uint_t& availableframes) const {availableframes = length ? std::min(minposition, GetContiguousFrames(0)) : 0; return GetReadableBuffer();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return up to two segments of readable data
+   *
+   * @param segments destination for segment pointers
+   * @param frames destination for number of frames in each segment
+   *
+   * @return number of segments (0, 1 or 2)
+   *
+   * @note when using a pool, the segments may not cover all available frames (call BufferRead() and call this again)
    */
   /*--------------------------------------------------------------------------------*/
-  const T *GetReadableBuffer() const {return &buffer[0];}
-  const T *GetReadableBuffer(uint_t& availableframes) const {availableframes = minposition; return &buffer[0];}
+  uint_t GetReadableSegments(const T *segments[2], uint_t frames[2]) const
+  {
+    return GetSegments(0, minposition, (T **)segments, frames);
+  }
 
   /*--------------------------------------------------------------------------------*/
   /** Read data from buffer
@@ -283,21 +632,33 @@ public:
     // limit frames to read to number of frames available
     if ((nframes = std::min(nframes, minposition)) > 0)
     {
-      if (overwrite)
-      {
-        // if overwriting, use TransferSamples()
-        TransferSamples(&buffer[0], srcchannel, channels,
-                        dst,        dstchannel, ndstchannels,
-                        nchannels,
-                        nframes);
-      }
-      else
+      uint_t pos, n;
+
+      // read in contiguous segments
+      for (pos = 0; pos < nframes; pos += n)
       {
-        // if overwriting, use MixSamples()
-        MixSamples(&buffer[0], srcchannel, channels,
-                   dst,        dstchannel, ndstchannels,
-                   nchannels,
-                   nframes);
+        const T *segment = GetFrame(pos);
+
+        n = std::min(nframes - pos, GetContiguousFrames(pos));
+
+        if (overwrite)
+        {
+          // if overwriting, use TransferSamples()
+          TransferSamples(segment, srcchannel, channels,
+                          dst,     dstchannel, ndstchannels,
+                          nchannels,
+                          n);
+        }
+        else
+        {
+          // if overwriting, use MixSamples()
+          MixSamples(segment, srcchannel, channels,
+                     dst,     dstchannel, ndstchannels,
+                     nchannels,
+                     n);
+        }
+
+        dst += n * ndstchannels;
       }
 
       // if inc is true, remove read data from buffer
@@ -389,17 +750,34 @@ public:
       minposition -= nframes;
       maxposition -= nframes;
 
-      // move each layer's position back
-      uint_t i;
-      for (i = 0; i < (uint_t)positions.size(); i++)
+      // move each layer's position back by moving the base
+      base += nframes;
+
+      // clear removed frames so that they are clear when re-used (very important!)
+      uint_t pos, n;
+      for (pos = 0; pos < nframes; pos += n)
       {
-        positions[i] -= nframes;
+        n = std::min(nframes - pos, GetContiguousFrames(pos));
+        memset(GetFrame(pos), 0, n * channels * sizeof(T));
       }
 
-      // shift data to front of buffer
-      if (maxposition) memmove(&buffer[0], &buffer[nframes * channels], maxposition * channels * sizeof(buffer[0]));
-      // and clear newly made space (very important!)
-      memset(&buffer[maxposition * channels], 0, nframes * channels * sizeof(buffer[0]));
+      if (pool)
+      {
+        // return fully read chunks to the pool
+        const uint_t chunkframes = pool->GetChunkFrames();
+
+        chunkoffset += nframes;
+        length      -= nframes;
+        while (usedchunks && (chunkoffset >= chunkframes))
+        {
+          pool->Release(chunks[firstchunk]);
+          firstchunk   = (firstchunk + 1) % (uint_t)chunks.size();
+          usedchunks--;
+          chunkoffset -= chunkframes;
+        }
+      }
+      // move head of buffer
+      else head = (head + nframes) % length;
     }
 
     // return number of frames removed
@@ -408,24 +786,217 @@ public:
 
   /*--------------------------------------------------------------------------------*/
   /** Return internal data buffer
+   *
+   * @note the buffer is circular, frame 0 is at GetHead()
+   * @note the buffer is empty when using a pool
    */
   /*--------------------------------------------------------------------------------*/
   const std::vector<T>& GetBuffer() const {return buffer;}
 
   /*--------------------------------------------------------------------------------*/
-  /** Return internal layer positions buffer
+  /** Return position of a layer (number of frames written beyond the start of the buffer)
    */
   /*--------------------------------------------------------------------------------*/
-  const std::vector<uint_t>& GetLayerPositions() const {return positions;}
-  
+  uint_t GetLayerPosition(uint_t layer) const {return IsLayer(layer) ? (uint_t)(positions[layer] - base) : 0;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return layer positions (indexed by handle, deleted layers have a position of 0)
+   */
+  /*--------------------------------------------------------------------------------*/
+  std::vector<uint_t> GetLayerPositions() const
+  {
+    std::vector<uint_t> list(positions.size());
+    uint_t i;
+    for (i = 0; i < (uint_t)list.size(); i++) list[i] = GetLayerPosition(i);
+    return list;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return length of circular storage in frames and the physical position of frame 0 within it
+   *
+   * @note when using a pool, the length is the number of frames from frame 0 to the end of the last chunk held
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetLength() const {return length;}
+  uint_t GetHead()   const {return head;}
+
 protected:
-  std::vector<T>      buffer;
-  std::vector<uint_t> positions;
-  uint_t              channels;
-  uint_t              minposition;
-  uint_t              maxposition;
+  static const uint64_t InactiveLayer = ~(uint64_t)0;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set (absolute) position of layer and update tournament tree
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetLayerPosition(uint_t layer, uint64_t pos)
+  {
+    uint_t i = layer + (uint_t)(tree.size() >> 1);
+
+    positions[layer] = tree[i] = pos;
+    for (i >>= 1; i > 0; i >>= 1) tree[i] = std::min(tree[2 * i], tree[2 * i + 1]);
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Rebuild tournament tree from positions
+   */
+  /*--------------------------------------------------------------------------------*/
+  void RebuildTree()
+  {
+    uint_t leaves = 1, i;
+
+    while (leaves < (uint_t)positions.size()) leaves <<= 1;
+
+    tree.assign(2 * leaves, InactiveLayer);
+    for (i = 0; i < (uint_t)positions.size(); i++) tree[leaves + i] = positions[i];
+    for (i = leaves - 1; i > 0; i--) tree[i] = std::min(tree[2 * i], tree[2 * i + 1]);
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Update minimum position from tournament tree
+   *
+   * @note with no layers, all data written is available
+   */
+  /*--------------------------------------------------------------------------------*/
+  void UpdateMinPosition()
+  {
+    minposition = (tree.size() && (tree[1] != InactiveLayer)) ? (uint_t)(tree[1] - base) : maxposition;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return pointer to (logical) frame position
+   */
+  /*--------------------------------------------------------------------------------*/
+  T *GetFrame(uint_t position) const
+  {
+    if (pool)
+    {
+      const uint_t chunkframes = pool->GetChunkFrames(), pos = chunkoffset + position;
+      return chunks[(firstchunk + pos / chunkframes) % (uint_t)chunks.size()] + (pos % chunkframes) * channels;
+    }
+
+    return const_cast<T *>(&buffer[((head + position) % length) * channels]);
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of frames from (logical) frame position to the end of the circular storage
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetContiguousFrames(uint_t position) const
+  {
+    if (pool) return pool->GetChunkFrames() - ((chunkoffset + position) % pool->GetChunkFrames());
+    return length - ((head + position) % length);
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Split nframes from (logical) position into up to two contiguous segments
+   *
+   * @return number of segments
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetSegments(uint_t position, uint_t nframes, T *segments[2], uint_t frames[2]) const
+  {
+    uint_t n = 0;
+
+    if (length && nframes)
+    {
+      segments[0] = GetFrame(position);
+      frames[0]   = std::min(nframes, GetContiguousFrames(position));
+      n++;
+
+      if (frames[0] < nframes)
+      {
+        segments[1] = GetFrame(position + frames[0]);
+        frames[1]   = std::min(nframes - frames[0], GetContiguousFrames(position + frames[0]));
+        n++;
+      }
+    }
+
+    return n;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Expand circular storage to hold at least nframes, moving data so that frame 0 is at the start
+   *
+   * @note when using a pool, chunks are taken from the pool instead (limited by the maximum number of chunks)
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Resize(uint_t nframes)
+  {
+    if (pool)
+    {
+      T *chunk;
+
+      while ((length < nframes) && (usedchunks < (uint_t)chunks.size()) && ((chunk = pool->Allocate()) != NULL))
+      {
+        chunks[(firstchunk + usedchunks) % (uint_t)chunks.size()] = chunk;
+        usedchunks++;
+        length += pool->GetChunkFrames();
+      }
+      return;
+    }
+
+    // grow geometrically to avoid frequent re-allocations
+    // (the whole of the old storage is copied since layers written without incrementing their
+    // position can hold data beyond maxposition)
+    uint_t         newlength = std::max(nframes, length + (length >> 1));
+    std::vector<T> newbuffer(newlength * channels);
+    const T        *segments[2];
+    uint_t         frames[2], i, nsegments = GetSegments(0, length, (T **)segments, frames), pos = 0;
+
+    for (i = 0; i < nsegments; i++)
+    {
+      memcpy(&newbuffer[pos * channels], segments[i], frames[i] * channels * sizeof(buffer[0]));
+      pos += frames[i];
+    }
+
+    buffer.swap(newbuffer);
+    length = newlength;
+    head   = 0;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Clear and return all chunks to the pool
+   */
+  /*--------------------------------------------------------------------------------*/
+  void ReleaseChunks()
+  {
+    if (pool)
+    {
+      // chunks may contain data written ahead of the layer positions so clear them completely
+      while (usedchunks)
+      {
+        memset(chunks[firstchunk], 0, pool->GetChunkFrames() * channels * sizeof(T));
+        pool->Release(chunks[firstchunk]);
+        firstchunk = (firstchunk + 1) % (uint_t)chunks.size();
+        usedchunks--;
+      }
+      firstchunk  = 0;
+      chunkoffset = 0;
+      length      = 0;
+    }
+  }
+
+protected:
+  std::vector<T>        buffer;
+  std::vector<uint64_t> positions;        // absolute position of each layer (InactiveLayer for deleted layers)
+  std::vector<uint64_t> tree;             // tournament tree of positions (node i is the minimum of nodes 2i and 2i + 1)
+  std::vector<uint_t>   freelayers;       // handles of deleted layers
+  uint_t                nlayers;          // number of layers that exist
+  uint64_t              base;             // absolute position of the start of the buffer
+  uint_t                channels;
+  uint_t                length;           // length of circular storage in frames
+  uint_t                head;             // physical position of frame 0
+  uint_t                minposition;
+  uint_t                maxposition;
+  MultilayerBufferPool<T> *pool;          // pool of chunks (NULL for expandable storage)
+  std::vector<T *>      chunks;           // circular list of chunks held (length is the maximum number of chunks)
+  uint_t                firstchunk;       // index of chunk holding frame 0
+  uint_t                usedchunks;       // number of chunks held
+  uint_t                chunkoffset;      // offset of frame 0 within first chunk
 };
 
+template<typename T>
+const uint64_t MultilayerBuffer<T>::InactiveLayer;
+
 BBC_AUDIOTOOLBOX_END
 
 #endif
@@ -0,0 +1,334 @@
+#include <string.h>
+
+#include <algorithm>
+
+#define BBCDEBUG_LEVEL 1
+#include "NonUniformConvolver.h"
+
+BBC_AUDIOTOOLBOX_START
+
+NonUniformConvolver::NonUniformConvolver() : blocksize(0),
+                                             headfilter(NULL),
+                                             t(0),
+                                             quit(false)
+{
+  misses = 0;
+}
+
+NonUniformConvolver::~NonUniformConvolver()
+{
+  StopThreads();
+  DeleteSegments();
+}
+
+void NonUniformConvolver::StopThreads()
+{
+  uint_t i;
+
+  {
+    std::lock_guard<std::mutex> lock(tlock);
+    quit = true;
+  }
+  jobcond.notify_all();
+
+  for (i = 0; i < threads.size(); i++)
+  {
+    threads[i]->join();
+    delete threads[i];
+  }
+  threads.clear();
+
+  quit = false;
+}
+
+void NonUniformConvolver::DeleteSegments()
+{
+  uint_t i, j;
+
+  for (i = 0; i < segments.size(); i++)
+  {
+    SEGMENT *seg = segments[i];
+
+    for (j = 0; j < JobSlots; j++)
+    {
+      FFT::FreeBuffer(seg->jobs[j].input);
+      FFT::FreeBuffer(seg->jobs[j].output);
+    }
+    FFT::FreeBuffer(seg->stage);
+    seg->conv.SetFilter(NULL);
+    delete seg->filter;
+    delete seg;
+  }
+  segments.clear();
+
+  head.SetFilter(NULL);
+  if (headfilter)
+  {
+    delete headfilter;
+    headfilter = NULL;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set up convolver
+ *
+ * @param _blocksize base block size (a power of 2, this is the latency)
+ * @param ir impulse response
+ * @param irlength length of impulse response in samples
+ * @param nthreads number of worker threads (0 to compute tail segments synchronously)
+ * @param maxblocksize maximum block size (rounded up to a power of 2 >= _blocksize)
+ *
+ * @return true if set up successfully
+ */
+/*--------------------------------------------------------------------------------*/
+bool NonUniformConvolver::Setup(uint_t _blocksize, const float *ir, uint_t irlength, uint_t nthreads, uint_t maxblocksize)
+{
+  uint_t offset, len, bs, i, j;
+
+  StopThreads();
+  DeleteSegments();
+  blocksize = 0;
+
+  if (!FFT::IsValidSize(2 * _blocksize) || !irlength)
+  {
+    BBCERROR("Invalid non-uniform convolver parameters (block size %u, IR length %u)", _blocksize, irlength);
+    return false;
+  }
+
+  maxblocksize = std::max(maxblocksize, _blocksize);
+  for (bs = _blocksize; bs < maxblocksize; bs <<= 1) ;
+  maxblocksize = bs;
+
+  // head: first three blocks (or whole IR if no larger blocks are allowed)
+  len = (maxblocksize > _blocksize) ? std::min(irlength, 3 * _blocksize) : irlength;
+  headfilter = new BlockConvolver::Filter(_blocksize, ir, len);
+  if (!head.Setup(_blocksize, headfilter->GetPartitions()) || !head.SetFilter(headfilter)) return false;
+
+  // tail: segments of two blocks of 2, 4, 8... base blocks, segment with block size B starting at 2B - N
+  for (offset = len, bs = 2 * _blocksize; offset < irlength; offset += len, bs <<= 1)
+  {
+    SEGMENT *seg = new SEGMENT;
+
+    bs  = std::min(bs, maxblocksize);
+    len = (bs < maxblocksize) ? std::min(2 * bs, irlength - offset) : (irlength - offset);
+
+    seg->blocksize = bs;
+    seg->delay     = _blocksize + offset - bs;
+    seg->filter    = new BlockConvolver::Filter(bs, ir + offset, len);
+    seg->stage     = FFT::AllocateBuffer(bs);
+    for (i = 0; i < JobSlots; i++)
+    {
+      seg->jobs[i].input  = FFT::AllocateBuffer(bs);
+      seg->jobs[i].output = FFT::AllocateBuffer(bs);
+    }
+    segments.push_back(seg);
+
+    if (!seg->conv.Setup(bs, seg->filter->GetPartitions()) || !seg->conv.SetFilter(seg->filter))
+    {
+      DeleteSegments();
+      return false;
+    }
+  }
+
+  blocksize = _blocksize;
+  input.resize(blocksize);
+  output.resize(blocksize);
+
+  Reset();
+
+  // only start threads if there are segments for them to compute
+  for (i = j = 0; i < segments.size(); i++)
+  {
+    if ((segments[i]->threaded = (nthreads && (segments[i]->blocksize >= MinThreadedBlockSize)))) j++;
+  }
+  if (j)
+  {
+    for (i = 0; i < nthreads; i++) threads.push_back(new std::thread(&NonUniformConvolver::WorkerThread, this));
+  }
+
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Clear all input and output (waits for worker threads to complete outstanding blocks)
+ */
+/*--------------------------------------------------------------------------------*/
+void NonUniformConvolver::Reset()
+{
+  std::unique_lock<std::mutex> lock(tlock);
+  uint_t i, j;
+
+  for (i = 0; i < segments.size(); i++)
+  {
+    SEGMENT& seg = *segments[i];
+
+    for (j = 0; j < JobSlots; j++)
+    {
+      while ((seg.jobs[j].state == Job_Pending) || (seg.jobs[j].state == Job_Running)) donecond.wait(lock);
+      seg.jobs[j].state = Job_Free;
+    }
+
+    seg.conv.Reset();
+    seg.stagepos = 0;
+    seg.nextjob  = 0;
+  }
+
+  head.Reset();
+  t      = 0;
+  misses = 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Pass a complete block of a segment to the worker threads (or compute it)
+ */
+/*--------------------------------------------------------------------------------*/
+void NonUniformConvolver::ReleaseJob(SEGMENT& seg, uint64_t tnow)
+{
+  // job index from start of processing
+  const uint64_t index = (tnow / seg.blocksize) - 1;
+  JOB& job = seg.jobs[index % JobSlots];
+
+  memcpy(job.input, seg.stage, seg.blocksize * sizeof(*job.input));
+  job.deadline = tnow + seg.delay;
+
+  if (seg.threaded)
+  {
+    {
+      std::lock_guard<std::mutex> lock(tlock);
+      job.state = Job_Pending;
+    }
+    jobcond.notify_one();
+  }
+  else
+  {
+    seg.conv.ProcessBlock(job.input, job.output);
+    seg.nextjob++;
+    job.state = Job_Done;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Worker thread
+ */
+/*--------------------------------------------------------------------------------*/
+void NonUniformConvolver::Worker()
+{
+  std::unique_lock<std::mutex> lock(tlock);
+
+  while (!quit)
+  {
+    SEGMENT *best = NULL;
+    JOB     *job  = NULL;
+    uint_t  i;
+
+    // find pending job with earliest deadline (jobs of each segment must be computed in order)
+    for (i = 0; i < segments.size(); i++)
+    {
+      SEGMENT& seg = *segments[i];
+
+      if (!seg.threaded || seg.running) continue;
+
+      JOB& j = seg.jobs[seg.nextjob % JobSlots];
+      if ((j.state == Job_Pending) && (!job || (j.deadline < job->deadline)))
+      {
+        best = &seg;
+        job  = &j;
+      }
+    }
+
+    if (best)
+    {
+      best->running = true;
+      job->state    = Job_Running;
+      lock.unlock();
+
+      best->conv.ProcessBlock(job->input, job->output);
+
+      lock.lock();
+      job->state    = Job_Done;
+      best->running = false;
+      best->nextjob++;
+      donecond.notify_all();
+    }
+    else jobcond.wait(lock);
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process audio
+ *
+ * @param src source buffer
+ * @param dst destination buffer
+ * @param srcchannel source channel to convolve
+ * @param nsrcchannels total number of source channels
+ * @param dstchannel destination channel to write to
+ * @param ndstchannels total number of destination channels
+ * @param nframes number of sample frames to process
+ */
+/*--------------------------------------------------------------------------------*/
+void NonUniformConvolver::Process(const Sample_t *src, Sample_t *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes)
+{
+  const bool validsrc = (srcchannel < nsrcchannels);
+  const bool validdst = (dstchannel < ndstchannels);
+  uint_t i, j, n;
+
+  if (!blocksize) return;
+
+  src += srcchannel;
+  dst += dstchannel;
+  while (nframes)
+  {
+    // process no more than to the end of the current base block so that segment blocks are never split
+    n = std::min(nframes, blocksize - (uint_t)(t % blocksize));
+
+    for (i = 0; i < n; i++) input[i] = validsrc ? src[i * nsrcchannels] : 0;
+
+    head.Process(&input[0], &output[0], 0, 1, 0, 1, n);
+
+    for (i = 0; i < segments.size(); i++)
+    {
+      SEGMENT& seg = *segments[i];
+      const uint64_t start = (uint64_t)seg.blocksize + seg.delay;
+
+      // add output of block computed earlier
+      if (t >= start)
+      {
+        const uint64_t index = (t - start) / seg.blocksize;
+        const uint_t   pos   = (uint_t)((t - start) % seg.blocksize);
+        JOB& job = seg.jobs[index % JobSlots];
+
+        if (!pos && (job.state != Job_Done))
+        {
+          std::unique_lock<std::mutex> lock(tlock);
+
+          misses++;
+          while (job.state != Job_Done) donecond.wait(lock);
+        }
+
+        for (j = 0; j < n; j++) output[j] += (Sample_t)job.output[pos + j];
+
+        if ((pos + n) == seg.blocksize) job.state = Job_Free;
+      }
+
+      // collect input for next block
+      for (j = 0; j < n; j++) seg.stage[seg.stagepos + j] = (float)input[j];
+      if ((seg.stagepos += n) == seg.blocksize)
+      {
+        ReleaseJob(seg, t + n);
+        seg.stagepos = 0;
+      }
+    }
+
+    if (validdst)
+    {
+      for (i = 0; i < n; i++) dst[i * ndstchannels] = output[i];
+    }
+
+    src     += n * nsrcchannels;
+    dst     += n * ndstchannels;
+    t       += n;
+    nframes -= n;
+  }
+}
+
+BBC_AUDIOTOOLBOX_END
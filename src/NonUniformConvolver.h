@@ -0,0 +1,175 @@
+#ifndef __NON_UNIFORM_CONVOLVER__
+#define __NON_UNIFORM_CONVOLVER__
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "BlockConvolver.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Single-channel low-latency convolver using non-uniform partitioning
+ *
+ * The impulse response is split into segments, each convolved by a BlockConvolver with its own block
+ * size: the head (the first three blocks of the IR) uses the base block size and is processed
+ * synchronously, later segments use progressively larger blocks (2, 4, 8... base blocks, two partitions
+ * each, up to a maximum block size which is used for the rest of the IR)
+ *
+ * Each tail segment with block size B starts at offset 2B - N (N being the base block size) in the IR,
+ * so that its output is not needed until B samples after a block of input is complete; tail blocks are
+ * therefore computed by worker threads, the pending block with the earliest deadline always being
+ * computed first (earliest deadline first scheduling)
+ *
+ * Segments with blocks shorter than MinThreadedBlockSize are cheap enough to be computed synchronously
+ * and have deadlines too short to rely on worker threads being woken in time, so they are computed by
+ * the audio thread
+ *
+ * If a block's output is needed before it has been computed (a deadline miss) the audio thread waits
+ * for it (so that output is always correct) and the miss is counted (see GetDeadlineMisses())
+ *
+ * The latency is the base block size
+ */
+/*--------------------------------------------------------------------------------*/
+class NonUniformConvolver
+{
+public:
+  NonUniformConvolver();
+  ~NonUniformConvolver();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set up convolver
+   *
+   * @param _blocksize base block size (a power of 2, this is the latency)
+   * @param ir impulse response
+   * @param irlength length of impulse response in samples
+   * @param nthreads number of worker threads (0 to compute tail segments synchronously)
+   * @param maxblocksize maximum block size (rounded up to a power of 2 >= _blocksize)
+   *
+   * @return true if set up successfully
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool Setup(uint_t _blocksize, const float *ir, uint_t irlength, uint_t nthreads = 1, uint_t maxblocksize = 8192);
+
+  uint_t GetBlockSize() const {return blocksize;}
+  uint_t GetLatency()   const {return blocksize;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of segments (including the head)
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetSegments() const {return blocksize ? (uint_t)segments.size() + 1 : 0;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of tail blocks whose output was needed before they had been computed
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetDeadlineMisses() const {return misses;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Clear all input and output (waits for worker threads to complete outstanding blocks)
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Process audio
+   *
+   * @param src source buffer
+   * @param dst destination buffer
+   * @param srcchannel source channel to convolve
+   * @param nsrcchannels total number of source channels
+   * @param dstchannel destination channel to write to
+   * @param ndstchannels total number of destination channels
+   * @param nframes number of sample frames to process
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Process(const Sample_t *src, Sample_t *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes);
+
+protected:
+  enum
+  {
+    JobSlots             = 4,
+    MinThreadedBlockSize = 256,
+  };
+
+  typedef enum
+  {
+    Job_Free = 0,
+    Job_Pending,
+    Job_Running,
+    Job_Done,
+  } JobState_t;
+
+  // a block of a tail segment
+  class JOB
+  {
+  public:
+    JOB() : input(NULL), output(NULL), deadline(0) {state = Job_Free;}
+
+    float            *input;
+    float            *output;
+    uint64_t         deadline;    // time (in samples) at which output is needed
+    std::atomic<int> state;
+  };
+
+  class SEGMENT
+  {
+  public:
+    SEGMENT() : filter(NULL), blocksize(0), delay(0), threaded(false), stage(NULL), stagepos(0), running(false), nextjob(0) {}
+
+    BlockConvolver         conv;
+    BlockConvolver::Filter *filter;
+    uint_t                 blocksize;
+    uint_t                 delay;     // delay of segment output beyond that of the convolver
+    bool                   threaded;  // true if blocks are computed by worker threads
+    float                  *stage;    // input being collected for next block
+    uint_t                 stagepos;
+    JOB                    jobs[JobSlots];
+    bool                   running;   // true whilst a worker is computing a block (protected by tlock)
+    uint64_t               nextjob;   // index of next block to be computed (protected by tlock)
+  };
+
+  /*--------------------------------------------------------------------------------*/
+  /** Pass a complete block of a segment to the worker threads (or compute it)
+   */
+  /*--------------------------------------------------------------------------------*/
+  void ReleaseJob(SEGMENT& seg, uint64_t t);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Worker thread
+   */
+  /*--------------------------------------------------------------------------------*/
+  static void WorkerThread(NonUniformConvolver *convolver) {convolver->Worker();}
+  void Worker();
+
+  void StopThreads();
+  void DeleteSegments();
+
+protected:
+  uint_t                         blocksize;
+  BlockConvolver                 head;
+  BlockConvolver::Filter         *headfilter;
+  std::vector<SEGMENT *>         segments;
+  std::vector<std::thread *>     threads;
+  std::vector<Sample_t>          input;
+  std::vector<Sample_t>          output;
+  uint64_t                       t;           // number of frames processed
+  std::atomic<uint_t>            misses;
+  std::mutex                     tlock;
+  std::condition_variable        jobcond;     // signalled when a job is pending
+  std::condition_variable        donecond;    // signalled when a job is done
+  bool                           quit;
+
+private:
+  // copying is not supported
+  NonUniformConvolver(const NonUniformConvolver&);
+  NonUniformConvolver& operator = (const NonUniformConvolver&);
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
@@ -0,0 +1,664 @@
+
+#include <math.h>
+
+#ifdef __AVX__
+#  include <immintrin.h>
+#elif defined(__SSE3__)
+#  include <pmmintrin.h>
+#endif
+
+#define BBCDEBUG_LEVEL 1
+#include "Oversampler.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Sum symmetric pairs of frames multiplied by coeffs for nchannels contiguous channels
+ *
+ * dst[j] = sum over k of coeffs[k] * (w[lo - k * step][j] + w[hi + k * step][j])
+ *
+ * where w[i][j] is channel j of frame i
+ */
+/*--------------------------------------------------------------------------------*/
+static void HalfBandSum(const float *w, uint_t nchannels, uint_t lo, uint_t hi, uint_t step, const float *coeffs, uint_t ncoeffs, float *dst)
+{
+  const uint_t inc = step * nchannels;
+  uint_t j = 0, k;
+
+#if defined(__AVX__)
+  for (; (j + 8) <= nchannels; j += 8)
+  {
+    const float *p1 = w + lo * nchannels + j, *p2 = w + hi * nchannels + j;
+    __m256 acc = _mm256_setzero_ps();
+    for (k = 0; k < ncoeffs; k++, p1 -= inc, p2 += inc)
+    {
+      acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(coeffs[k]), _mm256_add_ps(_mm256_loadu_ps(p1), _mm256_loadu_ps(p2))));
+    }
+    _mm256_storeu_ps(dst + j, acc);
+  }
+#endif
+#if defined(__SSE3__)
+  for (; (j + 4) <= nchannels; j += 4)
+  {
+    const float *p1 = w + lo * nchannels + j, *p2 = w + hi * nchannels + j;
+    __m128 acc = _mm_setzero_ps();
+    for (k = 0; k < ncoeffs; k++, p1 -= inc, p2 += inc)
+    {
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(coeffs[k]), _mm_add_ps(_mm_loadu_ps(p1), _mm_loadu_ps(p2))));
+    }
+    _mm_storeu_ps(dst + j, acc);
+  }
+#endif
+  for (; j < nchannels; j++)
+  {
+    const float *p1 = w + lo * nchannels + j, *p2 = w + hi * nchannels + j;
+    float acc = 0.f;
+    for (k = 0; k < ncoeffs; k++, p1 -= inc, p2 += inc) acc += coeffs[k] * (p1[0] + p2[0]);
+    dst[j] = acc;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Modified Bessel function of the first kind (order 0)
+ */
+/*--------------------------------------------------------------------------------*/
+static double BesselI0(double x)
+{
+  double sum = 1.0, term = 1.0;
+  uint_t k;
+
+  for (k = 1; k < 100; k++)
+  {
+    term *= (x * x) / (4.0 * (double)k * (double)k);
+    sum  += term;
+    if (term < (1.0e-15 * sum)) break;
+  }
+
+  return sum;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+HalfBandFIR::HalfBandFIR(bool _decimator, uint_t _nchannels, uint_t _ncoeffs, double attenuation) : decimator(_decimator),
+                                                                                                   length(0),
+                                                                                                   pos(0),
+                                                                                                   phase(0)
+{
+  nchannels = _nchannels;
+  SetCoeffs(_ncoeffs, attenuation);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Design coeffs
+ *
+ * @param n number of unique non-zero coeffs (excluding centre tap)
+ * @param attenuation stopband attenuation in dB (sets Kaiser window parameter)
+ *
+ * @note can be called at any time but will reset the filter
+ */
+/*--------------------------------------------------------------------------------*/
+void HalfBandFIR::SetCoeffs(uint_t n, double attenuation)
+{
+  // Kaiser's empirical formula for window parameter
+  const double beta = ((attenuation > 50.0) ? .1102 * (attenuation - 8.7) :
+                       (attenuation > 21.0) ? .5842 * pow(attenuation - 21.0, .4) + .07886 * (attenuation - 21.0) : 0.0);
+  double sum = 0.0;
+  uint_t k;
+
+  n = std::max(n, 1u);
+  coeffs.resize(n);
+  gains.resize(n);
+
+  // non-zero taps are an odd number of samples (2k + 1) from the centre, the filter is 4n - 1 taps long
+  for (k = 0; k < n; k++)
+  {
+    const double d = (double)(2 * k + 1);
+    const double x = .5 * M_PI * d;
+    const double r = d / (double)(2 * n);
+
+    coeffs[k] = (float)(.5 * sin(x) / x * BesselI0(beta * sqrt(1.0 - r * r)) / BesselI0(beta));
+    sum      += coeffs[k];
+  }
+
+  // normalise for unity DC gain (.5 + 2 * sum = 1)
+  for (k = 0; k < n; k++)
+  {
+    coeffs[k] = (float)((double)coeffs[k] * .25 / sum);
+    // interpolator has gain of 2 to compensate for zero stuffing
+    gains[k]  = decimator ? coeffs[k] : 2.f * coeffs[k];
+  }
+
+  // decimator needs the whole filter length, interpolator only needs the non-zero input samples
+  length = decimator ? 4 * n - 1 : 2 * n;
+
+  SetChannels(nchannels);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set number of channels
+ *
+ * @note can be called at any time but will reset the filter
+ */
+/*--------------------------------------------------------------------------------*/
+void HalfBandFIR::SetChannels(uint_t n)
+{
+  nchannels = n;
+  // history is mirrored so that the last length frames are always contiguous
+  history.resize(2 * length * nchannels);
+  output.resize(nchannels);
+  Reset();
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Reset filter state
+ */
+/*--------------------------------------------------------------------------------*/
+void HalfBandFIR::Reset()
+{
+  std::fill(history.begin(), history.end(), 0.f);
+  pos   = 0;
+  phase = 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process audio
+ *
+ * @note see HalfBandResampler::Process()
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t HalfBandFIR::Process(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes)
+{
+  const uint_t n      = (uint_t)coeffs.size();
+  uint_t       nchans = nchannels;
+  uint_t       i, j, nout = 0;
+
+  // calculate number of channels that can be processed
+  nchans = std::min(nchans, limited::subz(nsrcchannels, srcchannel));
+  nchans = std::min(nchans, limited::subz(ndstchannels, dstchannel));
+
+  // offset buffer pointers by starting channels
+  src += srcchannel;
+  dst += dstchannel;
+
+  for (i = 0; i < nframes; i++, src += nsrcchannels)
+  {
+    float *p1 = &history[pos * nchannels], *p2 = p1 + length * nchannels;
+    const float *w;
+
+    // write frame into both halves of history
+    for (j = 0; j < nchans; j++) p1[j] = p2[j] = src[j];
+    pos = (pos + 1) % length;
+
+    // window of the last length frames, oldest first
+    w = &history[pos * nchannels];
+
+    if (decimator)
+    {
+      // generate output for every even numbered input frame
+      if ((phase ^= 1) != 0)
+      {
+        const uint_t c = 2 * n - 1;     // centre tap
+
+        HalfBandSum(w, nchannels, c - 1, c + 1, 2, &gains[0], n, &output[0]);
+        for (j = 0; j < nchans; j++) dst[j] = output[j] + .5f * w[c * nchannels + j];
+        dst += ndstchannels;
+        nout++;
+      }
+    }
+    else
+    {
+      // first output is the interpolated sample, the second is the (delayed) input sample (centre tap)
+      HalfBandSum(w, nchannels, n - 1, n, 1, &gains[0], n, &output[0]);
+      for (j = 0; j < nchans; j++) dst[j] = output[j];
+      dst += ndstchannels;
+      for (j = 0; j < nchans; j++) dst[j] = w[n * nchannels + j];
+      dst += ndstchannels;
+      nout += 2;
+    }
+  }
+
+  return nout;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+HalfBandIIR::HalfBandIIR(bool _decimator, uint_t _nchannels, uint_t ncoeffs, double transition) : decimator(_decimator),
+                                                                                                  phase(0)
+{
+  nchannels = _nchannels;
+  SetCoeffs(ncoeffs, transition);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Design coeffs
+ *
+ * @param ncoeffs total number of all-pass coeffs (across both paths)
+ * @param transition transition bandwidth relative to the higher sample rate (0 < transition < .5)
+ *
+ * @note can be called at any time but will reset the filter
+ *
+ * @note the design uses the elliptic half-band formulae of Valenzuela and Constantinides
+ * @note ("Digital signal processing schemes for efficient interpolation and decimation", 1983)
+ */
+/*--------------------------------------------------------------------------------*/
+void HalfBandIIR::SetCoeffs(uint_t ncoeffs, double transition)
+{
+  const uint_t order = 2 * std::max(ncoeffs, 1u) + 1;
+  double k, q, e, e2, e4, kk;
+  uint_t i;
+
+  transition = limited::limit(transition, 1.0e-6, .5 - 1.0e-6);
+
+  // elliptic modulus and nome from the transition bandwidth
+  k  = tan((1.0 - 2.0 * transition) * M_PI / 4.0);
+  k *= k;
+  kk = pow(1.0 - k * k, .25);
+  e  = .5 * (1.0 - kk) / (1.0 + kk);
+  e2 = e * e;
+  e4 = e2 * e2;
+  q  = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+
+  paths[0].coeffs.clear();
+  paths[1].coeffs.clear();
+
+  for (i = 0; i < (order / 2); i++)
+  {
+    const double c = (double)(i + 1);
+    double num = 0.0, den = 0.0, term, ww, x;
+    uint_t m;
+
+    // numerator and denominator series (Jacobi theta functions)
+    for (m = 0; m < 100; m++)
+    {
+      term = pow(q, (double)(m * (m + 1))) * sin((double)(2 * m + 1) * c * M_PI / (double)order);
+      num += (m & 1) ? -term : term;
+      if (fabs(term) < 1.0e-100) break;
+    }
+    for (m = 1; m < 100; m++)
+    {
+      term = pow(q, (double)(m * m)) * cos(2.0 * (double)m * c * M_PI / (double)order);
+      den += (m & 1) ? -term : term;
+      if (fabs(term) < 1.0e-100) break;
+    }
+
+    ww = num * pow(q, .25) / (den + .5);
+    ww = ww * ww;
+    x  = sqrt((1.0 - ww * k) * (1.0 - ww / k)) / (1.0 + ww);
+
+    // coeffs alternate between paths
+    paths[i & 1].coeffs.push_back((float)((1.0 - x) / (1.0 + x)));
+  }
+
+  SetChannels(nchannels);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set number of channels
+ *
+ * @note can be called at any time but will reset the filter
+ */
+/*--------------------------------------------------------------------------------*/
+void HalfBandIIR::SetChannels(uint_t n)
+{
+  uint_t i;
+
+  nchannels = n;
+  for (i = 0; i < NUMBEROF(paths); i++)
+  {
+    paths[i].state.resize((paths[i].coeffs.size() + 1) * nchannels);
+    paths[i].data.resize(nchannels);
+  }
+  Reset();
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Reset filter state
+ */
+/*--------------------------------------------------------------------------------*/
+void HalfBandIIR::Reset()
+{
+  uint_t i;
+
+  for (i = 0; i < NUMBEROF(paths); i++)
+  {
+    std::fill(paths[i].state.begin(), paths[i].state.end(), 0.f);
+    std::fill(paths[i].data.begin(),  paths[i].data.end(),  0.f);
+  }
+  phase = 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return latency in frames at the *lower* sample rate (group delay at DC)
+ */
+/*--------------------------------------------------------------------------------*/
+double HalfBandIIR::GetLatency() const
+{
+  // group delay of (a + z^-1) / (1 + a.z^-1) at DC is (1 - a) / (1 + a)
+  double delay = 1.0;       // delay of second path in samples at the higher rate
+  uint_t i, j;
+
+  for (i = 0; i < NUMBEROF(paths); i++)
+  {
+    for (j = 0; j < paths[i].coeffs.size(); j++)
+    {
+      const double a = paths[i].coeffs[j];
+      delay += 2.0 * (1.0 - a) / (1.0 + a);
+    }
+  }
+
+  // average of the two paths, converted to the lower rate
+  return .25 * delay;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process the samples in path.data through the path
+ */
+/*--------------------------------------------------------------------------------*/
+void HalfBandIIR::ProcessPath(PATH& path)
+{
+  const uint_t n = (uint_t)path.coeffs.size();
+  float        *x = &path.data[0];
+  uint_t       i, j = 0;
+
+  /*
+   * Each section implements y[n] = a.x[n] + x[n - 1] - a.y[n - 1] (see AllPassFilter)
+   *
+   * state row i is the previous input of section i which is also the previous output of section i - 1,
+   * the final row is the previous output of the last section
+   */
+#if defined(__AVX__)
+  for (; (j + 8) <= nchannels; j += 8)
+  {
+    float  *s  = &path.state[j];
+    __m256 in = _mm256_loadu_ps(x + j);
+    for (i = 0; i < n; i++, s += nchannels)
+    {
+      __m256 out = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(path.coeffs[i]), _mm256_sub_ps(in, _mm256_loadu_ps(s + nchannels))), _mm256_loadu_ps(s));
+      _mm256_storeu_ps(s, in);
+      in = out;
+    }
+    _mm256_storeu_ps(s, in);
+    _mm256_storeu_ps(x + j, in);
+  }
+#endif
+#if defined(__SSE3__)
+  for (; (j + 4) <= nchannels; j += 4)
+  {
+    float  *s  = &path.state[j];
+    __m128 in = _mm_loadu_ps(x + j);
+    for (i = 0; i < n; i++, s += nchannels)
+    {
+      __m128 out = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(path.coeffs[i]), _mm_sub_ps(in, _mm_loadu_ps(s + nchannels))), _mm_loadu_ps(s));
+      _mm_storeu_ps(s, in);
+      in = out;
+    }
+    _mm_storeu_ps(s, in);
+    _mm_storeu_ps(x + j, in);
+  }
+#endif
+  for (; j < nchannels; j++)
+  {
+    float *s  = &path.state[j];
+    float in = x[j];
+    for (i = 0; i < n; i++, s += nchannels)
+    {
+      float out = path.coeffs[i] * (in - s[nchannels]) + s[0];
+      s[0] = in;
+      in   = out;
+    }
+    s[0] = in;
+    x[j] = in;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Process audio
+ *
+ * @note see HalfBandResampler::Process()
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t HalfBandIIR::Process(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes)
+{
+  float    *x0 = &paths[0].data[0], *x1 = &paths[1].data[0];
+  uint_t   nchans = nchannels;
+  uint_t   i, j, nout = 0;
+
+  // calculate number of channels that can be processed
+  nchans = std::min(nchans, limited::subz(nsrcchannels, srcchannel));
+  nchans = std::min(nchans, limited::subz(ndstchannels, dstchannel));
+
+  // offset buffer pointers by starting channels
+  src += srcchannel;
+  dst += dstchannel;
+
+  for (i = 0; i < nframes; i++, src += nsrcchannels)
+  {
+    if (decimator)
+    {
+      // even numbered input frames go through the first path and generate output,
+      // odd numbered frames are held for the second (delayed) path
+      if ((phase ^= 1) != 0)
+      {
+        for (j = 0; j < nchans; j++) x0[j] = src[j];
+
+        ProcessPath(paths[0]);
+        ProcessPath(paths[1]);
+
+        for (j = 0; j < nchans; j++) dst[j] = .5f * (x0[j] + x1[j]);
+        dst += ndstchannels;
+        nout++;
+      }
+      else
+      {
+        for (j = 0; j < nchans; j++) x1[j] = src[j];
+      }
+    }
+    else
+    {
+      for (j = 0; j < nchans; j++) x0[j] = x1[j] = src[j];
+
+      ProcessPath(paths[0]);
+      ProcessPath(paths[1]);
+
+      for (j = 0; j < nchans; j++) dst[j] = x0[j];
+      dst += ndstchannels;
+      for (j = 0; j < nchans; j++) dst[j] = x1[j];
+      dst += ndstchannels;
+      nout += 2;
+    }
+  }
+
+  return nout;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+Oversampler::Oversampler(uint_t _nchannels, uint_t _factor, Type_t _type, uint_t _maxframes) : nchannels(0),
+                                                                                               factor(1),
+                                                                                               maxframes(0)
+{
+  if (_nchannels) Setup(_nchannels, _factor, _type, _maxframes);
+}
+
+Oversampler::~Oversampler()
+{
+  Clear();
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Delete all stages
+ */
+/*--------------------------------------------------------------------------------*/
+void Oversampler::Clear()
+{
+  uint_t i;
+
+  for (i = 0; i < upstages.size(); i++)   delete upstages[i];
+  for (i = 0; i < downstages.size(); i++) delete downstages[i];
+  upstages.clear();
+  downstages.clear();
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set up oversampler
+ *
+ * @param _nchannels number of channels
+ * @param _factor oversampling factor (2, 4 or 8)
+ * @param _type type of stages
+ * @param _maxframes maximum number of base rate frames per call
+ *
+ * @return true if set up successfully
+ */
+/*--------------------------------------------------------------------------------*/
+bool Oversampler::Setup(uint_t _nchannels, uint_t _factor, Type_t _type, uint_t _maxframes)
+{
+  // per-stage filters: the first stage has the narrowest transition band (around half the base rate),
+  // later stages only need to reject images of the (relatively narrower) signal band
+  static const uint_t firncoeffs[]    = {16, 6, 4};
+  static const uint_t iirncoeffs[]    = {10, 4, 3};
+  static const double iirtransition[] = {.025, .2, .3};
+  uint_t i, nstages;
+
+  Clear();
+
+  switch (_factor)
+  {
+    case 2: nstages = 1; break;
+    case 4: nstages = 2; break;
+    case 8: nstages = 3; break;
+
+    default:
+      BBCERROR("Invalid oversampling factor %u (must be 2, 4 or 8)", _factor);
+      return false;
+  }
+
+  nchannels = _nchannels;
+  factor    = _factor;
+  maxframes = std::max(_maxframes, 1u);
+
+  for (i = 0; i < nstages; i++)
+  {
+    if (_type == Type_IIR)
+    {
+      upstages.push_back(new HalfBandIIR(false, nchannels, iirncoeffs[i], iirtransition[i]));
+      downstages.push_back(new HalfBandIIR(true, nchannels, iirncoeffs[i], iirtransition[i]));
+    }
+    else
+    {
+      upstages.push_back(new HalfBandFIR(false, nchannels, firncoeffs[i]));
+      downstages.push_back(new HalfBandFIR(true, nchannels, firncoeffs[i]));
+    }
+  }
+
+  // intermediate buffers (the final stage always reads from or writes to the caller's buffer)
+  for (i = 0; i < NUMBEROF(buffers); i++) buffers[i].resize(maxframes * (factor / 2) * nchannels);
+
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Reset all stages
+ */
+/*--------------------------------------------------------------------------------*/
+void Oversampler::Reset()
+{
+  uint_t i;
+
+  for (i = 0; i < upstages.size(); i++)   upstages[i]->Reset();
+  for (i = 0; i < downstages.size(); i++) downstages[i]->Reset();
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return latency of Upsample() followed by Downsample() in base rate frames
+ */
+/*--------------------------------------------------------------------------------*/
+double Oversampler::GetLatency() const
+{
+  double latency = 0.0, scale = 1.0;
+  uint_t i;
+
+  // stage i runs at 2^i times the base rate (lower side)
+  for (i = 0; i < upstages.size(); i++, scale *= .5)
+  {
+    latency += scale * (upstages[i]->GetLatency() + downstages[i]->GetLatency());
+  }
+
+  return latency;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Upsample audio
+ *
+ * @param src source buffer (base rate)
+ * @param dst destination buffer (oversampled rate, nframes * GetFactor() frames)
+ * @param srcchannel source starting channel
+ * @param nsrcchannels total number of source channels
+ * @param dstchannel destination starting channel
+ * @param ndstchannels total number of destination channels
+ * @param nframes number of base rate frames (<= GetMaxFrames())
+ *
+ * @return number of oversampled frames generated
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t Oversampler::Upsample(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes)
+{
+  const uint_t nstages = (uint_t)upstages.size();
+  uint_t i;
+
+  nframes = std::min(nframes, maxframes);
+
+  for (i = 0; i < nstages; i++)
+  {
+    const bool last = ((i + 1) == nstages);
+    float      *out = last ? dst : &buffers[i & 1][0];
+
+    nframes = upstages[i]->Process(src, out, srcchannel, nsrcchannels, last ? dstchannel : 0, last ? ndstchannels : nchannels, nframes);
+
+    // next stage reads from this stage's output
+    src          = out;
+    srcchannel   = 0;
+    nsrcchannels = nchannels;
+  }
+
+  return nframes;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Downsample audio
+ *
+ * @param src source buffer (oversampled rate)
+ * @param dst destination buffer (base rate)
+ * @param srcchannel source starting channel
+ * @param nsrcchannels total number of source channels
+ * @param dstchannel destination starting channel
+ * @param ndstchannels total number of destination channels
+ * @param nframes number of *base rate* frames to generate (<= GetMaxFrames())
+ *
+ * @return number of base rate frames generated
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t Oversampler::Downsample(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes)
+{
+  const uint_t nstages = (uint_t)downstages.size();
+  uint_t i;
+
+  nframes = std::min(nframes, maxframes) * factor;
+
+  // highest rate stage first
+  for (i = nstages; i > 0; i--)
+  {
+    const bool last = (i == 1);
+    float      *out = last ? dst : &buffers[i & 1][0];
+
+    nframes = downstages[i - 1]->Process(src, out, srcchannel, nsrcchannels, last ? dstchannel : 0, last ? ndstchannels : nchannels, nframes);
+
+    // next stage reads from this stage's output
+    src          = out;
+    srcchannel   = 0;
+    nsrcchannels = nchannels;
+  }
+
+  return nframes;
+}
+
+BBC_AUDIOTOOLBOX_END
@@ -0,0 +1,322 @@
+#ifndef __OVERSAMPLER__
+#define __OVERSAMPLER__
+
+#include <vector>
+
+#include <bbcat-base/misc.h>
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Base class for 2x half-band decimators and interpolators
+ *
+ * All classes process nchannels of float samples with the same buffer conventions as AllPassFilter,
+ * channels are processed together (SIMD across channels)
+ */
+/*--------------------------------------------------------------------------------*/
+class HalfBandResampler
+{
+public:
+  HalfBandResampler() : nchannels(0) {}
+  virtual ~HalfBandResampler() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set number of channels
+   *
+   * @note can be called at any time but will reset the filter
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual void SetChannels(uint_t n) = 0;
+  uint_t GetChannels() const {return nchannels;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Reset filter state
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual void Reset() = 0;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return true if this is a decimator (2 frames in, 1 frame out)
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual bool IsDecimator() const = 0;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return latency in frames at the *lower* sample rate
+   *
+   * @note for IIR filters this is the group delay at DC
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual double GetLatency() const = 0;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Process audio
+   *
+   * @param src source buffer
+   * @param dst destination buffer
+   * @param srcchannel source starting channel
+   * @param nsrcchannels total number of source channels
+   * @param dstchannel destination starting channel
+   * @param ndstchannels total number of destination channels
+   * @param nframes number of *source* frames to process
+   *
+   * @return number of destination frames generated (nframes / 2 or nframes * 2)
+   *
+   * @note decimators can be passed an odd number of frames, the phase is maintained between calls
+   * @note src and dst MUST NOT overlap
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual uint_t Process(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes) = 0;
+
+protected:
+  uint_t nchannels;
+};
+
+/*--------------------------------------------------------------------------------*/
+/** Half-band FIR decimator/interpolator
+ *
+ * The filter is a Kaiser windowed sinc with a cutoff of a quarter of the higher sample rate
+ * and (4 * ncoeffs - 1) taps, of which every second tap (apart from the centre tap of 0.5) is zero
+ *
+ * Only the ncoeffs unique non-zero coeffs are stored and, by symmetry, each is applied to the sum
+ * of two samples so each output frame costs (ncoeffs + 1) multiplies per channel (decimator) or
+ * ncoeffs multiplies per pair of output frames (interpolator)
+ *
+ * Latency is (2 * ncoeffs - 1) / 2 frames at the lower sample rate
+ */
+/*--------------------------------------------------------------------------------*/
+class HalfBandFIR : public HalfBandResampler
+{
+public:
+  /*--------------------------------------------------------------------------------*/
+  /** Constructor
+   *
+   * @param _decimator true for a decimator, false for an interpolator
+   * @param _nchannels number of channels
+   * @param _ncoeffs number of unique non-zero coeffs (excluding centre tap)
+   * @param attenuation stopband attenuation in dB (sets Kaiser window parameter)
+   */
+  /*--------------------------------------------------------------------------------*/
+  HalfBandFIR(bool _decimator = true, uint_t _nchannels = 0, uint_t _ncoeffs = 16, double attenuation = 100.0);
+  virtual ~HalfBandFIR() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Design coeffs
+   *
+   * @param n number of unique non-zero coeffs (excluding centre tap)
+   * @param attenuation stopband attenuation in dB (sets Kaiser window parameter)
+   *
+   * @note can be called at any time but will reset the filter
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetCoeffs(uint_t n, double attenuation = 100.0);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return unique coeffs (coeff k is applied to the samples (2k + 1) away from the centre)
+   */
+  /*--------------------------------------------------------------------------------*/
+  const std::vector<float>& GetCoeffs() const {return coeffs;}
+
+  virtual void   SetChannels(uint_t n);
+  virtual void   Reset();
+  virtual bool   IsDecimator() const {return decimator;}
+  virtual double GetLatency()  const {return .5 * (double)(2 * coeffs.size() - 1);}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Process audio
+   *
+   * @note see HalfBandResampler::Process()
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual uint_t Process(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes);
+
+protected:
+  bool               decimator;
+  std::vector<float> coeffs;            // unique coeffs
+  std::vector<float> gains;             // coeffs scaled for use (x2 for interpolator)
+  std::vector<float> history;           // mirrored history of frames (2 * length frames)
+  std::vector<float> output;            // scratch output frame(s)
+  uint_t             length;            // length of history in frames
+  uint_t             pos;               // position in history
+  uint_t             phase;             // decimator phase (0 or 1)
+};
+
+/*--------------------------------------------------------------------------------*/
+/** Polyphase IIR half-band decimator/interpolator
+ *
+ * The filter is the sum of two paths of cascaded first order all-pass sections (see AllPassFilter):
+ *
+ *   H(z) = .5 * (A0(z^2) + z^-1 . A1(z^2)), Ai(z) = product of (a + z^-1) / (1 + a.z^-1)
+ *
+ * with each path running at the *lower* sample rate, giving an elliptic-like half-band response
+ * with very low cost (ncoeffs multiplies per channel per frame at the lower rate) but non-linear phase
+ *
+ * Coeffs are designed for a given number of coeffs and transition bandwidth
+ */
+/*--------------------------------------------------------------------------------*/
+class HalfBandIIR : public HalfBandResampler
+{
+public:
+  /*--------------------------------------------------------------------------------*/
+  /** Constructor
+   *
+   * @param _decimator true for a decimator, false for an interpolator
+   * @param _nchannels number of channels
+   * @param ncoeffs total number of all-pass coeffs (across both paths)
+   * @param transition transition bandwidth relative to the higher sample rate (0 < transition < .5)
+   */
+  /*--------------------------------------------------------------------------------*/
+  HalfBandIIR(bool _decimator = true, uint_t _nchannels = 0, uint_t ncoeffs = 8, double transition = .04);
+  virtual ~HalfBandIIR() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Design coeffs
+   *
+   * @param ncoeffs total number of all-pass coeffs (across both paths)
+   * @param transition transition bandwidth relative to the higher sample rate (0 < transition < .5)
+   *
+   * @note can be called at any time but will reset the filter
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetCoeffs(uint_t ncoeffs, double transition);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return all-pass coeffs for a path
+   */
+  /*--------------------------------------------------------------------------------*/
+  const std::vector<float>& GetCoeffs(uint_t path) const {return paths[path & 1].coeffs;}
+
+  virtual void   SetChannels(uint_t n);
+  virtual void   Reset();
+  virtual bool   IsDecimator() const {return decimator;}
+  virtual double GetLatency()  const;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Process audio
+   *
+   * @note see HalfBandResampler::Process()
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual uint_t Process(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes);
+
+protected:
+  typedef struct
+  {
+    std::vector<float> coeffs;
+    std::vector<float> state;           // (coeffs + 1) x nchannels: previous input of each section then previous output
+    std::vector<float> data;            // nchannels samples being processed
+  } PATH;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Process the samples in path.data through the path
+   */
+  /*--------------------------------------------------------------------------------*/
+  void ProcessPath(PATH& path);
+
+protected:
+  bool   decimator;
+  PATH   paths[2];
+  uint_t phase;                         // decimator phase (0 or 1)
+};
+
+/*--------------------------------------------------------------------------------*/
+/** 2x/4x/8x oversampler made from cascaded half-band stages
+ *
+ * Upsample() converts nframes at the base rate to (nframes * factor) frames at the oversampled rate,
+ * Downsample() converts (nframes * factor) frames back to nframes at the base rate
+ *
+ * Later (higher rate) stages have wider transition bands and so use shorter filters
+ */
+/*--------------------------------------------------------------------------------*/
+class Oversampler
+{
+public:
+  typedef enum
+  {
+    Type_FIR = 0,               // linear phase half-band FIR stages
+    Type_IIR,                   // minimum cost polyphase all-pass IIR stages
+  } Type_t;
+
+  Oversampler(uint_t _nchannels = 0, uint_t _factor = 2, Type_t _type = Type_FIR, uint_t _maxframes = 1024);
+  ~Oversampler();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set up oversampler
+   *
+   * @param _nchannels number of channels
+   * @param _factor oversampling factor (2, 4 or 8)
+   * @param _type type of stages
+   * @param _maxframes maximum number of base rate frames per call
+   *
+   * @return true if set up successfully
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool Setup(uint_t _nchannels, uint_t _factor, Type_t _type = Type_FIR, uint_t _maxframes = 1024);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Reset all stages
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset();
+
+  uint_t GetChannels()  const {return nchannels;}
+  uint_t GetFactor()    const {return factor;}
+  uint_t GetMaxFrames() const {return maxframes;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return latency of Upsample() followed by Downsample() in base rate frames
+   */
+  /*--------------------------------------------------------------------------------*/
+  double GetLatency() const;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Upsample audio
+   *
+   * @param src source buffer (base rate)
+   * @param dst destination buffer (oversampled rate, nframes * GetFactor() frames)
+   * @param srcchannel source starting channel
+   * @param nsrcchannels total number of source channels
+   * @param dstchannel destination starting channel
+   * @param ndstchannels total number of destination channels
+   * @param nframes number of base rate frames (<= GetMaxFrames())
+   *
+   * @return number of oversampled frames generated
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t Upsample(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Downsample audio
+   *
+   * @param src source buffer (oversampled rate)
+   * @param dst destination buffer (base rate)
+   * @param srcchannel source starting channel
+   * @param nsrcchannels total number of source channels
+   * @param dstchannel destination starting channel
+   * @param ndstchannels total number of destination channels
+   * @param nframes number of *base rate* frames to generate (<= GetMaxFrames())
+   *
+   * @return number of base rate frames generated
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t Downsample(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes);
+
+protected:
+  /*--------------------------------------------------------------------------------*/
+  /** Delete all stages
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Clear();
+
+protected:
+  std::vector<HalfBandResampler *> upstages;      // stage 0 is the lowest rate
+  std::vector<HalfBandResampler *> downstages;    // stage 0 is the lowest rate
+  std::vector<float>               buffers[2];    // intermediate buffers
+  uint_t                           nchannels;
+  uint_t                           factor;
+  uint_t                           maxframes;
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
@@ -0,0 +1,238 @@
+
+#include <math.h>
+
+#include <map>
+#include <mutex>
+
+#define BBCDEBUG_LEVEL 1
+#include "PolyphaseFilter.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Cache of generated tables, keyed on parameters
+ */
+/*--------------------------------------------------------------------------------*/
+class PolyphaseFilterCache
+{
+public:
+  PolyphaseFilterCache() {}
+  ~PolyphaseFilterCache()
+  {
+    std::map<KEY,PolyphaseFilter *>::iterator it;
+    for (it = tables.begin(); it != tables.end(); ++it) delete it->second;
+  }
+
+  const PolyphaseFilter& Get(const PolyphaseFilter::PARAMETERS& params)
+  {
+    std::lock_guard<std::mutex> lock(tlock);
+    KEY key(params);
+    std::map<KEY,PolyphaseFilter *>::iterator it;
+
+    if ((it = tables.find(key)) == tables.end())
+    {
+      BBCDEBUG1(("Generating polyphase filter table (%u taps, %u phases, window %u, cutoff %0.4lf)", params.taps, params.phases, (uint_t)params.window, params.cutoff));
+      it = tables.insert(std::pair<KEY,PolyphaseFilter *>(key, new PolyphaseFilter(params))).first;
+    }
+
+    return *it->second;
+  }
+
+protected:
+  // parameters compared member by member
+  class KEY
+  {
+  public:
+    KEY(const PolyphaseFilter::PARAMETERS& _params) : params(_params) {}
+
+    bool operator < (const KEY& obj) const
+    {
+      const PolyphaseFilter::PARAMETERS& a = params;
+      const PolyphaseFilter::PARAMETERS& b = obj.params;
+      if (a.taps         != b.taps)         return (a.taps         < b.taps);
+      if (a.phases       != b.phases)       return (a.phases       < b.phases);
+      if (a.window       != b.window)       return (a.window       < b.window);
+      if (a.cutoff       != b.cutoff)       return (a.cutoff       < b.cutoff);
+      if (a.beta         != b.beta)         return (a.beta         < b.beta);
+      if (a.windowlength != b.windowlength) return (a.windowlength < b.windowlength);
+      if (a.offset       != b.offset)       return (a.offset       < b.offset);
+      return (a.normalise < b.normalise);
+    }
+
+    PolyphaseFilter::PARAMETERS params;
+  };
+
+  std::mutex                      tlock;
+  std::map<KEY,PolyphaseFilter *> tables;
+};
+
+/*--------------------------------------------------------------------------------*/
+/** Return default parameters for a Kaiser windowed sinc filter
+ */
+/*--------------------------------------------------------------------------------*/
+PolyphaseFilter::PARAMETERS PolyphaseFilter::GetDefaultParameters(uint_t taps, uint_t phases, double cutoff, double beta)
+{
+  PARAMETERS params;
+  params.taps         = taps;
+  params.phases       = phases;
+  params.window       = Window_Kaiser;
+  params.cutoff       = cutoff;
+  params.beta         = beta;
+  params.windowlength = 0.0;
+  params.offset       = 0.0;
+  params.normalise    = true;
+  return params;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return parameters that generate the original FractionalSample() table
+ *
+ * The original table was a Kaiser windowed sinc (100dB attenuation -> beta = 10.056)
+ * with a cutoff of 440/441 of Nyquist, a 12 sample window and the phases offset by one,
+ * these parameters reproduce it to within the precision it was stored to
+ */
+/*--------------------------------------------------------------------------------*/
+PolyphaseFilter::PARAMETERS PolyphaseFilter::GetFractionalSampleParameters()
+{
+  PARAMETERS params  = GetDefaultParameters(14, 128, 440.0 / 441.0, 10.056);
+  params.windowlength = 12.0;
+  params.offset       = 1.0 / 128.0;
+  params.normalise    = false;
+  return params;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return shared table for the specified parameters, generating it if necessary
+ */
+/*--------------------------------------------------------------------------------*/
+const PolyphaseFilter& PolyphaseFilter::Get(const PARAMETERS& params)
+{
+  static PolyphaseFilterCache cache;
+  return cache.Get(params);
+}
+
+PolyphaseFilter::PolyphaseFilter(const PARAMETERS& _params) : params(_params),
+                                                              paddedtaps(0),
+                                                              coeffs(NULL)
+{
+  params.taps   = std::max(params.taps,   1u);
+  params.phases = std::max(params.phases, 1u);
+  paddedtaps    = (params.taps + 3) & ~3u;
+
+  // allocate enough for alignment to 32 bytes (8 floats)
+  storage.resize((params.phases + 1) * paddedtaps + 8);
+  coeffs = &storage[0];
+  while (((size_t)coeffs) & 31) coeffs++;
+
+  Generate();
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return window value at x (-1 <= x <= 1)
+ */
+/*--------------------------------------------------------------------------------*/
+double PolyphaseFilter::Window(double x) const
+{
+  double w = 0.0;
+
+  if (fabs(x) <= 1.0)
+  {
+    switch (params.window)
+    {
+      default:
+      case Window_Rectangular:
+        w = 1.0;
+        break;
+
+      case Window_Hann:
+        w = .5 + .5 * cos(M_PI * x);
+        break;
+
+      case Window_Blackman:
+        w = .42 + .5 * cos(M_PI * x) + .08 * cos(2.0 * M_PI * x);
+        break;
+
+      case Window_Kaiser:
+        w = BesselI0(params.beta * sqrt(1.0 - x * x)) / BesselI0(params.beta);
+        break;
+    }
+  }
+
+  return w;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Modified Bessel function of the first kind (order 0)
+ */
+/*--------------------------------------------------------------------------------*/
+double PolyphaseFilter::BesselI0(double x)
+{
+  double sum = 1.0, term = 1.0;
+  uint_t k;
+
+  for (k = 1; k < 100; k++)
+  {
+    term *= (x * x) / (4.0 * (double)k * (double)k);
+    sum  += term;
+    if (term < (1.0e-15 * sum)) break;
+  }
+
+  return sum;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Generate table
+ */
+/*--------------------------------------------------------------------------------*/
+void PolyphaseFilter::Generate()
+{
+  const double halfwindow = .5 * ((params.windowlength > 0.0) ? params.windowlength : (double)params.taps);
+  const double centre     = (double)(params.taps / 2) - 1.0 + params.offset;
+  std::vector<double> row(params.taps);
+  uint_t i, j;
+
+  for (i = 0; i <= params.phases; i++)
+  {
+    const double frac = (double)i / (double)params.phases;
+    double       sum  = 0.0;
+    float        *dst = coeffs + i * paddedtaps;
+
+    for (j = 0; j < params.taps; j++)
+    {
+      // distance from tap to the interpolated position
+      const double d = centre + frac - (double)j;
+      const double x = M_PI * params.cutoff * d;
+
+      row[j] = params.cutoff * ((x != 0.0) ? sin(x) / x : 1.0) * Window(d / halfwindow);
+      sum   += row[j];
+    }
+
+    for (j = 0; j < params.taps; j++)     dst[j] = (float)((params.normalise && (sum != 0.0)) ? row[j] / sum : row[j]);
+    for (; j < paddedtaps; j++)           dst[j] = 0.f;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Calculate coeffs for the fractional part of pos by interpolating between phases
+ *
+ * @param pos position
+ * @param dst destination for GetPaddedTaps() coeffs
+ *
+ * @return dst
+ */
+/*--------------------------------------------------------------------------------*/
+const float *PolyphaseFilter::GetInterpolatedPhase(double pos, float *dst) const
+{
+  const double p    = (pos - floor(pos)) * (double)params.phases;
+  const uint_t i    = std::min((uint_t)p, params.phases - 1);
+  const float  frac = (float)(p - (double)i);
+  const float  *c1  = GetPhase(i);
+  const float  *c2  = c1 + paddedtaps;
+  uint_t j;
+
+  for (j = 0; j < paddedtaps; j++) dst[j] = c1[j] + frac * (c2[j] - c1[j]);
+
+  return dst;
+}
+
+BBC_AUDIOTOOLBOX_END
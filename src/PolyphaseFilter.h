@@ -0,0 +1,263 @@
+#ifndef __POLYPHASE_FILTER__
+#define __POLYPHASE_FILTER__
+
+#include <vector>
+
+#ifdef __AVX__
+#  include <immintrin.h>
+#elif defined(__SSE3__)
+#  include <pmmintrin.h>
+#endif
+
+#include <bbcat-base/misc.h>
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Windowed-sinc polyphase filter table
+ *
+ * The table holds (phases + 1) rows of taps, each row being the filter for a single
+ * fractional position, so the taps for a single position are contiguous
+ *
+ * Row p is the filter for fractional position p / phases; the extra row at the end
+ * allows coeffs to be interpolated between adjacent phases without wrapping
+ *
+ * Tap j of a row is applied to buffer position (int(pos) - taps + j) which places the
+ * centre of the filter (taps / 2 + 1) samples back from the requested position (see FractionalSample())
+ *
+ * Each row is padded with zeros to a multiple of 4 taps and is aligned to 32 bytes
+ * to allow SIMD processing
+ *
+ * Tables are generated once and shared: use Get() to obtain a table and *never* delete it
+ */
+/*--------------------------------------------------------------------------------*/
+class PolyphaseFilter
+{
+public:
+  typedef enum
+  {
+    Window_Rectangular = 0,
+    Window_Hann,
+    Window_Blackman,
+    Window_Kaiser,
+  } Window_t;
+
+  typedef struct
+  {
+    uint_t   taps;              // number of taps for each phase
+    uint_t   phases;            // number of phases (oversampling rate)
+    Window_t window;            // window type
+    double   cutoff;            // cutoff frequency as a proportion of Nyquist
+    double   beta;              // window parameter (Kaiser only)
+    double   windowlength;      // length of window in samples (0 = taps)
+    double   offset;            // additional offset of filter centre in samples
+    bool     normalise;         // true to normalise each phase to unity DC gain
+  } PARAMETERS;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return default parameters for a Kaiser windowed sinc filter
+   */
+  /*--------------------------------------------------------------------------------*/
+  static PARAMETERS GetDefaultParameters(uint_t taps, uint_t phases, double cutoff = 0.92, double beta = 9.0);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return parameters that generate the original FractionalSample() table
+   * (14 taps, 128 phases, Kaiser windowed sinc)
+   */
+  /*--------------------------------------------------------------------------------*/
+  static PARAMETERS GetFractionalSampleParameters();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return shared table for the specified parameters, generating it if necessary
+   *
+   * @note tables are cached for the life of the application
+   * @note this function is thread-safe but generating a table is *not* real-time safe
+   * @note so tables should be requested before audio processing starts
+   */
+  /*--------------------------------------------------------------------------------*/
+  static const PolyphaseFilter& Get(const PARAMETERS& params);
+  static const PolyphaseFilter& Get(uint_t taps, uint_t phases) {return Get(GetDefaultParameters(taps, phases));}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return parameters used to generate table
+   */
+  /*--------------------------------------------------------------------------------*/
+  const PARAMETERS& GetParameters() const {return params;}
+
+  uint_t GetTaps()       const {return params.taps;}
+  uint_t GetPaddedTaps() const {return paddedtaps;}
+  uint_t GetPhases()     const {return params.phases;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return latency (in samples) of the filter relative to the requested position
+   */
+  /*--------------------------------------------------------------------------------*/
+  double GetDelay() const {return (double)(params.taps / 2 + 1) - params.offset;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return memory used by the table in bytes (to help choose tables that fit in cache)
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetMemoryUsage() const {return (params.phases + 1) * paddedtaps * (uint_t)sizeof(float);}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return row of (padded) coeffs for phase (0 <= phase <= phases)
+   */
+  /*--------------------------------------------------------------------------------*/
+  const float *GetPhase(uint_t phase) const {return coeffs + phase * paddedtaps;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return row of coeffs for the fractional part of pos (nearest lower phase)
+   */
+  /*--------------------------------------------------------------------------------*/
+  const float *GetNearestPhase(double pos) const {return GetPhase((uint_t)((double)params.phases * pos) % params.phases);}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Calculate coeffs for the fractional part of pos by interpolating between phases
+   *
+   * @param pos position
+   * @param dst destination for GetPaddedTaps() coeffs
+   *
+   * @return dst
+   */
+  /*--------------------------------------------------------------------------------*/
+  const float *GetInterpolatedPhase(double pos, float *dst) const;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Dot product of a row of weights with contiguous samples
+   *
+   * @note n must be a multiple of 4 and weights must be aligned to 32 bytes (see GetPhase())
+   */
+  /*--------------------------------------------------------------------------------*/
+  static float DotProduct(const float *weights, const float *samples, uint_t n)
+  {
+    uint_t i = 0;
+#if defined(__AVX__)
+    if (!(n & 7))
+    {
+      __m256 acc = _mm256_setzero_ps();
+      for (; i < n; i += 8) acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_load_ps(weights + i), _mm256_loadu_ps(samples + i)));
+      __m128 res = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+      res = _mm_hadd_ps(res, res);
+      res = _mm_hadd_ps(res, res);
+      return _mm_cvtss_f32(res);
+    }
+#endif
+#if defined(__SSE3__)
+    __m128 acc = _mm_setzero_ps();
+    for (; i < n; i += 4) acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(weights + i), _mm_loadu_ps(samples + i)));
+    acc = _mm_hadd_ps(acc, acc);
+    acc = _mm_hadd_ps(acc, acc);
+    return _mm_cvtss_f32(acc);
+#else
+    float res = 0.f;
+    for (; i < n; i++) res += weights[i] * samples[i];
+    return res;
+#endif
+  }
+
+  static double DotProduct(const float *weights, const double *samples, uint_t n)
+  {
+    double res = 0.0;
+    uint_t i;
+    for (i = 0; i < n; i++) res += (double)weights[i] * samples[i];
+    return res;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Apply a row of weights across a number of contiguous channels of contiguous frames
+   *
+   * @param weights row of weights
+   * @param taps number of weights
+   * @param src first frame of source (offset to first channel)
+   * @param channels number of channels in source (frame stride)
+   * @param dst destination (offset to first channel)
+   * @param nchannels number of channels to process
+   *
+   * @note this vectorises *across* channels since, for interleaved data, channels are contiguous
+   */
+  /*--------------------------------------------------------------------------------*/
+  static void Filter(const float *weights, uint_t taps, const float *src, uint_t channels, float *dst, uint_t nchannels)
+  {
+    uint_t i, j = 0;
+
+#if defined(__AVX__)
+    for (; (j + 8) <= nchannels; j += 8)
+    {
+      const float *p = src + j;
+      __m256 acc = _mm256_setzero_ps();
+      for (i = 0; i < taps; i++, p += channels)
+      {
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(weights[i]), _mm256_loadu_ps(p)));
+      }
+      _mm256_storeu_ps(dst + j, acc);
+    }
+#endif
+#if defined(__SSE3__)
+    for (; (j + 4) <= nchannels; j += 4)
+    {
+      const float *p = src + j;
+      __m128 acc = _mm_setzero_ps();
+      for (i = 0; i < taps; i++, p += channels)
+      {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[i]), _mm_loadu_ps(p)));
+      }
+      _mm_storeu_ps(dst + j, acc);
+    }
+#endif
+    for (; j < nchannels; j++)
+    {
+      const float *p  = src + j;
+      float       res = 0.f;
+      for (i = 0; i < taps; i++, p += channels) res += weights[i] * p[0];
+      dst[j] = res;
+    }
+  }
+
+  static void Filter(const float *weights, uint_t taps, const double *src, uint_t channels, double *dst, uint_t nchannels)
+  {
+    uint_t i, j;
+
+    for (j = 0; j < nchannels; j++) dst[j] = 0.0;
+    for (i = 0; i < taps; i++, src += channels)
+    {
+      const double w = weights[i];
+      for (j = 0; j < nchannels; j++) dst[j] += w * src[j];
+    }
+  }
+
+protected:
+  PolyphaseFilter(const PARAMETERS& _params);
+  ~PolyphaseFilter() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Generate table
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Generate();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return window value at x (-1 <= x <= 1)
+   */
+  /*--------------------------------------------------------------------------------*/
+  double Window(double x) const;
+
+  static double BesselI0(double x);
+
+  friend class PolyphaseFilterCache;
+
+protected:
+  PARAMETERS         params;
+  uint_t             paddedtaps;
+  std::vector<float> storage;
+  float              *coeffs;       // aligned pointer into storage
+
+private:
+  // prevent copying
+  PolyphaseFilter(const PolyphaseFilter& obj);
+  PolyphaseFilter& operator = (const PolyphaseFilter& obj);
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
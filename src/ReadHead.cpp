@@ -0,0 +1,366 @@
+
+#include <math.h>
+
+#define BBCDEBUG_LEVEL 1
+#include "ReadHead.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Return shared filter table
+ */
+/*--------------------------------------------------------------------------------*/
+static const PolyphaseFilter& GetFilter()
+{
+  static const PolyphaseFilter& filter = PolyphaseFilter::Get(ReadHead::FilterTaps, ReadHead::FilterPhases);
+  return filter;
+}
+
+ReadHead::ReadHead(double _position, double _rate) :
+  position(_position),
+  rate(_rate),
+  target(_rate),
+  ramp(0.0),
+  rampcount(0)
+{
+  weightstorage.resize(GetMaxTaps() + 8);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return number of frames required either side of the position for the specified maximum rate
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t ReadHead::GetLookahead(double maxrate)
+{
+  const double r = std::max(std::min(fabs(maxrate), (double)MaxAntiAliasRate), 1.0);
+
+  // allow for padding of weights to a multiple of 4
+  return (uint_t)ceil(r * (double)(FilterTaps / 2)) + 4;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set position to be delay frames behind the write position of buffer
+ */
+/*--------------------------------------------------------------------------------*/
+void ReadHead::SetDelay(const SoundDelayBuffer& buffer, double delay)
+{
+  const double length = (double)buffer.GetLength();
+
+  if (length > 0.0)
+  {
+    position = fmod((double)buffer.GetWritePosition() - delay, length);
+    if (position < 0.0) position += length;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set rate, either immediately or by ramping linearly over a number of frames
+ *
+ * @param _rate new rate (frames of buffer per output frame, can be zero or negative)
+ * @param rampframes number of output frames over which to ramp to the new rate (0 = immediately)
+ */
+/*--------------------------------------------------------------------------------*/
+void ReadHead::SetRate(double _rate, uint_t rampframes)
+{
+  target    = _rate;
+  rampcount = rampframes;
+
+  if (rampcount) ramp = (target - rate) / (double)rampcount;
+  else
+  {
+    rate = target;
+    ramp = 0.0;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Calculate weights for a fractional position and rate
+ *
+ * @param frac fractional part of position (0 <= frac < 1)
+ * @param absrate absolute rate
+ * @param weights destination for weights (aligned, at least GetMaxTaps() long)
+ * @param offset offset from the integer part of the position of the first weight
+ *
+ * @return number of weights (padded with zeros to a multiple of 4)
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t ReadHead::CalcWeights(double frac, double absrate, float *weights, sint_t& offset)
+{
+  const PolyphaseFilter& filter = GetFilter();
+  uint_t n;
+
+  if (absrate <= 1.0)
+  {
+    // table row j applies to the sample at (int(pos) - taps / 2 + 1 + j)
+    filter.GetInterpolatedPhase(frac, weights);
+    offset = 1 - (sint_t)(FilterTaps / 2);
+    n      = filter.GetPaddedTaps();
+  }
+  else
+  {
+    // stretch the prototype filter by the rate to lower its cutoff
+    const double r      = std::min(absrate, (double)MaxAntiAliasRate);
+    const double half   = r * (double)(FilterTaps / 2);
+    const double centre = (double)(FilterTaps / 2 - 1);
+    const sint_t first  = (sint_t)floor(frac - half) + 1;
+    const sint_t last   = (sint_t)floor(frac + half);
+    double sum = 0.0;
+    sint_t o;
+
+    for (o = first, n = 0; o <= last; o++, n++)
+    {
+      // evaluate prototype at d = (frac - o) / r from the table
+      const double u = centre - (frac - (double)o) / r;
+      const sint_t j = (sint_t)ceil(u);
+      float w = 0.f;
+
+      if ((j >= 0) && (j < (sint_t)FilterTaps))
+      {
+        const double p  = ((double)j - u) * (double)FilterPhases;
+        const uint_t i  = std::min((uint_t)p, (uint_t)FilterPhases - 1);
+        const float  f  = (float)(p - (double)i);
+        const float  c1 = filter.GetPhase(i)[j];
+        const float  c2 = filter.GetPhase(i + 1)[j];
+
+        w = c1 + f * (c2 - c1);
+      }
+
+      weights[n] = w;
+      sum       += w;
+    }
+
+    // normalise for unity gain at DC
+    if (sum != 0.0)
+    {
+      const float scale = (float)(1.0 / sum);
+      uint_t i;
+
+      for (i = 0; i < n; i++) weights[i] *= scale;
+    }
+
+    offset = first;
+  }
+
+  // pad to a multiple of 4
+  while (n & 3) weights[n++] = 0.f;
+
+  return n;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Apply weights to a frame of channels starting at integer position start in buffer (handles wrapping)
+ */
+/*--------------------------------------------------------------------------------*/
+void ReadHead::ApplyWeights(const float *buf, uint_t length, uint_t channels, sint_t start,
+                            const float *weights, uint_t n, float *dst, uint_t nchannels, std::vector<float>& scratch)
+{
+  const float *p;
+  uint_t stride = channels;
+
+  start %= (sint_t)length;
+  if (start < 0) start += length;
+
+  if (((uint_t)start + n) <= length) p = buf + start * channels;
+  else
+  {
+    // window wraps: gather frames into scratch
+    uint_t i, j, k;
+
+    if (scratch.size() < (n * nchannels)) scratch.resize(n * nchannels);
+
+    for (i = 0, j = (uint_t)start; i < n; i++, j = (j + 1) % length)
+    {
+      for (k = 0; k < nchannels; k++) scratch[i * nchannels + k] = buf[j * channels + k];
+    }
+
+    p      = &scratch[0];
+    stride = nchannels;
+  }
+
+  if ((stride == 1) && (nchannels == 1)) dst[0] = PolyphaseFilter::DotProduct(weights, p, n);
+  else PolyphaseFilter::Filter(weights, n, p, stride, dst, nchannels);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Render frames from buffer
+ *
+ * @param buffer buffer to read from (must be float format)
+ * @param channel first channel within buffer to read
+ * @param nchannels number of channels to read
+ * @param dst destination
+ * @param dstchannel first channel in destination to write to
+ * @param dstchannels total number of channels in destination
+ * @param nframes number of frames to render
+ *
+ * @return number of frames rendered
+ *
+ * @note the position and rate advance for each frame rendered
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t ReadHead::Render(const SoundDelayBuffer& buffer, uint_t channel, uint_t nchannels,
+                        float *dst, uint_t dstchannel, uint_t dstchannels, uint_t nframes)
+{
+  const float  *buf;
+  const uint_t length   = buffer.GetLength();
+  const uint_t channels = buffer.GetChannels();
+  float        *weights = Align(weightstorage);
+  uint_t i;
+
+  if (!buffer.GetBuffer(&buf) || !length) return 0;
+
+  nchannels = std::min(nchannels, limited::subz(channels,    channel));
+  nchannels = std::min(nchannels, limited::subz(dstchannels, dstchannel));
+  if (!nchannels) return 0;
+
+  position = fmod(position, (double)length);
+  if (position < 0.0) position += (double)length;
+
+  for (i = 0; i < nframes; i++, dst += dstchannels)
+  {
+    const double ipos = floor(position);
+    sint_t offset;
+    uint_t n = CalcWeights(position - ipos, fabs(rate), weights, offset);
+
+    ApplyWeights(buf + channel, length, channels, (sint_t)ipos + offset, weights, n, dst + dstchannel, nchannels, scratch);
+
+    Advance((double)length);
+  }
+
+  return nframes;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+ReadHeadGroup::ReadHeadGroup(uint_t nheads, uint_t _resolution) : heads(nheads),
+                                                                  slots(CacheSlots),
+                                                                  resolution(_resolution),
+                                                                  shared(0)
+{
+  weightstorage.resize(CacheSlots * ReadHead::GetMaxTaps() + 8);
+  ClearCache();
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Invalidate all cached weights
+ */
+/*--------------------------------------------------------------------------------*/
+void ReadHeadGroup::ClearCache()
+{
+  uint_t i;
+
+  for (i = 0; i < (uint_t)slots.size(); i++)
+  {
+    slots[i].key    = ~(uint64_t)0;
+    slots[i].offset = 0;
+    slots[i].n      = 0;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Render frames from buffer for all heads
+ *
+ * @param buffer buffer to read from (must be float format)
+ * @param channel first channel within buffer to read
+ * @param nchannels number of channels to read
+ * @param dst destination
+ * @param dstchannel first channel in destination to write to
+ * @param dstchannels total number of channels in destination (at least dstchannel + GetHeadCount() * nchannels)
+ * @param nframes number of frames to render
+ *
+ * @return number of frames rendered
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t ReadHeadGroup::Render(const SoundDelayBuffer& buffer, uint_t channel, uint_t nchannels,
+                             float *dst, uint_t dstchannel, uint_t dstchannels, uint_t nframes)
+{
+  const float  *buf;
+  const uint_t length   = buffer.GetLength();
+  const uint_t channels = buffer.GetChannels();
+  const uint_t maxtaps  = ReadHead::GetMaxTaps();
+  float        *storage = ReadHead::Align(weightstorage);
+  uint_t h;
+
+  shared = 0;
+
+  if (!buffer.GetBuffer(&buf) || !length) return 0;
+
+  nchannels = std::min(nchannels, limited::subz(channels, channel));
+  if (!nchannels) return 0;
+
+  for (h = 0; h < (uint_t)heads.size(); h++)
+  {
+    ReadHead&    head = heads[h];
+    const uint_t dch  = dstchannel + h * nchannels;
+    float        *p   = dst;
+    uint_t       i;
+
+    // not enough destination channels for this head
+    if ((dch + nchannels) > dstchannels) break;
+
+    head.position = fmod(head.position, (double)length);
+    if (head.position < 0.0) head.position += (double)length;
+
+    for (i = 0; i < nframes; i++, p += dstchannels)
+    {
+      double   ipos    = floor(head.position);
+      double   frac    = head.position - ipos;
+      double   absrate = fabs(head.rate);
+      float    *weights;
+      sint_t   offset;
+      uint_t   n;
+
+      if (resolution)
+      {
+        // quantise fractional position (and rate when anti-aliasing) to form the cache key
+        uint64_t q  = (uint64_t)floor(frac * (double)resolution + .5);
+        uint64_t rq = 0;
+        uint64_t key;
+
+        if (q == resolution)
+        {
+          q     = 0;
+          ipos += 1.0;
+        }
+        frac = (double)q / (double)resolution;
+
+        if (absrate > 1.0)
+        {
+          rq      = (uint64_t)floor(std::min(absrate, (double)ReadHead::MaxAntiAliasRate) * 256.0 + .5);
+          absrate = (double)rq / 256.0;
+        }
+
+        key = (rq << 32) | q;
+
+        SLOT& slot = slots[(uint_t)((q ^ (q >> 6) ^ (rq * 0x9e37)) % CacheSlots)];
+        weights = storage + (&slot - &slots[0]) * maxtaps;
+
+        if (slot.key == key) shared++;
+        else
+        {
+          slot.n   = ReadHead::CalcWeights(frac, absrate, weights, slot.offset);
+          slot.key = key;
+        }
+
+        offset = slot.offset;
+        n      = slot.n;
+      }
+      else
+      {
+        // use last slot as scratch weights, invalidating it
+        SLOT& slot = slots[CacheSlots - 1];
+
+        slot.key = ~(uint64_t)0;
+        weights  = storage + (CacheSlots - 1) * maxtaps;
+        n        = ReadHead::CalcWeights(frac, absrate, weights, offset);
+      }
+
+      ReadHead::ApplyWeights(buf + channel, length, channels, (sint_t)ipos + offset, weights, n, p + dch, nchannels, scratch);
+
+      head.Advance((double)length);
+    }
+  }
+
+  return nframes;
+}
+
+BBC_AUDIOTOOLBOX_END
@@ -0,0 +1,252 @@
+#ifndef __READ_HEAD__
+#define __READ_HEAD__
+
+#include <vector>
+
+#include "PolyphaseFilter.h"
+#include "SoundDelayBuffer.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Variable speed read head for a (float) SoundDelayBuffer
+ *
+ * The head has a fractional position within the buffer which advances by rate for every
+ * frame rendered, the rate itself can ramp linearly to a new rate over a number of frames
+ * (e.g. for Doppler shifts of moving sources or for varispeed playback)
+ *
+ * Each output frame is the (windowed-sinc) interpolated signal at *exactly* the current
+ * position, so the buffer must contain GetLookahead() frames beyond the position and the same
+ * number before it (e.g. use SetDelay() with a delay of at least GetLookahead())
+ *
+ * When |rate| > 1 the filter is stretched by the rate to lower its cutoff and prevent aliasing
+ * (up to a maximum of MaxAntiAliasRate, beyond which the filter remains fixed)
+ *
+ * Coeffs are taken from a shared oversampled PolyphaseFilter table
+ */
+/*--------------------------------------------------------------------------------*/
+class ReadHead
+{
+public:
+  ReadHead(double _position = 0.0, double _rate = 1.0);
+  virtual ~ReadHead() {}
+
+  enum
+  {
+    FilterTaps       = 32,      // taps of filter at rate <= 1
+    FilterPhases     = 256,     // phases of table
+    MaxAntiAliasRate = 8,       // maximum rate for which the filter is stretched
+  };
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of frames required either side of the position for the specified maximum rate
+   */
+  /*--------------------------------------------------------------------------------*/
+  static uint_t GetLookahead(double maxrate = 1.0);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set/get position in frames within the buffer
+   */
+  /*--------------------------------------------------------------------------------*/
+  void   SetPosition(double _position) {position = _position;}
+  double GetPosition() const {return position;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set position to be delay frames behind the write position of buffer
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetDelay(const SoundDelayBuffer& buffer, double delay);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set rate, either immediately or by ramping linearly over a number of frames
+   *
+   * @param _rate new rate (frames of buffer per output frame, can be zero or negative)
+   * @param rampframes number of output frames over which to ramp to the new rate (0 = immediately)
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetRate(double _rate, uint_t rampframes = 0);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return current rate, target rate and rate change per frame
+   */
+  /*--------------------------------------------------------------------------------*/
+  double GetRate()       const {return rate;}
+  double GetTargetRate() const {return rampcount ? target : rate;}
+  double GetRateRamp()   const {return rampcount ? ramp : 0.0;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Render frames from buffer
+   *
+   * @param buffer buffer to read from (must be float format)
+   * @param channel first channel within buffer to read
+   * @param nchannels number of channels to read
+   * @param dst destination
+   * @param dstchannel first channel in destination to write to
+   * @param dstchannels total number of channels in destination
+   * @param nframes number of frames to render
+   *
+   * @return number of frames rendered
+   *
+   * @note the position and rate advance for each frame rendered
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t Render(const SoundDelayBuffer& buffer, uint_t channel, uint_t nchannels,
+                float *dst, uint_t dstchannel, uint_t dstchannels, uint_t nframes);
+
+protected:
+  friend class ReadHeadGroup;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Calculate weights for a fractional position and rate
+   *
+   * @param frac fractional part of position (0 <= frac < 1)
+   * @param absrate absolute rate
+   * @param weights destination for weights (aligned, at least GetMaxTaps() long)
+   * @param offset offset from the integer part of the position of the first weight
+   *
+   * @return number of weights (padded with zeros to a multiple of 4)
+   */
+  /*--------------------------------------------------------------------------------*/
+  static uint_t CalcWeights(double frac, double absrate, float *weights, sint_t& offset);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Apply weights to a frame of channels starting at integer position start in buffer (handles wrapping)
+   */
+  /*--------------------------------------------------------------------------------*/
+  static void ApplyWeights(const float *buf, uint_t length, uint_t channels, sint_t start,
+                           const float *weights, uint_t n, float *dst, uint_t nchannels, std::vector<float>& scratch);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return maximum number of weights returned by CalcWeights()
+   */
+  /*--------------------------------------------------------------------------------*/
+  static uint_t GetMaxTaps() {return ((MaxAntiAliasRate * FilterTaps + 2) + 3) & ~3;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return pointer aligned to 32 bytes within storage (which must have 8 extra items)
+   */
+  /*--------------------------------------------------------------------------------*/
+  static float *Align(std::vector<float>& storage)
+  {
+    float *p = &storage[0];
+    while (((size_t)p) & 31) p++;
+    return p;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Advance position and rate by one frame
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Advance(double length)
+  {
+    position += rate;
+    if      (position >= length) position -= length;
+    else if (position < 0.0)     position += length;
+
+    if (rampcount) rate = --rampcount ? rate + ramp : target;
+  }
+
+protected:
+  double             position;
+  double             rate;
+  double             target;
+  double             ramp;
+  uint_t             rampcount;
+  std::vector<float> weightstorage;
+  std::vector<float> scratch;
+};
+
+/*--------------------------------------------------------------------------------*/
+/** A group of read heads rendering from the same buffer
+ *
+ * Heads whose fractional positions (and rates, when anti-aliasing) are the same to within the grouping
+ * resolution share a single set of weights, so that many heads at similar phases (e.g. several Doppler
+ * heads on one source, or heads moving at the same rate) only calculate weights once
+ *
+ * The output of head n is written to destination channels (dstchannel + n * nchannels) onwards
+ */
+/*--------------------------------------------------------------------------------*/
+class ReadHeadGroup
+{
+public:
+  ReadHeadGroup(uint_t nheads = 0, uint_t _resolution = 4096);
+  ~ReadHeadGroup() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set/get number of heads
+   */
+  /*--------------------------------------------------------------------------------*/
+  void   SetHeadCount(uint_t n) {heads.resize(n);}
+  uint_t GetHeadCount() const {return (uint_t)heads.size();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return head
+   */
+  /*--------------------------------------------------------------------------------*/
+  ReadHead&       GetHead(uint_t n)       {return heads[n];}
+  const ReadHead& GetHead(uint_t n) const {return heads[n];}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set grouping resolution in steps per frame (0 = no grouping, all weights calculated exactly)
+   *
+   * @note positions of grouped heads are effectively quantised to 1 / resolution frames
+   */
+  /*--------------------------------------------------------------------------------*/
+  void   SetResolution(uint_t _resolution) {resolution = _resolution; ClearCache();}
+  uint_t GetResolution() const {return resolution;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Render frames from buffer for all heads
+   *
+   * @param buffer buffer to read from (must be float format)
+   * @param channel first channel within buffer to read
+   * @param nchannels number of channels to read
+   * @param dst destination
+   * @param dstchannel first channel in destination to write to
+   * @param dstchannels total number of channels in destination (at least dstchannel + GetHeadCount() * nchannels)
+   * @param nframes number of frames to render
+   *
+   * @return number of frames rendered
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t Render(const SoundDelayBuffer& buffer, uint_t channel, uint_t nchannels,
+                float *dst, uint_t dstchannel, uint_t dstchannels, uint_t nframes);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of weight calculations saved by grouping during the last Render()
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetSharedCount() const {return shared;}
+
+protected:
+  /*--------------------------------------------------------------------------------*/
+  /** Invalidate all cached weights
+   */
+  /*--------------------------------------------------------------------------------*/
+  void ClearCache();
+
+  enum
+  {
+    CacheSlots = 64,
+  };
+
+  // weights depend only on the (quantised) fractional position and rate so are cached between frames
+  typedef struct
+  {
+    uint64_t key;
+    sint_t   offset;
+    uint_t   n;
+  } SLOT;
+
+protected:
+  std::vector<ReadHead> heads;
+  std::vector<SLOT>     slots;
+  std::vector<float>    weightstorage;  // weights for each slot
+  std::vector<float>    scratch;
+  uint_t                resolution;
+  uint_t                shared;
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
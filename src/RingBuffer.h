@@ -127,7 +127,7 @@ public:
   }
   
   /*--------------------------------------------------------------------------------*/
-  /** Return buffer for specific position and the maximum number of items that can be read
+  /** Return buffer for specific position and the maximum number of items that can be read (or modified)
    */
   /*--------------------------------------------------------------------------------*/
   const ITEMTYPE *GetBuffer(uint_t rpos = 0, uint_t *maxitems = NULL) const
@@ -140,6 +140,16 @@ public:
     return NULL;
   } 
 
+  ITEMTYPE *GetBuffer(uint_t rpos = 0, uint_t *maxitems = NULL)
+  {
+    if (buffer.size())
+    {
+      if (maxitems) *maxitems = buffer.size() - rpos;
+      return &buffer[rpos];
+    }
+    return NULL;
+  } 
+
   /*--------------------------------------------------------------------------------*/
   /** Return delayed buffer ptr and the maximum number of items that can be read
    */
@@ -0,0 +1,417 @@
+#ifndef __RUNNING_MEDIAN__
+#define __RUNNING_MEDIAN__
+
+#include <math.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "Histogram.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Simple templated running median (or any other quantile) over a sliding window
+ *
+ * The items of the window are held in two heaps: a max-heap of the lowest k items and a min-heap
+ * of the rest, so that the k'th lowest item (the quantile) is always the top of the first heap
+ *
+ * Each heap entry refers to a slot of the window (and each slot knows where it is in the heaps) so
+ * the oldest item can be removed from the middle of a heap, giving O(log n) updates
+ *
+ * @param ITEMTYPE type of each item (MUST be a simple type)
+ *
+ * @note for even window lengths, the median is the lower of the two middle items
+ */
+/*--------------------------------------------------------------------------------*/
+template<typename ITEMTYPE>
+class RunningMedian
+{
+public:
+  RunningMedian(uint_t n = 0, double _quantile = .5) : quantile(limited::limit(_quantile, 0.0, 1.0)) {SetLength(n);}
+  RunningMedian(const RunningMedian& obj) : values(obj.values),
+                                            heapof(obj.heapof),
+                                            heapindex(obj.heapindex),
+                                            quantile(obj.quantile),
+                                            pos(obj.pos),
+                                            count(obj.count)
+  {
+    heaps[0] = obj.heaps[0]; heaps[1] = obj.heaps[1];
+    sizes[0] = obj.sizes[0]; sizes[1] = obj.sizes[1];
+  }
+  ~RunningMedian() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set window length
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetLength(uint_t n)
+  {
+    values.resize(n);
+    heapof.resize(n);
+    heapindex.resize(n);
+    heaps[0].resize(n);
+    heaps[1].resize(n);
+    Reset();
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return window length
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetLength() const {return (uint_t)values.size();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set quantile (0 = minimum, .5 = median, 1 = maximum)
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetQuantile(double _quantile)
+  {
+    quantile = limited::limit(_quantile, 0.0, 1.0);
+    Rebalance();
+  }
+  double GetQuantile() const {return quantile;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Reset window
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset()
+  {
+    pos      = 0;
+    count    = 0;
+    sizes[0] = sizes[1] = 0;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Write item into window and update quantile
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Write(ITEMTYPE val)
+  {
+    if (values.size())
+    {
+      // remove oldest item from whichever heap it is in
+      if (count == values.size()) Remove(heapof[pos], heapindex[pos]);
+      else count++;
+
+      // add new item to low heap if it is no greater than the quantile, otherwise to the high heap
+      values[pos] = val;
+      Push((sizes[0] && (val <= values[heaps[0][0]])) ? 0 : 1, pos);
+
+      Rebalance();
+
+      if ((++pos) == values.size()) pos = 0;
+    }
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Write items into window and update quantile
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Write(const ITEMTYPE *src, uint_t n, uint_t stride = 1)
+  {
+    uint_t i;
+
+    for (i = 0; i < n; i++, src += stride) Write(src[0]);
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Write items into window and write quantile after each item to destination
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Process(const ITEMTYPE *src, ITEMTYPE *dst, uint_t n, uint_t srcstride = 1, uint_t dststride = 1)
+  {
+    uint_t i;
+
+    for (i = 0; i < n; i++, src += srcstride, dst += dststride)
+    {
+      Write(src[0]);
+      dst[0] = GetValue();
+    }
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return current quantile of the window (or of the items written so far if the window has not been filled)
+   */
+  /*--------------------------------------------------------------------------------*/
+  ITEMTYPE GetValue() const {return sizes[0] ? values[heaps[0][0]] : (ITEMTYPE)0;}
+
+protected:
+  /*--------------------------------------------------------------------------------*/
+  /** Return whether slot a should be above slot b in heap h (heap 0 is a max-heap, heap 1 a min-heap)
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool Above(uint_t h, uint_t a, uint_t b) const {return h ? (values[a] < values[b]) : (values[a] > values[b]);}
+
+  void Swap(uint_t h, uint_t i, uint_t j)
+  {
+    std::swap(heaps[h][i], heaps[h][j]);
+    heapindex[heaps[h][i]] = i;
+    heapindex[heaps[h][j]] = j;
+  }
+
+  void SiftUp(uint_t h, uint_t i)
+  {
+    while (i)
+    {
+      uint_t parent = (i - 1) >> 1;
+      if (!Above(h, heaps[h][i], heaps[h][parent])) break;
+      Swap(h, i, parent);
+      i = parent;
+    }
+  }
+
+  void SiftDown(uint_t h, uint_t i)
+  {
+    while (true)
+    {
+      uint_t child = 2 * i + 1, best = i;
+
+      if ((child < sizes[h])       && Above(h, heaps[h][child],     heaps[h][best])) best = child;
+      if (((child + 1) < sizes[h]) && Above(h, heaps[h][child + 1], heaps[h][best])) best = child + 1;
+      if (best == i) break;
+      Swap(h, i, best);
+      i = best;
+    }
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Add slot to heap
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Push(uint_t h, uint_t slot)
+  {
+    uint_t i = sizes[h]++;
+
+    heaps[h][i]     = slot;
+    heapof[slot]    = h;
+    heapindex[slot] = i;
+    SiftUp(h, i);
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Remove entry i from heap, returning its slot
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t Remove(uint_t h, uint_t i)
+  {
+    uint_t slot = heaps[h][i], last = --sizes[h];
+
+    if (i != last)
+    {
+      heaps[h][i] = heaps[h][last];
+      heapindex[heaps[h][i]] = i;
+      SiftDown(h, i);
+      SiftUp(h, i);
+    }
+
+    return slot;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Move items between heaps such that the low heap holds the correct number of items for the quantile
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Rebalance()
+  {
+    if (count)
+    {
+      const uint_t k = (uint_t)floor(quantile * (double)(count - 1)) + 1;
+
+      while (sizes[0] > k) Push(1, Remove(0, 0));
+      while (sizes[0] < k) Push(0, Remove(1, 0));
+    }
+  }
+
+protected:
+  std::vector<ITEMTYPE> values;         // window of items (circular)
+  std::vector<uint_t>   heaps[2];       // heaps of slots: 0 = max-heap of low items, 1 = min-heap of high items
+  std::vector<uint8_t>  heapof;         // which heap each slot is in
+  std::vector<uint_t>   heapindex;      // index of each slot within its heap
+  uint_t                sizes[2];
+  double                quantile;
+  uint_t                pos;
+  uint_t                count;
+};
+
+/*--------------------------------------------------------------------------------*/
+/** Running median (or any other quantile) of quantised data over a sliding window
+ *
+ * Items are binned using Histogram binning and the window holds only a count per bin, the bin of the
+ * quantile is tracked as items enter and leave the window, typically moving by a bin or so, giving O(1)
+ * updates (for smooth or finely quantised data) independent of window length
+ *
+ * The result is the value of the bin containing the quantile (see Histogram::CalcReversedIndex())
+ *
+ * @param INDEXTYPE type of each item (as used by Histogram)
+ */
+/*--------------------------------------------------------------------------------*/
+template<typename INDEXTYPE>
+class HistogramRunningMedian
+{
+public:
+  /*--------------------------------------------------------------------------------*/
+  /** Constructor
+   *
+   * @param n window length
+   * @param _min, _max, _step binning (see Histogram)
+   * @param _quantile quantile (0 = minimum, .5 = median, 1 = maximum)
+   */
+  /*--------------------------------------------------------------------------------*/
+  HistogramRunningMedian(uint_t n = 0,
+                         INDEXTYPE _min  = INDEXTYPE(0),
+                         INDEXTYPE _max  = INDEXTYPE(1),
+                         INDEXTYPE _step = INDEXTYPE(1),
+                         double _quantile = .5) : bins(_min, _max, _step),
+                                                  quantile(limited::limit(_quantile, 0.0, 1.0))
+  {
+    window.resize(n);
+    Reset();
+  }
+  ~HistogramRunningMedian() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set window length
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetLength(uint_t n)
+  {
+    window.resize(n);
+    Reset();
+  }
+  uint_t GetLength() const {return (uint_t)window.size();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set binning (see Histogram)
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetRange(INDEXTYPE _min, INDEXTYPE _max, INDEXTYPE _step = INDEXTYPE(1))
+  {
+    bins.SetRange(_min, _max, _step);
+    Reset();
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set quantile (0 = minimum, .5 = median, 1 = maximum)
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetQuantile(double _quantile)
+  {
+    quantile = limited::limit(_quantile, 0.0, 1.0);
+    UpdateBin();
+  }
+  double GetQuantile() const {return quantile;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Reset window
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset()
+  {
+    counts.assign(bins.GetSize(), 0);
+    pos   = 0;
+    count = 0;
+    bin   = 0;
+    below = 0;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Write item into window and update quantile
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Write(INDEXTYPE val)
+  {
+    if (window.size() && counts.size())
+    {
+      uint_t index = bins.CalcIndex(val);
+
+      // remove oldest item
+      if (count == window.size())
+      {
+        const uint_t old = window[pos];
+        counts[old]--;
+        if (old < bin) below--;
+      }
+      else count++;
+
+      // add new item
+      window[pos] = index;
+      counts[index]++;
+      if (index < bin) below++;
+
+      UpdateBin();
+
+      if ((++pos) == window.size()) pos = 0;
+    }
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Write items into window and update quantile
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Write(const INDEXTYPE *src, uint_t n, uint_t stride = 1)
+  {
+    uint_t i;
+
+    for (i = 0; i < n; i++, src += stride) Write(src[0]);
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Write items into window and write quantile after each item to destination
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Process(const INDEXTYPE *src, INDEXTYPE *dst, uint_t n, uint_t srcstride = 1, uint_t dststride = 1)
+  {
+    uint_t i;
+
+    for (i = 0; i < n; i++, src += srcstride, dst += dststride)
+    {
+      Write(src[0]);
+      dst[0] = GetValue();
+    }
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return current quantile (value of bin) of the window
+   */
+  /*--------------------------------------------------------------------------------*/
+  INDEXTYPE GetValue() const {return count ? bins.CalcReversedIndex(bin) : INDEXTYPE(0);}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return bin index of current quantile
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetBin() const {return bin;}
+
+protected:
+  /*--------------------------------------------------------------------------------*/
+  /** Move quantile bin such that the k'th lowest item is within it
+   */
+  /*--------------------------------------------------------------------------------*/
+  void UpdateBin()
+  {
+    if (count)
+    {
+      const uint_t k = (uint_t)floor(quantile * (double)(count - 1)) + 1;
+
+      // below is the number of items in bins lower than bin
+      while (below >= k) below -= counts[--bin];
+      while ((below + counts[bin]) < k) below += counts[bin++];
+    }
+  }
+
+protected:
+  Histogram<INDEXTYPE,uint_t> bins;     // used for binning only
+  std::vector<uint_t>         counts;   // number of items in window in each bin
+  std::vector<uint_t>         window;   // bin of each item in window (circular)
+  double                      quantile;
+  uint_t                      pos;
+  uint_t                      count;
+  uint_t                      bin;      // bin containing quantile
+  uint_t                      below;    // number of items in window in bins below bin
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
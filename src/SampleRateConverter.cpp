@@ -0,0 +1,333 @@
+
+#include <math.h>
+
+#define BBCDEBUG_LEVEL 1
+#include "SampleRateConverter.h"
+
+BBC_AUDIOTOOLBOX_START
+
+SampleRateConverter::SampleRateConverter(uint_t _channels, double _inputrate, double _outputrate, uint_t _taps) :
+  filter(NULL),
+  channels(0),
+  inputrate(0.0),
+  outputrate(0.0),
+  rational(false),
+  ipos(0),
+  fnum(0),
+  frac(0.0),
+  L(1),
+  M(1),
+  phasestep(1),
+  step(1.0),
+  coeffs(NULL)
+{
+  if (_channels) Setup(_channels, _inputrate, _outputrate, _taps);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Greatest common divisor
+ */
+/*--------------------------------------------------------------------------------*/
+static uint64_t GCD(uint64_t a, uint64_t b)
+{
+  while (b)
+  {
+    uint64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set up converter
+ *
+ * @param _channels number of channels
+ * @param _inputrate input sample rate
+ * @param _outputrate output sample rate
+ * @param _taps basic number of filter taps (increased when downsampling)
+ *
+ * @return true if set up successfully
+ */
+/*--------------------------------------------------------------------------------*/
+bool SampleRateConverter::Setup(uint_t _channels, double _inputrate, double _outputrate, uint_t _taps)
+{
+  if (!_channels || (_inputrate <= 0.0) || (_outputrate <= 0.0) || (_taps < 2))
+  {
+    BBCERROR("Invalid sample rate converter parameters (%u channels, %0.1lfHz -> %0.1lfHz, %u taps)", _channels, _inputrate, _outputrate, _taps);
+    return false;
+  }
+
+  channels   = _channels;
+  inputrate  = _inputrate;
+  outputrate = _outputrate;
+  step       = inputrate / outputrate;
+
+  // when downsampling, lower the cutoff and lengthen the filter to keep the same transition band (in input samples)
+  const double scale = std::min(outputrate / inputrate, 1.0);
+  uint_t       taps  = std::min((uint_t)ceil((double)_taps / scale), 1024u);
+  taps += (taps & 1);
+
+  // use exact stepping if both rates are integers and the interpolation factor is small enough
+  rational  = false;
+  L = M     = 1;
+  phasestep = 1;
+  if ((inputrate  == floor(inputrate))  && (inputrate  < 4294967296.0) &&
+      (outputrate == floor(outputrate)) && (outputrate < 4294967296.0))
+  {
+    uint64_t g = GCD((uint64_t)inputrate, (uint64_t)outputrate);
+
+    if (((uint64_t)outputrate / g) <= MaxRationalPhases)
+    {
+      rational  = true;
+      L         = (uint_t)((uint64_t)outputrate / g);
+      M         = (uint_t)((uint64_t)inputrate  / g);
+      // ensure table has enough phases to be useful if the ratio is later changed using SetRatio()
+      phasestep = (ArbitraryPhases + L - 1) / L;
+    }
+  }
+
+  filter = &PolyphaseFilter::Get(PolyphaseFilter::GetDefaultParameters(taps, rational ? L * phasestep : (uint_t)ArbitraryPhases, .92 * scale));
+
+  BBCDEBUG1(("Sample rate converter %0.1lfHz -> %0.1lfHz: %u channels, %u taps, %s (L = %u, M = %u)", inputrate, outputrate, channels, taps, rational ? "rational" : "arbitrary", L, M));
+
+  // the input buffer must hold the filter plus enough frames to generate at least one output frame
+  input.SetSize(channels, 2 * filter->GetPaddedTaps() + std::max((uint_t)InputFrames, 2 * (uint_t)ceil(step)), SampleFormat_Float);
+
+  output.resize(BlockFrames * channels);
+  gather.resize(filter->GetPaddedTaps() * channels);
+  coeffstorage.resize(filter->GetPaddedTaps() + 8);
+  coeffs = &coeffstorage[0];
+  while (((size_t)coeffs) & 31) coeffs++;
+
+  Reset();
+
+  return true;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Clear all history and reset position
+ */
+/*--------------------------------------------------------------------------------*/
+void SampleRateConverter::Reset()
+{
+  if (filter)
+  {
+    const uint_t taps = filter->GetTaps();
+
+    // discard all input
+    input.IncrementReadPosition(input.GetReadFramesAvailable());
+
+    // prime buffer with (taps - 1) frames of silence so that the first output frame needs only the first input frame
+    std::fill(gather.begin(), gather.end(), 0.f);
+    input.IncrementWritePosition(input.WriteSamples(&gather[0], 0, channels, taps - 1));
+
+    ipos = taps;
+    fnum = 0;
+    frac = 0.0;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Change conversion ratio (output rate / input rate) without resetting
+ *
+ * @note this switches the converter to arbitrary mode
+ * @note the filter is NOT changed so the ratio should remain close to the ratio set up by Setup()
+ * @note this function is real-time safe
+ */
+/*--------------------------------------------------------------------------------*/
+void SampleRateConverter::SetRatio(double ratio)
+{
+  if (ratio > 0.0)
+  {
+    if (rational)
+    {
+      frac     = (double)fnum / (double)L;
+      rational = false;
+    }
+
+    step = 1.0 / ratio;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return number of input frames written beyond the (fractional) position of the next output frame
+ *
+ * @note the next output frame can be generated if this is positive
+ */
+/*--------------------------------------------------------------------------------*/
+double SampleRateConverter::GetBufferedFrames() const
+{
+  const double pos = (double)ipos + (rational ? (double)fnum / (double)L : frac);
+  return (double)(input.GetReadFramesAvailable() + 1) - pos;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return number of output frames that the currently buffered input plus nsrcframes will generate
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t SampleRateConverter::CalcOutputFrames(uint_t nsrcframes) const
+{
+  const uint64_t avail = (uint64_t)input.GetReadFramesAvailable() + nsrcframes;
+  uint_t n = 0;
+
+  if (filter && (avail >= ipos))
+  {
+    // output frame n is possible if the integer part of its position is <= avail
+    if (rational)
+    {
+      const uint64_t limit = (avail - ipos + 1) * L - fnum;
+      n = (uint_t)((limit + M - 1) / M);
+    }
+    else n = (uint_t)ceil(((double)(avail - ipos + 1) - frac) / step);
+  }
+
+  return n;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Generate up to nframes into scratch output from buffered input
+ *
+ * @return number of frames generated
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t SampleRateConverter::Generate(float *dst, uint_t nframes)
+{
+  const float  *buf;
+  const uint_t taps   = filter->GetTaps();
+  const uint_t ptaps  = filter->GetPaddedTaps();
+  const uint_t avail  = input.GetReadFramesAvailable();
+  const uint_t length = input.GetLength();
+  const uint_t rpos   = input.GetReadPosition();
+  uint_t n;
+
+  if (!input.GetBuffer(&buf)) return 0;
+
+  for (n = 0; (n < nframes) && (ipos <= avail); n++, dst += channels)
+  {
+    const float  *weights = rational ? filter->GetPhase(fnum * phasestep) : filter->GetInterpolatedPhase(frac, coeffs);
+    const uint_t start    = (rpos + ipos - taps) % length;
+    const float  *p       = buf + start * channels;
+
+    if (channels == 1)
+    {
+      // DotProduct() reads ptaps samples
+      if ((start + ptaps) > length)
+      {
+        uint_t i, j;
+        for (i = 0, j = start; i < taps; i++, j = (j + 1) % length) gather[i] = buf[j];
+        p = &gather[0];
+      }
+
+      dst[0] = PolyphaseFilter::DotProduct(weights, p, ptaps);
+    }
+    else
+    {
+      if ((start + taps) > length)
+      {
+        uint_t n1 = length - start;
+        std::copy(p, p + n1 * channels, gather.begin());
+        std::copy(buf, buf + (taps - n1) * channels, gather.begin() + n1 * channels);
+        p = &gather[0];
+      }
+
+      PolyphaseFilter::Filter(weights, taps, p, channels, dst, channels);
+    }
+
+    // advance position
+    if (rational)
+    {
+      fnum += M;
+      ipos += fnum / L;
+      fnum %= L;
+    }
+    else
+    {
+      uint_t i;
+      frac += step;
+      ipos += (i = (uint_t)frac);
+      frac -= (double)i;
+    }
+  }
+
+  return n;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Release input frames that will never be used again
+ */
+/*--------------------------------------------------------------------------------*/
+void SampleRateConverter::ReleaseInput()
+{
+  const uint_t taps = filter->GetTaps();
+  const uint_t n    = std::min(ipos - taps, input.GetReadFramesAvailable());
+
+  input.IncrementReadPosition(n);
+  ipos -= n;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Convert a block of frames
+ *
+ * @param src source samples (interleaved, GetChannels() channels)
+ * @param srcformat format of source samples (ASSUMES same endianness as machine)
+ * @param nsrcframes number of source frames available
+ * @param dst destination for samples (interleaved, GetChannels() channels)
+ * @param dstformat format of destination samples (ASSUMES same endianness as machine)
+ * @param ndstframes maximum number of destination frames to generate
+ * @param nsrcconsumed optional destination for number of source frames consumed
+ *
+ * @return number of destination frames generated
+ *
+ * @note all source frames are consumed unless the destination is filled first
+ * @note source frames that are consumed but not yet used are held internally for the next call
+ */
+/*--------------------------------------------------------------------------------*/
+uint_t SampleRateConverter::Process(const uint8_t *src, SampleFormat_t srcformat, uint_t nsrcframes,
+                                   uint8_t *dst, SampleFormat_t dstformat, uint_t ndstframes,
+                                   uint_t *nsrcconsumed)
+{
+  uint_t consumed = 0, generated = 0;
+
+  if (filter)
+  {
+    const uint_t srcbpf = GetBytesPerSample(srcformat) * channels;
+    const uint_t dstbpf = GetBytesPerSample(dstformat) * channels;
+    bool         progress;
+
+    do
+    {
+      uint_t n;
+
+      progress = false;
+
+      // transfer as much input as possible (converting to float)
+      if ((consumed < nsrcframes) && ((n = input.WriteSamples(src + consumed * srcbpf, srcformat, 0, channels, nsrcframes - consumed)) > 0))
+      {
+        input.IncrementWritePosition(n);
+        consumed += n;
+        progress  = true;
+      }
+
+      // generate as much output as possible (converting from float)
+      while ((generated < ndstframes) && ((n = Generate(&output[0], std::min(ndstframes - generated, (uint_t)BlockFrames))) > 0))
+      {
+        TransferSamples(&output[0],             SampleFormat_Float, MACHINE_IS_BIG_ENDIAN, 0, channels,
+                        dst + generated * dstbpf, dstformat,        MACHINE_IS_BIG_ENDIAN, 0, channels,
+                        channels,
+                        n);
+        generated += n;
+        progress   = true;
+      }
+
+      ReleaseInput();
+    }
+    while (progress);
+  }
+
+  if (nsrcconsumed) *nsrcconsumed = consumed;
+
+  return generated;
+}
+
+BBC_AUDIOTOOLBOX_END
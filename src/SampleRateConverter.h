@@ -0,0 +1,188 @@
+#ifndef __SAMPLE_RATE_CONVERTER__
+#define __SAMPLE_RATE_CONVERTER__
+
+#include <vector>
+
+#include "PolyphaseFilter.h"
+#include "SoundDelayBuffer.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Streaming multichannel polyphase sample rate converter
+ *
+ * Input is written (with format conversion) into an internal float SoundRingBuffer and
+ * output frames are generated from it using a windowed-sinc PolyphaseFilter table
+ *
+ * Two modes are used:
+ *   rational:  if both rates are integers and the reduced interpolation factor L (output / gcd) is
+ *              small enough, a table with a multiple of L phases is used and positions are stepped
+ *              exactly using integer arithmetic (e.g. 44100 -> 48000 is L = 160, M = 147)
+ *   arbitrary: otherwise positions are stepped in floating point and coeffs are interpolated
+ *              between the phases of an oversampled table, SetRatio() can change the ratio at any time
+ *
+ * When downsampling, the cutoff of the filter is lowered (and the number of taps increased) to
+ * prevent aliasing
+ *
+ * Channels are processed together (SIMD across channels for interleaved data)
+ *
+ * Latency: output frame n is the input signal at input frame (n * inputrate / outputrate - GetLatency())
+ * and output frame n can be generated once input frame (n * inputrate / outputrate) has been written
+ * (i.e. there is no additional buffering delay beyond the reported latency)
+ *
+ * @note Setup() allocates memory and may generate filter tables, it is *not* real-time safe
+ */
+/*--------------------------------------------------------------------------------*/
+class SampleRateConverter
+{
+public:
+  SampleRateConverter(uint_t _channels = 0, double _inputrate = 48000.0, double _outputrate = 48000.0, uint_t _taps = 32);
+  virtual ~SampleRateConverter() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set up converter
+   *
+   * @param _channels number of channels
+   * @param _inputrate input sample rate
+   * @param _outputrate output sample rate
+   * @param _taps basic number of filter taps (increased when downsampling)
+   *
+   * @return true if set up successfully
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual bool Setup(uint_t _channels, double _inputrate, double _outputrate, uint_t _taps = 32);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Clear all history and reset position
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual void Reset();
+
+  uint_t GetChannels()   const {return channels;}
+  double GetInputRate()  const {return inputrate;}
+  double GetOutputRate() const {return outputrate;}
+  uint_t GetTaps()       const {return filter ? filter->GetTaps() : 0;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return true if the converter is using exact (integer) stepping
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool IsRational() const {return rational;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return current conversion ratio (output rate / input rate)
+   */
+  /*--------------------------------------------------------------------------------*/
+  double GetRatio() const {return 1.0 / step;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Change conversion ratio (output rate / input rate) without resetting
+   *
+   * @note this switches the converter to arbitrary mode
+   * @note the filter is NOT changed so the ratio should remain close to the ratio set up by Setup()
+   * @note this function is real-time safe
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual void SetRatio(double ratio);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return latency of the converter in input frames
+   */
+  /*--------------------------------------------------------------------------------*/
+  double GetLatency() const {return filter ? (double)(filter->GetTaps() / 2) : 0.0;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return latency of the converter in output frames
+   */
+  /*--------------------------------------------------------------------------------*/
+  double GetOutputLatency() const {return GetLatency() / step;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of input frames written beyond the (fractional) position of the next output frame
+   *
+   * @note the next output frame can be generated if this is positive
+   */
+  /*--------------------------------------------------------------------------------*/
+  double GetBufferedFrames() const;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return number of output frames that the currently buffered input plus nsrcframes will generate
+   *
+   * @note in arbitrary mode this may differ by one frame due to floating point rounding
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t CalcOutputFrames(uint_t nsrcframes) const;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Convert a block of frames
+   *
+   * @param src source samples (interleaved, GetChannels() channels)
+   * @param srcformat format of source samples (ASSUMES same endianness as machine)
+   * @param nsrcframes number of source frames available
+   * @param dst destination for samples (interleaved, GetChannels() channels)
+   * @param dstformat format of destination samples (ASSUMES same endianness as machine)
+   * @param ndstframes maximum number of destination frames to generate
+   * @param nsrcconsumed optional destination for number of source frames consumed
+   *
+   * @return number of destination frames generated
+   *
+   * @note all source frames are consumed unless the destination is filled first
+   * @note source frames that are consumed but not yet used are held internally for the next call
+   */
+  /*--------------------------------------------------------------------------------*/
+  virtual uint_t Process(const uint8_t *src, SampleFormat_t srcformat, uint_t nsrcframes,
+                         uint8_t *dst, SampleFormat_t dstformat, uint_t ndstframes,
+                         uint_t *nsrcconsumed = NULL);
+
+  template<typename T1, typename T2>
+  uint_t Process(const T1 *src, uint_t nsrcframes, T2 *dst, uint_t ndstframes, uint_t *nsrcconsumed = NULL)
+  {
+    return Process((const uint8_t *)src, SampleFormatOf(src), nsrcframes, (uint8_t *)dst, SampleFormatOf(dst), ndstframes, nsrcconsumed);
+  }
+
+protected:
+  /*--------------------------------------------------------------------------------*/
+  /** Generate up to nframes into scratch output from buffered input
+   *
+   * @return number of frames generated
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t Generate(float *dst, uint_t nframes);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Release input frames that will never be used again
+   */
+  /*--------------------------------------------------------------------------------*/
+  void ReleaseInput();
+
+  enum
+  {
+    BlockFrames       = 256,            // number of output frames generated per pass
+    InputFrames       = 1024,           // (minimum) number of input frames buffered
+    MaxRationalPhases = 1024,           // maximum number of phases for a rational table
+    ArbitraryPhases   = 256,            // number of phases for arbitrary ratios (coeffs interpolated)
+  };
+
+protected:
+  const PolyphaseFilter *filter;
+  SoundRingBuffer       input;
+  uint_t                channels;
+  double                inputrate;
+  double                outputrate;
+  bool                  rational;
+  // position of next output frame relative to the read position of input
+  uint_t                ipos;
+  uint_t                fnum;           // fractional position in 1/L units (rational)
+  double                frac;           // fractional position (arbitrary)
+  uint_t                L, M;           // interpolation and decimation factors (rational)
+  uint_t                phasestep;      // table phases per 1/L step (rational)
+  double                step;           // input frames per output frame
+  std::vector<float>    output;         // scratch output
+  std::vector<float>    gather;         // scratch for frames that wrap around input
+  std::vector<float>    coeffstorage;   // scratch for interpolated coeffs
+  float                 *coeffs;        // aligned pointer into coeffstorage
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
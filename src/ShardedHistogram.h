@@ -0,0 +1,346 @@
+#ifndef __SHARDED_HISTOGRAM__
+#define __SHARDED_HISTOGRAM__
+
+#include <stdlib.h>
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <new>
+
+#include "Histogram.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Histogram which can be accumulated from many threads without locking
+ *
+ * The histogram is divided into shards, one per writing thread, each written by only one thread
+ * (so that no read-modify-write atomic operations are needed) and each allocated as a single block
+ * (header followed by bins) aligned to and padded to a whole number of cache lines so that writers
+ * never share cache lines
+ *
+ * Each shard has a sequence count (a 'seqlock') which is odd whilst the shard is being updated so that
+ * readers can take a consistent snapshot of each shard without stopping or blocking writers
+ *
+ * Snapshots are ordinary Histogram objects (merged from all shards in O(bins) per shard)
+ *
+ * Threading rules:
+ *   SetRange(), SetShards() and Reset() must not be called whilst any other thread is using the histogram
+ *   Add() and ResetShard() for a shard must only be called by that shard's thread
+ *   Snapshot() may be called from any thread at any time
+ */
+/*--------------------------------------------------------------------------------*/
+template<typename INDEXTYPE, typename ITEMTYPE>
+class ShardedHistogram
+{
+public:
+  /*--------------------------------------------------------------------------------*/
+  /** Construct from min value, max value, step, number of shards (writing threads) and bin spacing
+   */
+  /*--------------------------------------------------------------------------------*/
+  ShardedHistogram(INDEXTYPE _min  = INDEXTYPE(0),
+                   INDEXTYPE _max  = INDEXTYPE(1),
+                   INDEXTYPE _step = INDEXTYPE(1),
+                   uint_t _nshards = 1,
+                   typename Histogram<INDEXTYPE,ITEMTYPE>::Bins_t _bins = Histogram<INDEXTYPE,ITEMTYPE>::Bins_Linear) : layout(_min, _max, _step, _bins)
+  {
+    SetShards(_nshards);
+  }
+  ~ShardedHistogram() {DeleteShards();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set range of histogram from min value, max value, step and bin spacing (see Histogram)
+   *
+   * @note NOT thread-safe, all shards are reset
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetRange(INDEXTYPE _min, INDEXTYPE _max, INDEXTYPE _step = INDEXTYPE(1),
+                typename Histogram<INDEXTYPE,ITEMTYPE>::Bins_t _bins = Histogram<INDEXTYPE,ITEMTYPE>::Bins_Linear)
+  {
+    layout.SetRange(_min, _max, _step, _bins);
+    SetShards(GetShards());
+  }
+  uint_t GetSize() const {return layout.GetSize();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set number of shards (writing threads)
+   *
+   * @note NOT thread-safe, all shards are reset
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetShards(uint_t nshards)
+  {
+    uint_t i;
+
+    DeleteShards();
+    shards.resize(nshards);
+    for (i = 0; i < nshards; i++) shards[i] = CreateShard(layout.GetSize());
+    Reset();
+  }
+  uint_t GetShards() const {return (uint_t)shards.size();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Reset all shards
+   *
+   * @note NOT thread-safe
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset()
+  {
+    uint_t i;
+
+    for (i = 0; i < shards.size(); i++) ResetShard(i);
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Reset a single shard
+   *
+   * @note must only be called by the shard's thread
+   */
+  /*--------------------------------------------------------------------------------*/
+  void ResetShard(uint_t shard)
+  {
+    if (shard < shards.size())
+    {
+      SHARD& s = *shards[shard];
+      uint_t i;
+
+      BeginUpdate(s);
+      for (i = 0; i < s.nbins; i++) Store(s.histogram[i], 0, ITEMTYPE(0));
+      Store(s.total, 0, ITEMTYPE(0));
+      EndUpdate(s);
+    }
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return min and range
+   */
+  /*--------------------------------------------------------------------------------*/
+  INDEXTYPE GetMin()   const {return layout.GetMin();}
+  INDEXTYPE GetRange() const {return layout.GetRange();}
+  INDEXTYPE GetMax()   const {return layout.GetMax();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Add data to a shard
+   *
+   * @note must only be called by the shard's thread
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Add(uint_t shard, INDEXTYPE index, ITEMTYPE val = ITEMTYPE(0))
+  {
+    if (shard < shards.size())
+    {
+      SHARD& s = *shards[shard];
+
+      BeginUpdate(s);
+      Accumulate(s.histogram[layout.CalcIndex(index)], 1, val);
+      Accumulate(s.total, 1, val);
+      EndUpdate(s);
+    }
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Add block of data to a shard
+   *
+   * @param shard shard index
+   * @param indices array of n indices
+   * @param vals array of n values (or NULL to add zeros)
+   * @param n number of items
+   *
+   * @note must only be called by the shard's thread
+   * @note the data is added in updates of at most 256 items so that snapshots are not held off by large
+   * @note blocks (a snapshot may therefore include part of a block)
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Add(uint_t shard, const INDEXTYPE *indices, const ITEMTYPE *vals, uint_t n)
+  {
+    if (shard < shards.size())
+    {
+      SHARD& s = *shards[shard];
+      uint_t binindices[256];
+      uint_t i, j, m;
+
+      for (i = 0; i < n; i += m)
+      {
+        ITEMTYPE sum = ITEMTYPE(0);
+
+        m = std::min(n - i, (uint_t)NUMBEROF(binindices));
+
+        // calculate bins in bulk (outside of the update)
+        layout.CalcIndices(indices + i, m, binindices);
+
+        BeginUpdate(s);
+        for (j = 0; j < m; j++)
+        {
+          const ITEMTYPE val = vals ? vals[i + j] : ITEMTYPE(0);
+          Accumulate(s.histogram[binindices[j]], 1, val);
+          sum += val;
+        }
+        Accumulate(s.total, m, sum);
+        EndUpdate(s);
+      }
+    }
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Take a snapshot of all shards merged into a single histogram
+   *
+   * @param dst destination histogram (its range is set to that of this histogram)
+   * @param maxretries maximum number of times to re-read a shard that was updated whilst being read (0 = unlimited)
+   *
+   * @note whilst a shard is being updated the calling thread yields until the update ends (which is not
+   * @note counted as a retry)
+   *
+   * @return true if every shard was read consistently (otherwise an inconsistent read of a shard
+   * @return which was continually being updated has been used)
+   */
+  /*--------------------------------------------------------------------------------*/
+  bool Snapshot(Histogram<INDEXTYPE,ITEMTYPE>& dst, uint_t maxretries = 64) const
+  {
+    std::vector<typename Histogram<INDEXTYPE,ITEMTYPE>::ITEM> items(layout.GetSize() + 1);
+    bool   consistent = true;
+    uint_t i, j;
+
+    dst = layout;
+    dst.Reset();
+
+    for (i = 0; i < shards.size(); i++)
+    {
+      const SHARD& s = *shards[i];
+      uint_t   retries = 0;
+      uint32_t seq1, seq2;
+
+      do
+      {
+        // wait for any update in progress to end (updates are short)
+        while ((seq1 = s.sequence.load(std::memory_order_acquire)) & 1) std::this_thread::yield();
+
+        for (j = 0; j < s.nbins; j++) Load(s.histogram[j], items[j]);
+        Load(s.total, items[j]);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        seq2 = s.sequence.load(std::memory_order_relaxed);
+      }
+      while ((seq1 != seq2) && (!maxretries || ((++retries) <= maxretries)));
+
+      if (seq1 != seq2) consistent = false;
+
+      // merge shard
+      for (j = 0; j < s.nbins; j++)
+      {
+        if (items[j].count) dst.AddToBin(j, items[j].count, items[j].data);
+      }
+    }
+
+    return consistent;
+  }
+
+protected:
+  enum
+  {
+    CacheLineSize = 64,
+  };
+
+  typedef struct
+  {
+    std::atomic<uint_t>   count;
+    std::atomic<ITEMTYPE> data;
+  } ATOMICITEM;
+
+  // shard header, the bins follow it in the same (cache line aligned and padded) allocation
+  typedef struct alignas(CacheLineSize)
+  {
+    std::atomic<uint32_t> sequence;     // odd whilst being updated
+    ATOMICITEM            total;
+    ATOMICITEM            *histogram;   // bins (immediately after header)
+    uint_t                nbins;
+    void                  *allocation;  // unaligned allocation
+  } SHARD;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Allocate shard of n bins, aligned to a cache line with the bins padded to a whole number of cache lines
+   */
+  /*--------------------------------------------------------------------------------*/
+  static SHARD *CreateShard(uint_t n)
+  {
+    const size_t binbytes = ((n * sizeof(ATOMICITEM) + CacheLineSize - 1) / CacheLineSize) * CacheLineSize;
+    uint8_t      *p, *block;
+    SHARD        *s;
+    uint_t       i;
+
+    if ((p = (uint8_t *)malloc(sizeof(SHARD) + binbytes + CacheLineSize)) == NULL) throw std::bad_alloc();
+
+    block = p + ((CacheLineSize - ((size_t)p & (CacheLineSize - 1))) & (CacheLineSize - 1));
+    s     = new(block) SHARD;
+    s->sequence   = 0;
+    s->histogram  = (ATOMICITEM *)(block + sizeof(SHARD));
+    s->nbins      = n;
+    s->allocation = p;
+    for (i = 0; i < n; i++) new(s->histogram + i) ATOMICITEM;
+
+    return s;
+  }
+  static void DeleteShard(SHARD *s)
+  {
+    if (s)
+    {
+      void   *p = s->allocation;
+      uint_t i;
+
+      for (i = 0; i < s->nbins; i++) s->histogram[i].~ATOMICITEM();
+      s->~SHARD();
+      free(p);
+    }
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Update helpers (single writer so relaxed load/store suffices)
+   */
+  /*--------------------------------------------------------------------------------*/
+  static void BeginUpdate(SHARD& s)
+  {
+    s.sequence.store(s.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+  static void EndUpdate(SHARD& s)
+  {
+    s.sequence.store(s.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+  static void Store(ATOMICITEM& item, uint_t count, ITEMTYPE data)
+  {
+    item.count.store(count, std::memory_order_relaxed);
+    item.data.store(data, std::memory_order_relaxed);
+  }
+  static void Accumulate(ATOMICITEM& item, uint_t count, ITEMTYPE data)
+  {
+    item.count.store(item.count.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    item.data.store(item.data.load(std::memory_order_relaxed) + data, std::memory_order_relaxed);
+  }
+  static void Load(const ATOMICITEM& item, typename Histogram<INDEXTYPE,ITEMTYPE>::ITEM& dst)
+  {
+    dst.count = item.count.load(std::memory_order_relaxed);
+    dst.data  = item.data.load(std::memory_order_relaxed);
+  }
+
+  void DeleteShards()
+  {
+    uint_t i;
+
+    for (i = 0; i < shards.size(); i++) DeleteShard(shards[i]);
+    shards.clear();
+  }
+
+protected:
+  Histogram<INDEXTYPE,ITEMTYPE> layout;           // used for binning only
+  std::vector<SHARD *>          shards;
+
+private:
+  // copying is not supported
+  ShardedHistogram(const ShardedHistogram&);
+  ShardedHistogram& operator = (const ShardedHistogram&);
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
@@ -0,0 +1,241 @@
+#include <math.h>
+#include <string.h>
+#include <float.h>
+
+#include <algorithm>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#elif defined(__SSE3__)
+#include <pmmintrin.h>
+#endif
+
+#define BBCDEBUG_LEVEL 1
+#include "SlidingExtremum.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Apply bit masks to a sample: (x & andmask) ^ xormask
+ */
+/*--------------------------------------------------------------------------------*/
+static inline float MaskSample(float x, uint32_t andmask, uint32_t xormask)
+{
+  uint32_t bits;
+
+  memcpy(&bits, &x, sizeof(bits));
+  bits = (bits & andmask) ^ xormask;
+  memcpy(&x, &bits, sizeof(x));
+
+  return x;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Update n channels of one frame
+ *
+ * @param src source samples
+ * @param blk destination in current block for conditioned samples
+ * @param prefix running maxima of current block
+ * @param suffix suffix maxima of previous block (for the frames still in the window)
+ * @param current destination for current maxima
+ * @param dst destination for output (or NULL)
+ * @param n number of channels
+ * @param andmask, xormask masks to condition input (for maximum, minimum or peak)
+ * @param outmask mask to convert maxima back to output
+ */
+/*--------------------------------------------------------------------------------*/
+static void UpdateFrame(const float *src, float *blk, float *prefix, const float *suffix, float *current, float *dst, uint_t n,
+                        uint32_t andmask, uint32_t xormask, uint32_t outmask)
+{
+  uint_t i = 0;
+
+#ifdef __AVX__
+  {
+    const __m256 am = _mm256_castsi256_ps(_mm256_set1_epi32((int)andmask));
+    const __m256 xm = _mm256_castsi256_ps(_mm256_set1_epi32((int)xormask));
+    const __m256 om = _mm256_castsi256_ps(_mm256_set1_epi32((int)outmask));
+
+    for (; (i + 8) <= n; i += 8)
+    {
+      const __m256 x = _mm256_xor_ps(_mm256_and_ps(_mm256_loadu_ps(src + i), am), xm);
+      const __m256 p = _mm256_max_ps(_mm256_loadu_ps(prefix + i), x);
+      const __m256 c = _mm256_max_ps(_mm256_loadu_ps(suffix + i), p);
+
+      _mm256_storeu_ps(blk + i, x);
+      _mm256_storeu_ps(prefix + i, p);
+      _mm256_storeu_ps(current + i, c);
+      if (dst) _mm256_storeu_ps(dst + i, _mm256_xor_ps(c, om));
+    }
+  }
+#endif
+#if defined(__AVX__) || defined(__SSE3__)
+  {
+    const __m128 am = _mm_castsi128_ps(_mm_set1_epi32((int)andmask));
+    const __m128 xm = _mm_castsi128_ps(_mm_set1_epi32((int)xormask));
+    const __m128 om = _mm_castsi128_ps(_mm_set1_epi32((int)outmask));
+
+    for (; (i + 4) <= n; i += 4)
+    {
+      const __m128 x = _mm_xor_ps(_mm_and_ps(_mm_loadu_ps(src + i), am), xm);
+      const __m128 p = _mm_max_ps(_mm_loadu_ps(prefix + i), x);
+      const __m128 c = _mm_max_ps(_mm_loadu_ps(suffix + i), p);
+
+      _mm_storeu_ps(blk + i, x);
+      _mm_storeu_ps(prefix + i, p);
+      _mm_storeu_ps(current + i, c);
+      if (dst) _mm_storeu_ps(dst + i, _mm_xor_ps(c, om));
+    }
+  }
+#endif
+  for (; i < n; i++)
+  {
+    const float x = MaskSample(src[i], andmask, xormask);
+
+    blk[i]     = x;
+    prefix[i]  = std::max(prefix[i], x);
+    current[i] = std::max(suffix[i], prefix[i]);
+    if (dst) dst[i] = MaskSample(current[i], ~0U, outmask);
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** dst = max(a, b) for n samples
+ */
+/*--------------------------------------------------------------------------------*/
+static void Maximum(const float *a, const float *b, float *dst, uint_t n)
+{
+  uint_t i = 0;
+
+#ifdef __AVX__
+  for (; (i + 8) <= n; i += 8) _mm256_storeu_ps(dst + i, _mm256_max_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+#endif
+#if defined(__AVX__) || defined(__SSE3__)
+  for (; (i + 4) <= n; i += 4) _mm_storeu_ps(dst + i, _mm_max_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+#endif
+  for (; i < n; i++) dst[i] = std::max(a[i], b[i]);
+}
+
+MultichannelSlidingExtremum::MultichannelSlidingExtremum(uint_t _channels, uint_t _length, Mode_t _mode) : channels(0),
+                                                                                                           length(0),
+                                                                                                           mode(Mode_Maximum),
+                                                                                                           pos(0)
+{
+  Setup(_channels, _length, _mode);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Set up window
+ *
+ * @param _channels number of channels
+ * @param _length window length in frames
+ * @param _mode whether maximum, minimum or peak is tracked
+ */
+/*--------------------------------------------------------------------------------*/
+void MultichannelSlidingExtremum::Setup(uint_t _channels, uint_t _length, Mode_t _mode)
+{
+  channels = _channels;
+  length   = _length;
+  mode     = _mode;
+
+  block.resize(length * channels);
+  suffix.resize((length + 1) * channels);
+  prefix.resize(channels);
+  current.resize(channels);
+
+  Reset();
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Reset window
+ */
+/*--------------------------------------------------------------------------------*/
+void MultichannelSlidingExtremum::Reset()
+{
+  // an empty previous block has no effect on maxima (suffix[length] is always empty)
+  std::fill(suffix.begin(), suffix.end(), -FLT_MAX);
+  std::fill(prefix.begin(), prefix.end(), -FLT_MAX);
+  std::fill(block.begin(),  block.end(),  0.f);
+  std::fill(current.begin(), current.end(), 0.f);
+  pos = 0;
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Write interleaved frames into window and write extrema after each frame to destination
+ *
+ * @param src source buffer
+ * @param dst destination buffer (or NULL)
+ * @param srcchannel channel within source to start reading from
+ * @param nsrcchannels total number of channels in source
+ * @param dstchannel channel within destination to start writing to
+ * @param ndstchannels total number of channels in destination
+ * @param nframes number of frames
+ *
+ * @note GetChannels() channels are read from src and written to dst
+ * @note src can == dst IFF src and dst channel parameters are the same
+ */
+/*--------------------------------------------------------------------------------*/
+void MultichannelSlidingExtremum::Process(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes)
+{
+  if (!length || !channels || ((srcchannel + channels) > nsrcchannels) || (dst && ((dstchannel + channels) > ndstchannels))) return;
+
+  // masks to condition input such that the maximum is always tracked
+  const uint32_t signbit = 0x80000000U;
+  const uint32_t andmask = (mode == Mode_Peak)    ? ~signbit : ~0U;
+  const uint32_t xormask = (mode == Mode_Minimum) ? signbit  : 0U;
+  uint_t i;
+
+  src += srcchannel;
+  if (dst) dst += dstchannel;
+  for (i = 0; i < nframes; i++)
+  {
+    // window covers frames pos + 1 to length - 1 of previous block and frames 0 to pos of current block
+    UpdateFrame(src, &block[pos * channels], &prefix[0], &suffix[(pos + 1) * channels], &current[0], dst, channels, andmask, xormask, xormask);
+
+    if ((++pos) == length)
+    {
+      CompleteBlock();
+      pos = 0;
+    }
+
+    src += nsrcchannels;
+    if (dst) dst += ndstchannels;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Calculate suffix extrema of completed block
+ */
+/*--------------------------------------------------------------------------------*/
+void MultichannelSlidingExtremum::CompleteBlock()
+{
+  uint_t i;
+
+  // suffix[length] is always empty (-FLT_MAX)
+  for (i = length; i > 0; i--)
+  {
+    Maximum(&block[(i - 1) * channels], &suffix[i * channels], &suffix[(i - 1) * channels], channels);
+  }
+
+  std::fill(prefix.begin(), prefix.end(), -FLT_MAX);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return current extremum of a channel / all channels
+ *
+ * @note before the window has been filled, the extremum is of the frames written so far (0 if none)
+ */
+/*--------------------------------------------------------------------------------*/
+float MultichannelSlidingExtremum::GetExtremum(uint_t channel) const
+{
+  if (channel < channels) return (mode == Mode_Minimum) ? -current[channel] : current[channel];
+  return 0.f;
+}
+
+void MultichannelSlidingExtremum::GetExtrema(float *dst) const
+{
+  uint_t i;
+
+  for (i = 0; i < channels; i++) dst[i] = GetExtremum(i);
+}
+
+BBC_AUDIOTOOLBOX_END
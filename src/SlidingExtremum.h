@@ -0,0 +1,253 @@
+#ifndef __SLIDING_EXTREMUM__
+#define __SLIDING_EXTREMUM__
+
+#include <vector>
+
+#include <bbcat-base/misc.h>
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Simple templated sliding window maximum (or minimum)
+ *
+ * Uses a monotonic deque of candidate items (each item which could still become the extremum
+ * of the window) so that each item is added and removed at most once, giving O(1) amortised updates
+ *
+ * @param ITEMTYPE type of each item (MUST be a simple type)
+ */
+/*--------------------------------------------------------------------------------*/
+template<typename ITEMTYPE>
+class SlidingExtremum
+{
+public:
+  SlidingExtremum(uint_t n = 0, bool _maximum = true) : maximum(_maximum) {SetLength(n);}
+  SlidingExtremum(const SlidingExtremum& obj) : values(obj.values),
+                                                indices(obj.indices),
+                                                front(obj.front),
+                                                count(obj.count),
+                                                index(obj.index),
+                                                maximum(obj.maximum) {}
+  ~SlidingExtremum() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set window length
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetLength(uint_t n)
+  {
+    values.resize(n);
+    indices.resize(n);
+    Reset();
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return window length
+   */
+  /*--------------------------------------------------------------------------------*/
+  uint_t GetLength() const {return (uint_t)values.size();}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set whether maximum (true) or minimum (false) is tracked
+   *
+   * @note resets the window
+   */
+  /*--------------------------------------------------------------------------------*/
+  void SetMaximum(bool _maximum) {maximum = _maximum; Reset();}
+  bool GetMaximum() const {return maximum;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Reset window
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset()
+  {
+    front = 0;
+    count = 0;
+    index = 0;
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Write item into window and update extremum
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Write(ITEMTYPE val)
+  {
+    const uint_t length = (uint_t)values.size();
+
+    if (length)
+    {
+      // remove item at front if it has left the window (at most one item can leave per write)
+      if (count && ((indices[front] + length) <= index))
+      {
+        if ((++front) == length) front = 0;
+        count--;
+      }
+
+      // remove items from back which can never be the extremum again
+      while (count)
+      {
+        const uint_t back = (front + count - 1) % length;
+        if (maximum ? (values[back] > val) : (values[back] < val)) break;
+        count--;
+      }
+
+      // add item to back
+      const uint_t back = (front + count) % length;
+      values[back]  = val;
+      indices[back] = index++;
+      count++;
+    }
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Write items into window and update extremum
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Write(const ITEMTYPE *src, uint_t n, uint_t stride = 1)
+  {
+    uint_t i;
+
+    for (i = 0; i < n; i++, src += stride) Write(src[0]);
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Write items into window and write extremum after each item to destination
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Process(const ITEMTYPE *src, ITEMTYPE *dst, uint_t n, uint_t srcstride = 1, uint_t dststride = 1)
+  {
+    uint_t i;
+
+    for (i = 0; i < n; i++, src += srcstride, dst += dststride)
+    {
+      Write(src[0]);
+      dst[0] = GetExtremum();
+    }
+  }
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return current extremum of the window (or of the items written so far if the window has not been filled)
+   */
+  /*--------------------------------------------------------------------------------*/
+  ITEMTYPE GetExtremum() const {return count ? values[front] : (ITEMTYPE)0;}
+
+protected:
+  std::vector<ITEMTYPE> values;         // circular deque of candidate items (monotonic from front to back)
+  std::vector<uint64_t> indices;        // index of each candidate item
+  uint_t                front;
+  uint_t                count;
+  uint64_t              index;          // index of next item
+  bool                  maximum;
+};
+
+/*--------------------------------------------------------------------------------*/
+/** Sliding window maximum (or minimum or peak) of many channels of interleaved audio
+ *
+ * Uses the van Herk/Gil-Werman algorithm: the input is divided into blocks of the window length,
+ * the extremum of any window is the extremum of a suffix of the previous block (computed once when
+ * that block is complete) and a prefix of the current block (a running extremum), giving O(1)
+ * updates per frame, without branches, and all channels are processed together (SIMD across channels)
+ *
+ * Minima are tracked by negating the input and output and peaks (maxima of absolute values) by
+ * taking the absolute value of the input
+ */
+/*--------------------------------------------------------------------------------*/
+class MultichannelSlidingExtremum
+{
+public:
+  typedef enum
+  {
+    Mode_Maximum = 0,
+    Mode_Minimum,
+    Mode_Peak,                          // maximum of absolute values
+  } Mode_t;
+
+  /*--------------------------------------------------------------------------------*/
+  /** Constructor
+   *
+   * @param _channels number of channels
+   * @param _length window length in frames
+   * @param _mode whether maximum, minimum or peak is tracked
+   */
+  /*--------------------------------------------------------------------------------*/
+  MultichannelSlidingExtremum(uint_t _channels = 0, uint_t _length = 0, Mode_t _mode = Mode_Maximum);
+  ~MultichannelSlidingExtremum() {}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Set up window
+   *
+   * @param _channels number of channels
+   * @param _length window length in frames
+   * @param _mode whether maximum, minimum or peak is tracked
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Setup(uint_t _channels, uint_t _length, Mode_t _mode = Mode_Maximum);
+
+  uint_t GetChannels() const {return channels;}
+  uint_t GetLength()   const {return length;}
+  Mode_t GetMode()     const {return mode;}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Reset window
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Reset();
+
+  /*--------------------------------------------------------------------------------*/
+  /** Write interleaved frames into window
+   *
+   * @param src source buffer
+   * @param srcchannel channel within source to start reading from
+   * @param nsrcchannels total number of channels in source
+   * @param nframes number of frames
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Write(const float *src, uint_t srcchannel, uint_t nsrcchannels, uint_t nframes) {Process(src, NULL, srcchannel, nsrcchannels, 0, 0, nframes);}
+
+  /*--------------------------------------------------------------------------------*/
+  /** Write interleaved frames into window and write extrema after each frame to destination
+   *
+   * @param src source buffer
+   * @param dst destination buffer (or NULL)
+   * @param srcchannel channel within source to start reading from
+   * @param nsrcchannels total number of channels in source
+   * @param dstchannel channel within destination to start writing to
+   * @param ndstchannels total number of channels in destination
+   * @param nframes number of frames
+   *
+   * @note GetChannels() channels are read from src and written to dst
+   * @note src can == dst IFF src and dst channel parameters are the same
+   */
+  /*--------------------------------------------------------------------------------*/
+  void Process(const float *src, float *dst, uint_t srcchannel, uint_t nsrcchannels, uint_t dstchannel, uint_t ndstchannels, uint_t nframes);
+
+  /*--------------------------------------------------------------------------------*/
+  /** Return current extremum of a channel / all channels
+   *
+   * @note before the window has been filled, the extremum is of the frames written so far (0 if none)
+   */
+  /*--------------------------------------------------------------------------------*/
+  float GetExtremum(uint_t channel) const;
+  void  GetExtrema(float *dst) const;
+
+protected:
+  /*--------------------------------------------------------------------------------*/
+  /** Calculate suffix extrema of completed block
+   */
+  /*--------------------------------------------------------------------------------*/
+  void CompleteBlock();
+
+protected:
+  uint_t             channels;
+  uint_t             length;
+  Mode_t             mode;
+  std::vector<float> block;             // current block of frames (input conditioned for maximum)
+  std::vector<float> suffix;            // (length + 1) frames of suffix maxima of previous block
+  std::vector<float> prefix;            // running maximum of current block
+  std::vector<float> current;           // current maxima
+  uint_t             pos;               // position within block
+};
+
+BBC_AUDIOTOOLBOX_END
+
+#endif
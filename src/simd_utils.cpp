@@ -0,0 +1,133 @@
+#define BBCDEBUG_LEVEL 1
+#include "simd_utils.h"
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** Complex multiply-accumulate of interleaved complex arrays: dst[i] += a[i] * b[i]
+ *
+ * @param dst destination array of n complex values
+ * @param a first source array of n complex values
+ * @param b second source array of n complex values
+ * @param n number of complex values
+ */
+/*--------------------------------------------------------------------------------*/
+void ComplexMultiplyAccumulate(float *dst, const float *a, const float *b, uint_t n)
+{
+  uint_t i = 0;
+
+#ifdef __AVX__
+  for (; (i + 4) <= n; i += 4)
+  {
+    _mm256_storeu_ps(dst + 2 * i, _mm256_add_ps(_mm256_loadu_ps(dst + 2 * i), ComplexMultiply(_mm256_loadu_ps(a + 2 * i), _mm256_loadu_ps(b + 2 * i))));
+  }
+#endif
+#if defined(__AVX__) || defined(__SSE3__)
+  for (; (i + 2) <= n; i += 2)
+  {
+    _mm_storeu_ps(dst + 2 * i, _mm_add_ps(_mm_loadu_ps(dst + 2 * i), ComplexMultiply(_mm_loadu_ps(a + 2 * i), _mm_loadu_ps(b + 2 * i))));
+  }
+#endif
+  for (; i < n; i++)
+  {
+    const float ar = a[2 * i], ai = a[2 * i + 1];
+    const float br = b[2 * i], bi = b[2 * i + 1];
+
+    dst[2 * i]     += ar * br - ai * bi;
+    dst[2 * i + 1] += ar * bi + ai * br;
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Complex multiply-accumulate of split complex arrays (separate real and imaginary arrays):
+ * dst[i] += a[i] * b[i]
+ *
+ * @param dstre destination array of n real parts
+ * @param dstim destination array of n imaginary parts
+ * @param are first source array of n real parts
+ * @param aim first source array of n imaginary parts
+ * @param bre second source array of n real parts
+ * @param bim second source array of n imaginary parts
+ * @param n number of complex values
+ */
+/*--------------------------------------------------------------------------------*/
+void ComplexMultiplyAccumulate(float *dstre, float *dstim, const float *are, const float *aim, const float *bre, const float *bim, uint_t n)
+{
+  uint_t i = 0;
+
+#ifdef __AVX__
+  for (; (i + 8) <= n; i += 8)
+  {
+    const __m256 ar = _mm256_loadu_ps(are + i), ai = _mm256_loadu_ps(aim + i);
+    const __m256 br = _mm256_loadu_ps(bre + i), bi = _mm256_loadu_ps(bim + i);
+
+    _mm256_storeu_ps(dstre + i, _mm256_add_ps(_mm256_loadu_ps(dstre + i), _mm256_sub_ps(_mm256_mul_ps(ar, br), _mm256_mul_ps(ai, bi))));
+    _mm256_storeu_ps(dstim + i, _mm256_add_ps(_mm256_loadu_ps(dstim + i), _mm256_add_ps(_mm256_mul_ps(ar, bi), _mm256_mul_ps(ai, br))));
+  }
+#endif
+#if defined(__AVX__) || defined(__SSE3__)
+  for (; (i + 4) <= n; i += 4)
+  {
+    const __m128 ar = _mm_loadu_ps(are + i), ai = _mm_loadu_ps(aim + i);
+    const __m128 br = _mm_loadu_ps(bre + i), bi = _mm_loadu_ps(bim + i);
+
+    _mm_storeu_ps(dstre + i, _mm_add_ps(_mm_loadu_ps(dstre + i), _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi))));
+    _mm_storeu_ps(dstim + i, _mm_add_ps(_mm_loadu_ps(dstim + i), _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br))));
+  }
+#endif
+  for (; i < n; i++)
+  {
+    dstre[i] += are[i] * bre[i] - aim[i] * bim[i];
+    dstim[i] += are[i] * bim[i] + aim[i] * bre[i];
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Convert n interleaved complex values to split real and imaginary arrays
+ */
+/*--------------------------------------------------------------------------------*/
+void DeinterleaveComplex(const float *src, float *dstre, float *dstim, uint_t n)
+{
+  uint_t i = 0;
+
+#if defined(__AVX__) || defined(__SSE3__)
+  for (; (i + 4) <= n; i += 4)
+  {
+    const __m128 a = _mm_loadu_ps(src + 2 * i), b = _mm_loadu_ps(src + 2 * i + 4);
+
+    _mm_storeu_ps(dstre + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(dstim + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+#endif
+  for (; i < n; i++)
+  {
+    dstre[i] = src[2 * i];
+    dstim[i] = src[2 * i + 1];
+  }
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Convert split real and imaginary arrays to n interleaved complex values
+ */
+/*--------------------------------------------------------------------------------*/
+void InterleaveComplex(const float *srcre, const float *srcim, float *dst, uint_t n)
+{
+  uint_t i = 0;
+
+#if defined(__AVX__) || defined(__SSE3__)
+  for (; (i + 4) <= n; i += 4)
+  {
+    const __m128 re = _mm_loadu_ps(srcre + i), im = _mm_loadu_ps(srcim + i);
+
+    _mm_storeu_ps(dst + 2 * i,     _mm_unpacklo_ps(re, im));
+    _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(re, im));
+  }
+#endif
+  for (; i < n; i++)
+  {
+    dst[2 * i]     = srcre[i];
+    dst[2 * i + 1] = srcim[i];
+  }
+}
+
+BBC_AUDIOTOOLBOX_END
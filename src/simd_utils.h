@@ -0,0 +1,116 @@
+#ifndef __SIMD_UTILS__
+#define __SIMD_UTILS__
+
+#ifdef __AVX__
+#include <immintrin.h>
+#elif defined(__SSE3__)
+#include <pmmintrin.h>
+#endif
+
+#include <bbcat-base/misc.h>
+
+BBC_AUDIOTOOLBOX_START
+
+/*--------------------------------------------------------------------------------*/
+/** SIMD helpers for interleaved complex data (real, imag, real, imag, ...)
+ *
+ * A __m128 holds two complex values, a __m256 holds four
+ */
+/*--------------------------------------------------------------------------------*/
+
+#if defined(__AVX__) || defined(__SSE3__)
+/*--------------------------------------------------------------------------------*/
+/** Return a * b
+ */
+/*--------------------------------------------------------------------------------*/
+static inline __m128 ComplexMultiply(__m128 a, __m128 b)
+{
+  const __m128 t = _mm_mul_ps(a, _mm_moveldup_ps(b));
+  const __m128 u = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_movehdup_ps(b));
+  return _mm_addsub_ps(t, u);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return a * conj(b)
+ */
+/*--------------------------------------------------------------------------------*/
+static inline __m128 ComplexMultiplyConj(__m128 a, __m128 b)
+{
+  // (ar*br + ai*bi, ai*br - ar*bi) calculated as conj(conj(a) * b)
+  const __m128 sign = _mm_set_ps(-0.f, 0.f, -0.f, 0.f);
+  return _mm_xor_ps(ComplexMultiply(_mm_xor_ps(a, sign), b), sign);
+}
+
+/*--------------------------------------------------------------------------------*/
+/** Return a * -i (forward) or a * i (inverse)
+ */
+/*--------------------------------------------------------------------------------*/
+static inline __m128 ComplexRotate(__m128 a, bool inverse)
+{
+  const __m128 sign = inverse ? _mm_set_ps(0.f, -0.f, 0.f, -0.f) : _mm_set_ps(-0.f, 0.f, -0.f, 0.f);
+  return _mm_xor_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), sign);
+}
+#endif
+
+#ifdef __AVX__
+static inline __m256 ComplexMultiply(__m256 a, __m256 b)
+{
+  const __m256 t = _mm256_mul_ps(a, _mm256_moveldup_ps(b));
+  const __m256 u = _mm256_mul_ps(_mm256_permute_ps(a, _MM_SHUFFLE(2, 3, 0, 1)), _mm256_movehdup_ps(b));
+  return _mm256_addsub_ps(t, u);
+}
+
+static inline __m256 ComplexMultiplyConj(__m256 a, __m256 b)
+{
+  const __m256 sign = _mm256_set_ps(-0.f, 0.f, -0.f, 0.f, -0.f, 0.f, -0.f, 0.f);
+  return _mm256_xor_ps(ComplexMultiply(_mm256_xor_ps(a, sign), b), sign);
+}
+
+static inline __m256 ComplexRotate(__m256 a, bool inverse)
+{
+  const __m256 sign = inverse ? _mm256_set_ps(0.f, -0.f, 0.f, -0.f, 0.f, -0.f, 0.f, -0.f) : _mm256_set_ps(-0.f, 0.f, -0.f, 0.f, -0.f, 0.f, -0.f, 0.f);
+  return _mm256_xor_ps(_mm256_permute_ps(a, _MM_SHUFFLE(2, 3, 0, 1)), sign);
+}
+#endif
+
+/*--------------------------------------------------------------------------------*/
+/** Complex multiply-accumulate of interleaved complex arrays: dst[i] += a[i] * b[i]
+ *
+ * @param dst destination array of n complex values
+ * @param a first source array of n complex values
+ * @param b second source array of n complex values
+ * @param n number of complex values
+ */
+/*--------------------------------------------------------------------------------*/
+extern void ComplexMultiplyAccumulate(float *dst, const float *a, const float *b, uint_t n);
+
+/*--------------------------------------------------------------------------------*/
+/** Complex multiply-accumulate of split complex arrays (separate real and imaginary arrays):
+ * dst[i] += a[i] * b[i]
+ *
+ * @param dstre destination array of n real parts
+ * @param dstim destination array of n imaginary parts
+ * @param are first source array of n real parts
+ * @param aim first source array of n imaginary parts
+ * @param bre second source array of n real parts
+ * @param bim second source array of n imaginary parts
+ * @param n number of complex values
+ */
+/*--------------------------------------------------------------------------------*/
+extern void ComplexMultiplyAccumulate(float *dstre, float *dstim, const float *are, const float *aim, const float *bre, const float *bim, uint_t n);
+
+/*--------------------------------------------------------------------------------*/
+/** Convert n interleaved complex values to split real and imaginary arrays
+ */
+/*--------------------------------------------------------------------------------*/
+extern void DeinterleaveComplex(const float *src, float *dstre, float *dstim, uint_t n);
+
+/*--------------------------------------------------------------------------------*/
+/** Convert split real and imaginary arrays to n interleaved complex values
+ */
+/*--------------------------------------------------------------------------------*/
+extern void InterleaveComplex(const float *srcre, const float *srcim, float *dst, uint_t n);
+
+BBC_AUDIOTOOLBOX_END
+
+#endif